@@ -0,0 +1,743 @@
+#include "auditlog.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "bsmids.h"
+
+#include "events.h"
+#include "canonical.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86_SIMD 1
+#elif defined(__aarch64__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define HAVE_NEON 1
+#endif
+
+#define MAX_FIELDS 96
+//events whose records are still arriving
+#define MAX_PENDING_EVENTS 16
+//separates the raw fields from the resolved ones in the enriched format
+#define ENRICHED_SEPARATOR 0x1d
+
+#define RECORD_OTHER 0
+#define RECORD_SYSCALL 1
+#define RECORD_CWD 2
+#define RECORD_PATH 3
+#define RECORD_EOE 4
+
+struct LogField
+{
+    const char* key;
+    int keyLength;
+    const char* value;
+    int valueLength;
+};
+
+struct PendingEvent
+{
+    int used;
+    unsigned long long serial;
+    unsigned long long position;
+    int hasSyscall;
+    struct AuditEntry entry;
+    char cwd[MAXPATHLEN];
+    char name[MAXPATHLEN];
+    int nameRank; //a PARENT item only names the directory, any other item wins
+    char removed[MAXPATHLEN]; //the DELETE item, a rename's source if a CREATE item follows
+};
+
+struct AuditLogParser
+{
+    EntryHandler handler;
+    void* context;
+    unsigned long long events;
+    unsigned long long skipped;
+    struct PendingEvent pending[MAX_PENDING_EVENTS];
+};
+
+struct TokenState
+{
+    const char* line;
+    long start;
+    long equal;
+    struct LogField* fields;
+    int count;
+    int maxFields;
+};
+
+typedef int (*TokenizeFunction)(const char*, size_t, struct LogField*, int);
+
+static int tokenizeScalar(const char* line, size_t length, struct LogField* fields, int maxFields);
+static TokenizeFunction tokenizeImplementation = tokenizeScalar;
+static const char* variantName = "scalar";
+static int tokenizerChosen = 0;
+
+static inline void closeToken(struct TokenState* state, long end)
+{
+    //tokens without a key, such as the colon after the header, are dropped
+    if (state->equal > state->start && state->count < state->maxFields)
+    {
+        struct LogField* field = &state->fields[state->count++];
+        field->key = state->line + state->start;
+        field->keyLength = (int)(state->equal - state->start);
+        field->value = state->line + state->equal + 1;
+        field->valueLength = (int)(end - state->equal - 1);
+    }
+
+    state->start = end + 1;
+    state->equal = -1;
+}
+
+//at is a space, a group separator or '=', only the first '=' splits the field
+static inline void addBoundary(struct TokenState* state, long at)
+{
+    if (state->line[at] == '=')
+    {
+        if (state->equal < 0)
+        {
+            state->equal = at;
+        }
+    }
+    else
+    {
+        closeToken(state, at);
+    }
+}
+
+static void tokenizeTail(struct TokenState* state, size_t from, size_t length)
+{
+    for (size_t i = from; i < length; ++i)
+    {
+        char c = state->line[i];
+        if (c == ' ' || c == '=' || c == ENRICHED_SEPARATOR)
+        {
+            addBoundary(state, (long)i);
+        }
+    }
+
+    closeToken(state, (long)length);
+}
+
+static int tokenizeScalar(const char* line, size_t length, struct LogField* fields, int maxFields)
+{
+    struct TokenState state = { line, 0, -1, fields, 0, maxFields };
+
+    tokenizeTail(&state, 0, length);
+    return state.count;
+}
+
+#ifdef HAVE_X86_SIMD
+
+static int tokenizeSse2(const char* line, size_t length, struct LogField* fields, int maxFields)
+{
+    struct TokenState state = { line, 0, -1, fields, 0, maxFields };
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i equal = _mm_set1_epi8('=');
+    const __m128i group = _mm_set1_epi8(ENRICHED_SEPARATOR);
+    size_t i = 0;
+
+    for (; i + 16 <= length; i += 16)
+    {
+        __m128i block = _mm_loadu_si128((const __m128i*)(line + i));
+        __m128i boundaries = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(block, space), _mm_cmpeq_epi8(block, equal)),
+            _mm_cmpeq_epi8(block, group));
+        unsigned int mask = (unsigned int)_mm_movemask_epi8(boundaries);
+
+        while (mask)
+        {
+            addBoundary(&state, (long)(i + __builtin_ctz(mask)));
+            mask &= mask - 1;
+        }
+    }
+
+    tokenizeTail(&state, i, length);
+    return state.count;
+}
+
+#endif //HAVE_X86_SIMD
+
+#ifdef HAVE_NEON
+
+static int tokenizeNeon(const char* line, size_t length, struct LogField* fields, int maxFields)
+{
+    struct TokenState state = { line, 0, -1, fields, 0, maxFields };
+    const uint8x16_t space = vdupq_n_u8(' ');
+    const uint8x16_t equal = vdupq_n_u8('=');
+    const uint8x16_t group = vdupq_n_u8(ENRICHED_SEPARATOR);
+    size_t i = 0;
+
+    for (; i + 16 <= length; i += 16)
+    {
+        uint8x16_t block = vld1q_u8((const uint8_t*)(line + i));
+        uint8x16_t boundaries = vorrq_u8(vorrq_u8(vceqq_u8(block, space), vceqq_u8(block, equal)), vceqq_u8(block, group));
+        //narrow every byte to a nibble to get a 64 bit mask
+        uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(boundaries), 4)), 0);
+
+        while (mask)
+        {
+            int bit = __builtin_ctzll(mask) / 4;
+            addBoundary(&state, (long)(i + bit));
+            mask &= ~(0xFULL << (bit * 4));
+        }
+    }
+
+    tokenizeTail(&state, i, length);
+    return state.count;
+}
+
+#endif //HAVE_NEON
+
+//SSE2 and NEON are part of their base instruction sets, the fields are too
+//short for wider vectors to pay off
+static void chooseTokenizer(void)
+{
+    if (tokenizerChosen)
+    {
+        return;
+    }
+    tokenizerChosen = 1;
+
+#if defined(HAVE_X86_SIMD) && defined(__SSE2__)
+    tokenizeImplementation = tokenizeSse2;
+    variantName = "sse2";
+#elif defined(HAVE_NEON)
+    tokenizeImplementation = tokenizeNeon;
+    variantName = "neon";
+#endif
+}
+
+struct AuditLogParser* auditLogCreate(EntryHandler handler, void* context)
+{
+    struct AuditLogParser* parser = (struct AuditLogParser*)malloc(sizeof(struct AuditLogParser));
+
+    if (NULL == parser)
+    {
+        return NULL;
+    }
+
+    chooseTokenizer();
+    memset(parser, 0, sizeof(struct AuditLogParser));
+    parser->handler = handler;
+    parser->context = context;
+    return parser;
+}
+
+void auditLogDestroy(struct AuditLogParser* parser)
+{
+    free(parser);
+}
+
+static int isField(const struct LogField* field, const char* key, int keyLength)
+{
+    return field->keyLength == keyLength && memcmp(field->key, key, keyLength) == 0;
+}
+
+static long long parseDecimal(const char* text, int length)
+{
+    long long value = 0;
+    int negative = length > 0 && text[0] == '-';
+
+    for (int i = negative; i < length && text[i] >= '0' && text[i] <= '9'; ++i)
+    {
+        value = value * 10 + (text[i] - '0');
+    }
+
+    return negative ? -value : value;
+}
+
+static int hexDigit(char c)
+{
+    if (c >= '0' && c <= '9')
+    {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f')
+    {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F')
+    {
+        return c - 'A' + 10;
+    }
+
+    return -1;
+}
+
+static unsigned long long parseHex(const char* text, int length)
+{
+    unsigned long long value = 0;
+
+    for (int i = 0; i < length && hexDigit(text[i]) >= 0; ++i)
+    {
+        value = (value << 4) | hexDigit(text[i]);
+    }
+
+    return value;
+}
+
+//quoted text is literal, text with spaces or quotes is written as hex
+static void copyText(char* target, size_t size, const char* value, int length)
+{
+    size_t used = 0;
+
+    if (length >= 2 && value[0] == '"' && value[length - 1] == '"')
+    {
+        used = (size_t)(length - 2) < size - 1 ? (size_t)(length - 2) : size - 1;
+        memcpy(target, value + 1, used);
+    }
+    else if (length % 2 == 0)
+    {
+        for (int i = 0; i + 1 < length && used < size - 1; i += 2)
+        {
+            int high = hexDigit(value[i]);
+            int low = hexDigit(value[i + 1]);
+            if (high < 0 || low < 0)
+            {
+                //"(null)" and the like
+                used = 0;
+                break;
+            }
+            target[used++] = (char)(high << 4 | low);
+        }
+    }
+
+    target[used] = 0;
+}
+
+static int recordType(const char* name, size_t length)
+{
+    switch (length)
+    {
+        case 3:
+        if (memcmp(name, "CWD", 3) == 0)
+        {
+            return RECORD_CWD;
+        }
+        return memcmp(name, "EOE", 3) == 0 ? RECORD_EOE : RECORD_OTHER;
+        case 4:
+        return memcmp(name, "PATH", 4) == 0 ? RECORD_PATH : RECORD_OTHER;
+        case 7:
+        return memcmp(name, "SYSCALL", 7) == 0 ? RECORD_SYSCALL : RECORD_OTHER;
+    }
+
+    return RECORD_OTHER;
+}
+
+//msg=audit(1364481363.243:24287): returns the length up to the colon or -1
+static long parseStamp(const char* text, size_t length, unsigned long long* timestamp, unsigned long long* serial)
+{
+    unsigned long long seconds = 0;
+    unsigned long long milliseconds = 0;
+    size_t i = 10;
+
+    if (length < 10 || memcmp(text, "msg=audit(", 10) != 0)
+    {
+        return -1;
+    }
+
+    for (; i < length && text[i] >= '0' && text[i] <= '9'; ++i)
+    {
+        seconds = seconds * 10 + (text[i] - '0');
+    }
+    if (i < length && text[i] == '.')
+    {
+        for (++i; i < length && text[i] >= '0' && text[i] <= '9'; ++i)
+        {
+            milliseconds = milliseconds * 10 + (text[i] - '0');
+        }
+    }
+    if (i >= length || text[i] != ':')
+    {
+        return -1;
+    }
+
+    *serial = 0;
+    for (++i; i < length && text[i] >= '0' && text[i] <= '9'; ++i)
+    {
+        *serial = *serial * 10 + (text[i] - '0');
+    }
+    if (i + 1 >= length || text[i] != ')' || text[i + 1] != ':')
+    {
+        return -1;
+    }
+
+    *timestamp = seconds * 1000 + milliseconds;
+    return (long)(i + 2);
+}
+
+//BSM paths are absolute, so are these, path has MAXPATHLEN bytes
+static size_t absolutePath(char* path, const char* cwd, const char* name)
+{
+    size_t cwdLength = strlen(cwd);
+    size_t nameLength = strlen(name);
+    size_t length = 0;
+
+    if (name[0] != 0 && name[0] != '/' && cwdLength > 0 && cwdLength + 1 + nameLength < MAXPATHLEN)
+    {
+        memcpy(path, cwd, cwdLength);
+        path[cwdLength] = '/';
+        length = cwdLength + 1;
+    }
+    memcpy(path + length, name, nameLength);
+    length += nameLength;
+    path[length] = 0;
+
+    return length;
+}
+
+static void emitEvent(struct AuditLogParser* parser, struct PendingEvent* event)
+{
+    struct AuditEntry* entry = &event->entry;
+
+    event->used = 0;
+    if (!event->hasSyscall || entry->type == 0)
+    {
+        parser->skipped++;
+        return;
+    }
+
+    //the entry only keeps a rename's target, so the source's cached
+    //directories are dropped here, as main.c does for BSM records
+    if (event->removed[0] != 0 && strcmp(event->removed, event->name) != 0
+        && isCanonicalEnabled() && canonicalIsRemoval(entry->type))
+    {
+        char removed[MAXPATHLEN];
+        canonicalInvalidate(removed, absolutePath(removed, event->cwd, event->removed));
+    }
+
+    entry->pathLength = absolutePath(entry->path, event->cwd, event->name);
+    entry->position = event->position;
+
+    parser->events++;
+    parser->handler(entry, parser->context);
+}
+
+static struct PendingEvent* findEvent(struct AuditLogParser* parser, unsigned long long serial, unsigned long long position)
+{
+    struct PendingEvent* unused = NULL;
+    struct PendingEvent* oldest = NULL;
+
+    for (int i = 0; i < MAX_PENDING_EVENTS; ++i)
+    {
+        struct PendingEvent* event = &parser->pending[i];
+        if (!event->used)
+        {
+            unused = NULL != unused ? unused : event;
+        }
+        else if (event->serial == serial)
+        {
+            return event;
+        }
+        else if (NULL == oldest || event->serial < oldest->serial)
+        {
+            oldest = event;
+        }
+    }
+
+    //an event that stays open this long lost its EOE
+    if (NULL == unused)
+    {
+        emitEvent(parser, oldest);
+        unused = oldest;
+    }
+
+    memset(unused, 0, sizeof(struct PendingEvent));
+    unused->used = 1;
+    unused->serial = serial;
+    unused->position = position;
+    return unused;
+}
+
+static void addSyscall(struct PendingEvent* event, const struct LogField* fields, int count)
+{
+    struct AuditEntry* entry = &event->entry;
+    unsigned int arch = 0;
+    int number = -1;
+    long long exitCode = 0;
+    int success = 0;
+    unsigned long long args[4] = { 0, 0, 0, 0 };
+    char name[64];
+    const struct LogField* command = NULL;
+
+    name[0] = 0;
+    for (int i = 0; i < count; ++i)
+    {
+        const struct LogField* field = &fields[i];
+
+        if (isField(field, "arch", 4))
+        {
+            arch = (unsigned int)parseHex(field->value, field->valueLength);
+        }
+        else if (isField(field, "syscall", 7))
+        {
+            number = (int)parseDecimal(field->value, field->valueLength);
+        }
+        else if (field->keyLength == 2 && field->key[0] == 'a' && field->key[1] >= '0' && field->key[1] <= '3')
+        {
+            args[field->key[1] - '0'] = parseHex(field->value, field->valueLength);
+        }
+        else if (isField(field, "success", 7))
+        {
+            success = field->valueLength == 3 && memcmp(field->value, "yes", 3) == 0;
+        }
+        else if (isField(field, "exit", 4))
+        {
+            exitCode = parseDecimal(field->value, field->valueLength);
+        }
+        else if (isField(field, "pid", 3))
+        {
+            entry->pid = (int)parseDecimal(field->value, field->valueLength);
+        }
+        else if (isField(field, "uid", 3))
+        {
+            entry->userId = (int)parseDecimal(field->value, field->valueLength);
+        }
+        else if (isField(field, "ppid", 4))
+        {
+            entry->parentPid = (int)parseDecimal(field->value, field->valueLength);
+        }
+        else if (isField(field, "exe", 3))
+        {
+            copyText(entry->processPath, sizeof(entry->processPath), field->value, field->valueLength);
+        }
+        else if (isField(field, "comm", 4))
+        {
+            command = field;
+        }
+        else if (isField(field, "SYSCALL", 7) && field->valueLength < (int)sizeof(name))
+        {
+            //the enriched format names it, which also covers unknown arches
+            memcpy(name, field->value, field->valueLength);
+            name[field->valueLength] = 0;
+        }
+    }
+
+    //the record names its process, so a replay needs no /proc of the host,
+    //comm is only the first 15 bytes of the name but better than nothing
+    if (entry->processPath[0] == 0 && NULL != command)
+    {
+        copyText(entry->processPath, sizeof(entry->processPath), command->value, command->valueLength);
+    }
+
+    event->hasSyscall = 1;
+    entry->type = linuxSyscallEvent(arch, number);
+    if (entry->type == 0 && name[0] != 0)
+    {
+        entry->type = linuxSyscallNameEvent(name);
+    }
+    entry->type = linuxOpenEvent(entry->type, args);
+
+    //a thread's records carry the pid of the caller, there is no process to add
+    if (entry->type == AUE_FORK && linuxIsThreadClone(arch, number, name, args))
+    {
+        entry->type = 0;
+    }
+
+    if (success && (entry->type == AUE_FORK || entry->type == AUE_VFORK))
+    {
+        entry->childPid = (int)exitCode;
+    }
+}
+
+//dev=fd:00 as st_dev encodes it on Linux, cut to the 32 bits a BSM attr token has
+static unsigned int linuxDevice(const struct LogField* field)
+{
+    const char* colon = (const char*)memchr(field->value, ':', field->valueLength);
+    if (NULL == colon)
+    {
+        return 0;
+    }
+
+    unsigned long long major = parseHex(field->value, colon - field->value);
+    unsigned long long minor = parseHex(colon + 1, field->valueLength - (colon - field->value) - 1);
+    return (unsigned int)(((major & 0xfff) << 8) | (minor & 0xff) | ((minor & 0xfff00) << 12));
+}
+
+static void addPath(struct PendingEvent* event, const struct LogField* fields, int count)
+{
+    const struct LogField* name = NULL;
+    const struct LogField* device = NULL;
+    unsigned long long inode = 0;
+    int rank = 2;
+    int deleted = 0;
+
+    for (int i = 0; i < count; ++i)
+    {
+        if (isField(&fields[i], "name", 4))
+        {
+            name = &fields[i];
+        }
+        else if (isField(&fields[i], "nametype", 8) && fields[i].valueLength == 6 && memcmp(fields[i].value, "PARENT", 6) == 0)
+        {
+            rank = 1;
+        }
+        else if (isField(&fields[i], "nametype", 8) && fields[i].valueLength == 6 && memcmp(fields[i].value, "DELETE", 6) == 0)
+        {
+            deleted = 1;
+        }
+        else if (isField(&fields[i], "inode", 5))
+        {
+            inode = (unsigned long long)parseDecimal(fields[i].value, fields[i].valueLength);
+        }
+        else if (isField(&fields[i], "dev", 3))
+        {
+            device = &fields[i];
+        }
+    }
+
+    if (NULL != name && deleted)
+    {
+        copyText(event->removed, sizeof(event->removed), name->value, name->valueLength);
+    }
+
+    //the last item wins, as the last BSM path token does, e.g. a rename's target
+    if (NULL != name && rank >= event->nameRank)
+    {
+        copyText(event->name, sizeof(event->name), name->value, name->valueLength);
+        event->nameRank = rank;
+        event->entry.inode = inode;
+        event->entry.device = NULL != device ? linuxDevice(device) : 0;
+    }
+}
+
+void auditLogFeed(struct AuditLogParser* parser, const char* line, size_t length, unsigned long long position)
+{
+    struct LogField fields[MAX_FIELDS];
+    unsigned long long timestamp = 0;
+    unsigned long long serial = 0;
+
+    while (length > 0 && (line[length - 1] == '\n' || line[length - 1] == '\r'))
+    {
+        length--;
+    }
+
+    //with name_format set auditd puts the host's name first
+    if (length >= 5 && memcmp(line, "node=", 5) == 0)
+    {
+        const char* end = (const char*)memchr(line + 5, ' ', length - 5);
+        if (NULL == end)
+        {
+            return;
+        }
+        length -= end + 1 - line;
+        line = end + 1;
+    }
+
+    //most lines are of types nothing is taken from, they go by their prefix
+    if (length < 5 || memcmp(line, "type=", 5) != 0)
+    {
+        return;
+    }
+    const char* space = (const char*)memchr(line + 5, ' ', length - 5);
+    if (NULL == space)
+    {
+        return;
+    }
+    int type = recordType(line + 5, space - line - 5);
+    if (type == RECORD_OTHER)
+    {
+        return;
+    }
+
+    size_t offset = space - line + 1;
+    long stampLength = parseStamp(line + offset, length - offset, &timestamp, &serial);
+    if (stampLength < 0)
+    {
+        return;
+    }
+    offset += stampLength;
+
+    struct PendingEvent* event = findEvent(parser, serial, position);
+    event->entry.timestamp = timestamp;
+
+    if (type == RECORD_EOE)
+    {
+        emitEvent(parser, event);
+        return;
+    }
+
+    int count = tokenizeImplementation(line + offset, length - offset, fields, MAX_FIELDS);
+    switch (type)
+    {
+        case RECORD_SYSCALL:
+        addSyscall(event, fields, count);
+        break;
+        case RECORD_CWD:
+        for (int i = 0; i < count; ++i)
+        {
+            if (isField(&fields[i], "cwd", 3))
+            {
+                copyText(event->cwd, sizeof(event->cwd), fields[i].value, fields[i].valueLength);
+            }
+        }
+        break;
+        case RECORD_PATH:
+        addPath(event, fields, count);
+        break;
+    }
+}
+
+void auditLogFlush(struct AuditLogParser* parser)
+{
+    for (;;)
+    {
+        struct PendingEvent* oldest = NULL;
+        for (int i = 0; i < MAX_PENDING_EVENTS; ++i)
+        {
+            struct PendingEvent* event = &parser->pending[i];
+            if (event->used && (NULL == oldest || event->serial < oldest->serial))
+            {
+                oldest = event;
+            }
+        }
+
+        if (NULL == oldest)
+        {
+            return;
+        }
+        emitEvent(parser, oldest);
+    }
+}
+
+int auditLogOldestPosition(const struct AuditLogParser* parser, unsigned long long* position)
+{
+    int found = 0;
+
+    for (int i = 0; i < MAX_PENDING_EVENTS; ++i)
+    {
+        const struct PendingEvent* event = &parser->pending[i];
+        if (event->used && (!found || event->position < *position))
+        {
+            *position = event->position;
+            found = 1;
+        }
+    }
+
+    return found;
+}
+
+unsigned long long auditLogEvents(const struct AuditLogParser* parser)
+{
+    return parser->events;
+}
+
+unsigned long long auditLogSkipped(const struct AuditLogParser* parser)
+{
+    return parser->skipped;
+}
+
+const char* auditLogTokenizerVariant(void)
+{
+    chooseTokenizer();
+    return variantName;
+}
+
+void auditLogUseScalarTokenizer(void)
+{
+    tokenizerChosen = 1;
+    tokenizeImplementation = tokenizeScalar;
+    variantName = "scalar";
+}
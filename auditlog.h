@@ -0,0 +1,41 @@
+#ifndef AUDITLOG_H
+#define AUDITLOG_H
+
+#include <stddef.h>
+
+#include "entry.h"
+
+/*
+ * Parser for the text log Linux auditd writes to /var/log/audit/audit.log.
+ * The SYSCALL, CWD and PATH records of one event share a serial number and
+ * are joined into one AuditEntry, the same the BSM records would give, plus
+ * the exe and ppid SYSCALL names so that a replay needs no /proc. An
+ * event is handed on at its EOE record, a few events may be open at once
+ * as their records can interleave. Lines of other types are skipped by
+ * their prefix. Fields are split by finding spaces and '=' in 16 bytes at
+ * once with SSE2 or NEON, with a scalar fallback.
+ */
+
+struct AuditLogParser;
+
+struct AuditLogParser* auditLogCreate(EntryHandler handler, void* context);
+void auditLogDestroy(struct AuditLogParser* parser);
+
+//one line with or without its newline, position is its offset in the file
+void auditLogFeed(struct AuditLogParser* parser, const char* line, size_t length, unsigned long long position);
+
+//hands on the events whose EOE never came, at the end of a file
+void auditLogFlush(struct AuditLogParser* parser);
+
+//offset of the first line of the oldest open event, 0 if none is open
+int auditLogOldestPosition(const struct AuditLogParser* parser, unsigned long long* position);
+
+unsigned long long auditLogEvents(const struct AuditLogParser* parser);
+//events of syscalls without a BSM event and records without a SYSCALL record
+unsigned long long auditLogSkipped(const struct AuditLogParser* parser);
+
+//"sse2", "neon" or "scalar", the scalar one can be forced for comparisons
+const char* auditLogTokenizerVariant(void);
+void auditLogUseScalarTokenizer(void);
+
+#endif //AUDITLOG_H
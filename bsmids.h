@@ -0,0 +1,95 @@
+#ifndef BSMIDS_H
+#define BSMIDS_H
+
+#include <sys/types.h>
+
+/*
+ * The BSM event and token ids watchfs uses. Where OpenBSM is installed they
+ * come from its headers and HAVE_BSM is set. Elsewhere the ones watchfs
+ * needs are defined here, so the Linux sources map their events onto the
+ * same ids and BSM records can still be framed. The classic events and the
+ * token ids have OpenBSM's values. The *at, read and write events, which
+ * OpenBSM numbers differently between releases or not at all, get ids of
+ * their own from the range left to third parties.
+ */
+
+#if defined(__APPLE__) || defined(__FreeBSD__)
+#define HAVE_BSM 1
+#include <bsm/libbsm.h>
+#include <bsm/audit_kevents.h>
+#else
+#define AUT_OTHER_FILE32 0x11
+#define AUT_TRAILER 0x13
+#define AUT_HEADER32 0x14
+#define AUT_HEADER32_EX 0x15
+#define AUT_PATH 0x23
+#define AUT_SUBJECT32 0x24
+#define AUT_RETURN32 0x27
+#define AUT_HEADER64 0x74
+#define AUT_SUBJECT64 0x75
+#define AUT_HEADER64_EX 0x79
+#define AUT_SUBJECT32_EX 0x7a
+#define AUT_SUBJECT64_EX 0x7c
+
+#define AUE_NULL 0
+#define AUE_EXIT 1
+#define AUE_FORK 2
+#define AUE_OPEN 3
+#define AUE_CREAT 4
+#define AUE_LINK 5
+#define AUE_UNLINK 6
+#define AUE_EXEC 7
+#define AUE_CHMOD 10
+#define AUE_CHOWN 11
+#define AUE_SYMLINK 21
+#define AUE_EXECVE 23
+#define AUE_VFORK 25
+#define AUE_FCHOWN 38
+#define AUE_FCHMOD 39
+#define AUE_RENAME 42
+#define AUE_MKDIR 47
+#define AUE_RMDIR 48
+#define AUE_OPEN_R 72
+#define AUE_OPEN_RC 73
+#define AUE_OPEN_RTC 74
+#define AUE_OPEN_RT 75
+#define AUE_OPEN_RW 76
+#define AUE_OPEN_RWC 77
+#define AUE_OPEN_RWTC 78
+#define AUE_OPEN_RWT 79
+#define AUE_OPEN_W 80
+#define AUE_OPEN_WC 81
+#define AUE_OPEN_WTC 82
+#define AUE_OPEN_WT 83
+#define AUE_CLOSE 112
+#define AUE_TRUNCATE 129
+#define AUE_FTRUNCATE 130
+#define AUE_LCHOWN 237
+
+#define AUE_READ 44000
+#define AUE_WRITE 44001
+#define AUE_PREAD 44002
+#define AUE_PWRITE 44003
+#define AUE_FCHMODAT 44010
+#define AUE_FCHOWNAT 44011
+#define AUE_LINKAT 44012
+#define AUE_MKDIRAT 44013
+#define AUE_RENAMEAT 44014
+#define AUE_SYMLINKAT 44015
+#define AUE_UNLINKAT 44016
+#define AUE_OPENAT 44020
+#define AUE_OPENAT_R 44021
+#define AUE_OPENAT_RC 44022
+#define AUE_OPENAT_RTC 44023
+#define AUE_OPENAT_RT 44024
+#define AUE_OPENAT_RW 44025
+#define AUE_OPENAT_RWC 44026
+#define AUE_OPENAT_RWTC 44027
+#define AUE_OPENAT_RWT 44028
+#define AUE_OPENAT_W 44029
+#define AUE_OPENAT_WC 44030
+#define AUE_OPENAT_WTC 44031
+#define AUE_OPENAT_WT 44032
+#endif
+
+#endif //BSMIDS_H
@@ -0,0 +1,325 @@
+#include "canonical.h"
+
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bsmids.h"
+
+#include "uthash.h"
+
+#define DEFAULT_CACHE_SIZE 4096
+#define PREFIX_BITS 4096
+#define FNV_OFFSET 14695981039346656037ull
+#define FNV_PRIME 1099511628211ull
+
+struct DirectoryAlias
+{
+    size_t keyLength;
+    size_t realLength;
+    UT_hash_handle hh;
+    char text[]; //the directory as normalized, a 0, its realpath and a 0
+};
+
+static int enabled = 0;
+static unsigned int cacheSize = DEFAULT_CACHE_SIZE;
+static struct DirectoryAlias* cache = NULL; //uthash keeps insertion order, the head is the least recently used
+//set for every directory and parent of a cached key or realpath, cleared when the cache empties
+static unsigned long long prefixBits[PREFIX_BITS / 64];
+static unsigned long long hits = 0;
+static unsigned long long misses = 0;
+static unsigned long long invalidated = 0;
+
+void canonicalConfigure(int size)
+{
+    enabled = 1;
+    cacheSize = size > 0 ? (unsigned int)size : DEFAULT_CACHE_SIZE;
+}
+
+int isCanonicalEnabled(void)
+{
+    return enabled;
+}
+
+static void markPrefixes(const char* path, size_t length)
+{
+    unsigned long long hash = FNV_OFFSET;
+
+    for (size_t i = 0; i < length; ++i)
+    {
+        if (path[i] == '/' && i > 0)
+        {
+            prefixBits[(hash % PREFIX_BITS) / 64] |= 1ull << (hash % 64);
+        }
+        hash = (hash ^ (unsigned char)path[i]) * FNV_PRIME;
+    }
+    prefixBits[(hash % PREFIX_BITS) / 64] |= 1ull << (hash % 64);
+}
+
+static int isPrefixMarked(const char* path, size_t length)
+{
+    unsigned long long hash = FNV_OFFSET;
+
+    for (size_t i = 0; i < length; ++i)
+    {
+        hash = (hash ^ (unsigned char)path[i]) * FNV_PRIME;
+    }
+
+    return (prefixBits[(hash % PREFIX_BITS) / 64] & (1ull << (hash % 64))) != 0;
+}
+
+static int isBelow(const char* path, size_t length, const char* directory, size_t directoryLength)
+{
+    return length >= directoryLength && memcmp(path, directory, directoryLength) == 0
+        && (length == directoryLength || path[directoryLength] == '/');
+}
+
+//drops the cached directories at and below path, whether they were spelled or resolved that way
+static void dropBelow(const char* path, size_t length)
+{
+    struct DirectoryAlias *d = NULL;
+    struct DirectoryAlias *tmp = NULL;
+
+    if (NULL == cache || !isPrefixMarked(path, length))
+    {
+        return;
+    }
+
+    HASH_ITER(hh, cache, d, tmp)
+    {
+        if (isBelow(d->text, d->keyLength, path, length) || isBelow(d->text + d->keyLength + 1, d->realLength, path, length))
+        {
+            HASH_DELETE(hh, cache, d);
+            free(d);
+            invalidated++;
+        }
+    }
+
+    if (NULL == cache)
+    {
+        memset(prefixBits, 0, sizeof(prefixBits));
+    }
+}
+
+//collapses "//", drops "." and applies ".." to the directory before it, in place
+static size_t normalize(char* path, size_t length)
+{
+    size_t written = 0;
+    size_t read = 0;
+
+    while (read < length)
+    {
+        while (read < length && path[read] == '/')
+        {
+            read++;
+        }
+
+        size_t start = read;
+        while (read < length && path[read] != '/')
+        {
+            read++;
+        }
+
+        size_t nameLength = read - start;
+        if (nameLength == 0 || (nameLength == 1 && path[start] == '.'))
+        {
+            continue;
+        }
+
+        if (nameLength == 2 && path[start] == '.' && path[start + 1] == '.')
+        {
+            //above the root stays at the root
+            while (written > 0 && path[written - 1] != '/')
+            {
+                written--;
+            }
+            written -= written > 0 ? 1 : 0;
+            continue;
+        }
+
+        //every name read was preceded by at least one '/', so this never overtakes reading
+        path[written++] = '/';
+        memmove(path + written, path + start, nameLength);
+        written += nameLength;
+    }
+
+    if (written == 0)
+    {
+        path[written++] = '/';
+    }
+    path[written] = 0;
+
+    return written;
+}
+
+static const struct DirectoryAlias* lookupDirectory(const char* directory, size_t length)
+{
+    struct DirectoryAlias *d = NULL;
+
+    HASH_FIND(hh, cache, directory, length, d);
+    if (NULL != d)
+    {
+        //move to the most recently used end
+        hits++;
+        HASH_DELETE(hh, cache, d);
+        HASH_ADD(hh, cache, text[0], d->keyLength, d);
+        return d;
+    }
+
+    misses++;
+
+    char key[MAXPATHLEN];
+    char real[PATH_MAX];
+    if (length >= sizeof(key))
+    {
+        return NULL;
+    }
+    memcpy(key, directory, length);
+    key[length] = 0;
+
+    //gone or not accessible, the lexical form is the best there is and is not cached
+    if (NULL == realpath(key, real))
+    {
+        return NULL;
+    }
+    size_t realLength = strlen(real);
+
+    if (HASH_COUNT(cache) >= cacheSize)
+    {
+        d = cache;
+        HASH_DELETE(hh, cache, d);
+        free(d);
+    }
+
+    d = (struct DirectoryAlias*)malloc(sizeof(struct DirectoryAlias) + length + realLength + 2);
+    if (NULL == d)
+    {
+        return NULL;
+    }
+
+    d->keyLength = length;
+    d->realLength = realLength;
+    memcpy(d->text, key, length + 1);
+    memcpy(d->text + length + 1, real, realLength + 1);
+    HASH_ADD(hh, cache, text[0], d->keyLength, d);
+    markPrefixes(key, length);
+    markPrefixes(real, realLength);
+
+    return d;
+}
+
+//replaces the directory part by its realpath, returns 0 if nothing changed
+static size_t resolveDirectory(char* path, size_t length, size_t size)
+{
+    const char* slash = strrchr(path, '/');
+    size_t directoryLength = slash - path;
+
+    //in the root there is nothing to resolve
+    if (directoryLength == 0)
+    {
+        return 0;
+    }
+
+    const struct DirectoryAlias* d = lookupDirectory(path, directoryLength);
+    if (NULL == d || (d->realLength == directoryLength && memcmp(d->text + d->keyLength + 1, path, directoryLength) == 0))
+    {
+        return 0;
+    }
+
+    //a directory linked to the root resolves to "/", which the name brings already
+    size_t realLength = d->realLength > 1 ? d->realLength : 0;
+    size_t nameLength = length - directoryLength;
+    if (realLength + nameLength >= size)
+    {
+        return 0;
+    }
+
+    memmove(path + realLength, path + directoryLength, nameLength + 1);
+    memcpy(path, d->text + d->keyLength + 1, realLength);
+
+    return realLength + nameLength;
+}
+
+int canonicalIsRemoval(int type)
+{
+    switch (type)
+    {
+        case AUE_RENAME:
+        case AUE_RMDIR:
+        case AUE_UNLINK:
+#ifdef AUE_RENAMEAT
+        case AUE_RENAMEAT:
+#endif
+#ifdef AUE_UNLINKAT
+        case AUE_UNLINKAT:
+#endif
+        return 1;
+    }
+
+    return 0;
+}
+
+static size_t canonicalize(char* path, size_t length, size_t size, int removed)
+{
+    length = normalize(path, length);
+    if (removed)
+    {
+        dropBelow(path, length);
+    }
+
+    size_t resolved = resolveDirectory(path, length, size);
+    if (resolved == 0)
+    {
+        return length;
+    }
+
+    if (removed)
+    {
+        dropBelow(path, resolved);
+    }
+    return resolved;
+}
+
+void canonicalizeEntry(struct AuditEntry* entry)
+{
+    //relative paths have no directory to resolve against
+    if (!enabled || entry->path[0] != '/')
+    {
+        return;
+    }
+
+    entry->pathLength = canonicalize(entry->path, entry->pathLength, sizeof(entry->path), canonicalIsRemoval(entry->type));
+}
+
+void canonicalInvalidate(const char* path, size_t length)
+{
+    char copy[MAXPATHLEN];
+
+    if (!enabled || NULL == cache || path[0] != '/' || length >= sizeof(copy))
+    {
+        return;
+    }
+
+    memcpy(copy, path, length);
+    copy[length] = 0;
+    canonicalize(copy, length, sizeof(copy), 1);
+}
+
+void canonicalCacheStats(unsigned long long* cacheHits, unsigned long long* cacheMisses, unsigned long long* cacheInvalidated)
+{
+    *cacheHits = hits;
+    *cacheMisses = misses;
+    *cacheInvalidated = invalidated;
+}
+
+void canonicalFinish(void)
+{
+    struct DirectoryAlias *d = NULL;
+    struct DirectoryAlias *tmp = NULL;
+
+    HASH_ITER(hh, cache, d, tmp)
+    {
+        HASH_DELETE(hh, cache, d);
+        free(d);
+    }
+    memset(prefixBits, 0, sizeof(prefixBits));
+}
@@ -0,0 +1,34 @@
+#ifndef CANONICAL_H
+#define CANONICAL_H
+
+#include <stddef.h>
+
+#include "entry.h"
+
+/*
+ * Gives every file one path, however the record spelled it. Absolute paths
+ * are normalized lexically ("//", "." and ".." go), then the directory part
+ * is replaced by its realpath() from an LRU cache, so symlinked directories
+ * resolve without a system call per event. Directories that do not exist
+ * (any more) keep the lexical form. Renames and removals drop the cached
+ * directories at and below their path. A small bitmap of the cached path
+ * prefixes lets most of them skip the cache scan.
+ */
+
+void canonicalConfigure(int cacheSize);
+int isCanonicalEnabled(void);
+
+//rewrites the entry's path and drops the cache entries a rename or removal makes stale
+void canonicalizeEntry(struct AuditEntry* entry);
+
+//for paths a record names besides the entry's own, e.g. a rename's source
+void canonicalInvalidate(const char* path, size_t length);
+
+//1 for the event types that rename or remove their path
+int canonicalIsRemoval(int type);
+
+void canonicalCacheStats(unsigned long long* hits, unsigned long long* misses, unsigned long long* invalidated);
+
+void canonicalFinish(void);
+
+#endif //CANONICAL_H
@@ -0,0 +1,163 @@
+#include "cgroup.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef __FreeBSD__
+#include <sys/types.h>
+#include <sys/sysctl.h>
+#include <sys/user.h>
+#endif
+
+#define SHORT_ID_LENGTH 12
+
+//the longest run of hex digits, container runtimes all use a 64 digit id
+static const char* findContainerId(const char* text, size_t* length)
+{
+    const char* best = NULL;
+    size_t bestLength = 0;
+
+    while (*text)
+    {
+        size_t run = 0;
+        while (isxdigit((unsigned char)text[run]))
+        {
+            run++;
+        }
+
+        if (run > bestLength)
+        {
+            best = text;
+            bestLength = run;
+        }
+
+        text += run > 0 ? run : 1;
+    }
+
+    *length = bestLength;
+    return bestLength >= 32 ? best : NULL;
+}
+
+void containerFromCgroup(const char* cgroup, char* container, size_t containerSize)
+{
+    size_t length = 0;
+    const char* id = findContainerId(cgroup, &length);
+
+    container[0] = 0;
+
+    //docker-<id>.scope, /docker/<id>, cri-containerd-<id>.scope, libpod-<id>.scope, /kubepods/.../<id>
+    if (NULL != id)
+    {
+        snprintf(container, containerSize, "%.*s", SHORT_ID_LENGTH, id);
+        return;
+    }
+
+    //otherwise the systemd unit, e.g. /system.slice/nginx.service
+    const char* name = strrchr(cgroup, '/');
+    name = NULL != name ? name + 1 : cgroup;
+    if (strstr(name, ".service") != NULL || strstr(name, ".scope") != NULL)
+    {
+        snprintf(container, containerSize, "%s", name);
+    }
+}
+
+#ifdef __linux__
+
+int resolveCgroup(int pid, char* cgroup, size_t cgroupSize, char* container, size_t containerSize)
+{
+    char path[64];
+    char line[512];
+    int found = 0;
+
+    cgroup[0] = 0;
+    container[0] = 0;
+
+    snprintf(path, sizeof(path), "/proc/%d/cgroup", pid);
+    FILE* file = fopen(path, "r");
+    if (NULL == file)
+    {
+        return -1;
+    }
+
+    //"0::/path" on cgroup v2, on v1 the name=systemd or first hierarchy is used
+    while (fgets(line, sizeof(line), file))
+    {
+        line[strcspn(line, "\n")] = 0;
+
+        char* controllers = strchr(line, ':');
+        char* groupPath = NULL != controllers ? strchr(controllers + 1, ':') : NULL;
+        if (NULL == groupPath)
+        {
+            continue;
+        }
+
+        int unified = strncmp(line, "0::", 3) == 0;
+        int systemd = strstr(controllers, "name=systemd") != NULL;
+        if (unified || systemd || !found)
+        {
+            snprintf(cgroup, cgroupSize, "%s", groupPath + 1);
+            found = 1;
+        }
+
+        if (unified)
+        {
+            break;
+        }
+    }
+
+    fclose(file);
+
+    if (found)
+    {
+        containerFromCgroup(cgroup, container, containerSize);
+    }
+
+    return found ? 0 : -1;
+}
+
+#elif defined(__FreeBSD__)
+
+int resolveCgroup(int pid, char* cgroup, size_t cgroupSize, char* container, size_t containerSize)
+{
+    struct kinfo_proc info;
+    size_t size = sizeof(info);
+    int mib[4] = { CTL_KERN, KERN_PROC, KERN_PROC_PID, pid };
+
+    cgroup[0] = 0;
+    container[0] = 0;
+
+    if (sysctl(mib, 4, &info, &size, NULL, 0) < 0 || size != sizeof(info))
+    {
+        return -1;
+    }
+
+    if (info.ki_jid > 0)
+    {
+        snprintf(cgroup, cgroupSize, "jail/%d", info.ki_jid);
+        snprintf(container, containerSize, "jail%d", info.ki_jid);
+    }
+
+    return 0;
+}
+
+#else
+
+int resolveCgroup(int pid, char* cgroup, size_t cgroupSize, char* container, size_t containerSize)
+{
+    (void)pid;
+
+    if (cgroupSize > 0)
+    {
+        cgroup[0] = 0;
+    }
+
+    if (containerSize > 0)
+    {
+        container[0] = 0;
+    }
+
+    return -1;
+}
+
+#endif
@@ -0,0 +1,20 @@
+#ifndef CGROUP_H
+#define CGROUP_H
+
+#include <stddef.h>
+
+/*
+ * Finds what a process runs in: its cgroup and a container or service id
+ * on Linux, its jail on FreeBSD. macOS has neither, so both stay empty.
+ */
+
+#define CGROUP_SIZE 256
+#define CONTAINER_SIZE 80
+
+//returns 0 if anything was found
+int resolveCgroup(int pid, char* cgroup, size_t cgroupSize, char* container, size_t containerSize);
+
+//container or service id from a cgroup path, e.g. the short docker id
+void containerFromCgroup(const char* cgroup, char* container, size_t containerSize);
+
+#endif //CGROUP_H
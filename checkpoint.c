@@ -0,0 +1,272 @@
+#include "checkpoint.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "process.h"
+
+//host byte order, a snapshot is only read back on the machine that wrote it
+#define CHECKPOINT_MAGIC 0x50434657 //"WFCP"
+#define CHECKPOINT_VERSION 1
+#define CHECKPOINT_END 0x21444E45 //"END!"
+
+struct SavedProcess
+{
+    int pid;
+    int parentPid;
+    char processPath[MAXPATHLEN];
+    char cgroup[CGROUP_SIZE];
+    char container[CONTAINER_SIZE];
+};
+
+static int writeNumber(FILE* file, unsigned long long value)
+{
+    return fwrite(&value, sizeof(value), 1, file) == 1 ? 0 : -1;
+}
+
+static int writeText(FILE* file, const char* text)
+{
+    //longer process paths are cut, they only name the process
+    unsigned short length = (unsigned short)strnlen(text, MAXPATHLEN - 1);
+
+    if (fwrite(&length, sizeof(length), 1, file) != 1)
+    {
+        return -1;
+    }
+
+    return length == 0 || fwrite(text, length, 1, file) == 1 ? 0 : -1;
+}
+
+static int readNumber(FILE* file, unsigned long long* value)
+{
+    return fread(value, sizeof(*value), 1, file) == 1 ? 0 : -1;
+}
+
+static int readText(FILE* file, char* text, size_t size)
+{
+    unsigned short length = 0;
+
+    if (fread(&length, sizeof(length), 1, file) != 1 || length >= size)
+    {
+        return -1;
+    }
+
+    text[length] = 0;
+    return length == 0 || fread(text, length, 1, file) == 1 ? 0 : -1;
+}
+
+void checkpointSetSource(struct CheckpointSource* source, const char* path, int fd, unsigned long long position)
+{
+    struct stat status;
+
+    memset(source, 0, sizeof(struct CheckpointSource));
+    strncpy(source->path, path, sizeof(source->path) - 1);
+    source->position = position;
+    if (fstat(fd, &status) == 0)
+    {
+        source->device = (unsigned long long)status.st_dev;
+        source->inode = (unsigned long long)status.st_ino;
+    }
+}
+
+static int countProcess(const struct ProcessInfo* process, void* context)
+{
+    (void)process;
+
+    (*(unsigned long long*)context)++;
+    return 1;
+}
+
+struct ProcessWriter
+{
+    FILE* file;
+    unsigned long long written;
+};
+
+static int writeProcess(const struct ProcessInfo* process, void* context)
+{
+    struct ProcessWriter* writer = (struct ProcessWriter*)context;
+
+    if (writeNumber(writer->file, (unsigned long long)(unsigned int)process->pid) < 0
+        || writeNumber(writer->file, (unsigned long long)(unsigned int)process->parentPid) < 0
+        || writeText(writer->file, process->processPath) < 0
+        || writeText(writer->file, process->cgroup) < 0
+        || writeText(writer->file, process->container) < 0)
+    {
+        return 0;
+    }
+
+    writer->written++;
+    return 1;
+}
+
+int checkpointWrite(const char* path, const struct Checkpoint* checkpoint, int withProcesses)
+{
+    char temporary[MAXPATHLEN];
+    unsigned long long processCount = 0;
+    int failed = 0;
+
+    if (snprintf(temporary, sizeof(temporary), "%s.tmp", path) >= (int)sizeof(temporary))
+    {
+        return -1;
+    }
+
+    FILE* file = fopen(temporary, "wb");
+    if (NULL == file)
+    {
+        return -1;
+    }
+
+    if (withProcesses)
+    {
+        forEachProcess(countProcess, &processCount);
+    }
+
+    failed |= writeNumber(file, CHECKPOINT_MAGIC);
+    failed |= writeNumber(file, CHECKPOINT_VERSION);
+    failed |= writeNumber(file, checkpoint->latestTimestamp);
+    failed |= writeNumber(file, (unsigned long long)checkpoint->sourceCount);
+    for (int i = 0; i < checkpoint->sourceCount && !failed; ++i)
+    {
+        const struct CheckpointSource* source = &checkpoint->sources[i];
+        failed |= writeText(file, source->path);
+        failed |= writeNumber(file, source->device);
+        failed |= writeNumber(file, source->inode);
+        failed |= writeNumber(file, source->position);
+    }
+
+    failed |= writeNumber(file, processCount);
+    if (!failed && processCount > 0)
+    {
+        struct ProcessWriter writer = { file, 0 };
+        forEachProcess(writeProcess, &writer);
+        failed |= writer.written != processCount ? -1 : 0;
+    }
+    failed |= writeNumber(file, CHECKPOINT_END);
+
+    //the data has to be on disk before the rename makes it the snapshot
+    failed |= fflush(file) != 0 || fsync(fileno(file)) != 0 ? -1 : 0;
+    failed |= fclose(file) != 0 ? -1 : 0;
+
+    if (failed || rename(temporary, path) < 0)
+    {
+        unlink(temporary);
+        return -1;
+    }
+
+    return 0;
+}
+
+int checkpointRead(const char* path, struct Checkpoint* checkpoint, int withProcesses)
+{
+    unsigned long long value = 0;
+    unsigned long long version = 0;
+    unsigned long long count = 0;
+    int failed = 0;
+    struct SavedProcess* saved = NULL;
+    unsigned long long savedCount = 0;
+    unsigned long long savedSize = 0;
+
+    memset(checkpoint, 0, sizeof(struct Checkpoint));
+
+    FILE* file = fopen(path, "rb");
+    if (NULL == file)
+    {
+        return errno == ENOENT ? 0 : -1;
+    }
+
+    if (readNumber(file, &value) < 0 || value != CHECKPOINT_MAGIC
+        || readNumber(file, &version) < 0 || version != CHECKPOINT_VERSION
+        || readNumber(file, &checkpoint->latestTimestamp) < 0
+        || readNumber(file, &count) < 0 || count > MAX_CHECKPOINT_SOURCES)
+    {
+        fclose(file);
+        return -1;
+    }
+
+    checkpoint->sourceCount = (int)count;
+    for (int i = 0; i < checkpoint->sourceCount && !failed; ++i)
+    {
+        struct CheckpointSource* source = &checkpoint->sources[i];
+        failed |= readText(file, source->path, sizeof(source->path));
+        failed |= readNumber(file, &source->device);
+        failed |= readNumber(file, &source->inode);
+        failed |= readNumber(file, &source->position);
+    }
+
+    failed |= readNumber(file, &count);
+    for (unsigned long long i = 0; i < count && !failed; ++i)
+    {
+        unsigned long long pid = 0;
+        unsigned long long parentPid = 0;
+
+        //the count itself may be garbage, so the list grows with what is actually read
+        if (savedCount == savedSize)
+        {
+            unsigned long long size = savedSize == 0 ? 256 : savedSize * 2;
+            struct SavedProcess* grown = (struct SavedProcess*)realloc(saved, size * sizeof(struct SavedProcess));
+            if (NULL == grown)
+            {
+                failed = -1;
+                break;
+            }
+            saved = grown;
+            savedSize = size;
+        }
+
+        struct SavedProcess* process = &saved[savedCount];
+        failed |= readNumber(file, &pid);
+        failed |= readNumber(file, &parentPid);
+        failed |= readText(file, process->processPath, sizeof(process->processPath));
+        failed |= readText(file, process->cgroup, sizeof(process->cgroup));
+        failed |= readText(file, process->container, sizeof(process->container));
+        process->pid = (int)pid;
+        process->parentPid = (int)parentPid;
+        savedCount++;
+    }
+
+    //a snapshot without its end marker was cut short, none of its processes are taken then
+    failed |= readNumber(file, &value) < 0 || value != CHECKPOINT_END ? -1 : 0;
+    fclose(file);
+
+    if (!failed && withProcesses)
+    {
+        for (unsigned long long i = 0; i < savedCount; ++i)
+        {
+            restoreProcess(saved[i].pid, saved[i].parentPid, saved[i].processPath, saved[i].cgroup, saved[i].container);
+        }
+        finishProcessRestore();
+    }
+    free(saved);
+
+    return failed ? -1 : 1;
+}
+
+unsigned long long checkpointResumePosition(const struct Checkpoint* checkpoint, const char* path, int fd)
+{
+    struct stat status;
+
+    if (fstat(fd, &status) < 0)
+    {
+        return 0;
+    }
+
+    for (int i = 0; i < checkpoint->sourceCount; ++i)
+    {
+        const struct CheckpointSource* source = &checkpoint->sources[i];
+
+        if (strcmp(source->path, path) == 0
+            && source->device == (unsigned long long)status.st_dev
+            && source->inode == (unsigned long long)status.st_ino
+            && source->position <= (unsigned long long)status.st_size)
+        {
+            return source->position;
+        }
+    }
+
+    return 0;
+}
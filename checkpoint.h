@@ -0,0 +1,44 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <sys/param.h>
+
+/*
+ * Snapshot of what a restart would otherwise lose: how far each trail file
+ * was handled, the newest record time and the process table with its
+ * lineage. It is written to a temporary file and renamed over the old one,
+ * so a crash leaves either the previous or the new snapshot. A trail is
+ * only continued if it is still the same file (device and inode) and has
+ * not shrunk.
+ */
+
+#define MAX_CHECKPOINT_SOURCES 16
+
+struct CheckpointSource
+{
+    char path[MAXPATHLEN];
+    unsigned long long device;
+    unsigned long long inode;
+    unsigned long long position;
+};
+
+struct Checkpoint
+{
+    unsigned long long latestTimestamp;
+    int sourceCount;
+    struct CheckpointSource sources[MAX_CHECKPOINT_SOURCES];
+};
+
+//fills device and inode of a source from the open file
+void checkpointSetSource(struct CheckpointSource* source, const char* path, int fd, unsigned long long position);
+
+//withProcesses saves the calling thread's process table too, returns -1 on failure
+int checkpointWrite(const char* path, const struct Checkpoint* checkpoint, int withProcesses);
+
+//returns 0 if there is no snapshot yet, 1 if it was read, -1 if it is unusable
+int checkpointRead(const char* path, struct Checkpoint* checkpoint, int withProcesses);
+
+//position to continue the trail open as fd at, 0 if it changed since the snapshot
+unsigned long long checkpointResumePosition(const struct Checkpoint* checkpoint, const char* path, int fd);
+
+#endif //CHECKPOINT_H
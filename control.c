@@ -0,0 +1,171 @@
+#include "control.h"
+
+#include <errno.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#define MAX_CLIENTS 8
+#define LINE_LENGTH 256
+
+struct ControlClient
+{
+    int fd;
+    size_t used;
+    char line[LINE_LENGTH];
+};
+
+static int listenFd = -1;
+static char socketPath[sizeof(((struct sockaddr_un*)0)->sun_path)];
+static CommandHandler commandHandler = NULL;
+static void* commandContext = NULL;
+static struct ControlClient clients[MAX_CLIENTS];
+
+static void closeClient(struct EventLoop* loop, struct ControlClient* client)
+{
+    eventLoopRemoveReader(loop, client->fd);
+    close(client->fd);
+    client->fd = -1;
+}
+
+static void onClientReadable(struct EventLoop* loop, int fd, void* context)
+{
+    struct ControlClient* client = (struct ControlClient*)context;
+
+    while (1)
+    {
+        ssize_t n = read(fd, client->line + client->used, sizeof(client->line) - 1 - client->used);
+        if (n < 0 && (errno == EAGAIN || errno == EINTR))
+        {
+            return;
+        }
+        if (n <= 0)
+        {
+            closeClient(loop, client);
+            return;
+        }
+
+        client->used += n;
+        client->line[client->used] = 0;
+
+        char* newline = NULL;
+        while ((newline = strchr(client->line, '\n')) != NULL)
+        {
+            *newline = 0;
+            if (newline > client->line && newline[-1] == '\r')
+            {
+                newline[-1] = 0;
+            }
+
+            commandHandler(client->line, fd, commandContext);
+            if (client->fd < 0)
+            {
+                return;
+            }
+
+            client->used -= newline + 1 - client->line;
+            memmove(client->line, newline + 1, client->used + 1);
+        }
+
+        if (client->used == sizeof(client->line) - 1)
+        {
+            //overlong command
+            closeClient(loop, client);
+            return;
+        }
+    }
+}
+
+static void onListenReadable(struct EventLoop* loop, int fd, void* context)
+{
+    (void)context;
+
+    int clientFd = -1;
+    while ((clientFd = accept(fd, NULL, NULL)) >= 0)
+    {
+        struct ControlClient* client = NULL;
+        for (int i = 0; i < MAX_CLIENTS; ++i)
+        {
+            if (clients[i].fd < 0)
+            {
+                client = &clients[i];
+                break;
+            }
+        }
+
+        if (NULL == client || eventLoopAddReader(loop, clientFd, onClientReadable, client) < 0)
+        {
+            close(clientFd);
+            continue;
+        }
+
+        client->fd = clientFd;
+        client->used = 0;
+    }
+}
+
+int controlOpen(struct EventLoop* loop, const char* path, CommandHandler handler, void* context)
+{
+    struct sockaddr_un address;
+
+    if (strlen(path) >= sizeof(address.sun_path))
+    {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+
+    for (int i = 0; i < MAX_CLIENTS; ++i)
+    {
+        clients[i].fd = -1;
+    }
+
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, path);
+    strcpy(socketPath, path);
+
+    listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listenFd < 0)
+    {
+        return -1;
+    }
+
+    unlink(path);
+    if (bind(listenFd, (struct sockaddr*)&address, sizeof(address)) < 0
+        || listen(listenFd, MAX_CLIENTS) < 0
+        || eventLoopAddReader(loop, listenFd, onListenReadable, NULL) < 0)
+    {
+        close(listenFd);
+        listenFd = -1;
+        return -1;
+    }
+
+    commandHandler = handler;
+    commandContext = context;
+
+    return 0;
+}
+
+void controlClose(struct EventLoop* loop)
+{
+    if (listenFd < 0)
+    {
+        return;
+    }
+
+    for (int i = 0; i < MAX_CLIENTS; ++i)
+    {
+        if (clients[i].fd >= 0)
+        {
+            closeClient(loop, &clients[i]);
+        }
+    }
+
+    eventLoopRemoveReader(loop, listenFd);
+    close(listenFd);
+    listenFd = -1;
+    unlink(socketPath);
+}
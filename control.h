@@ -0,0 +1,16 @@
+#ifndef CONTROL_H
+#define CONTROL_H
+
+#include "eventloop.h"
+
+/*
+ * Unix domain control socket. Every line a client sends is passed to the
+ * command handler together with the client fd to write the reply to.
+ */
+
+typedef void (*CommandHandler)(const char* command, int clientFd, void* context);
+
+int controlOpen(struct EventLoop* loop, const char* path, CommandHandler handler, void* context);
+void controlClose(struct EventLoop* loop);
+
+#endif //CONTROL_H
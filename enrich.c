@@ -0,0 +1,693 @@
+#include "enrich.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <pwd.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#ifdef __APPLE__
+#include <libproc.h>
+#include <sys/sysctl.h>
+#endif
+
+#include "uthash.h"
+
+#define SLOT_COUNT 1024
+#define LINE_SIZE 8192
+#define MAX_WORKERS 16
+#define ARGS_SIZE 512
+#define STAT_TTL_MS 2000
+#define PROCESS_TTL_MS 5000
+#define MAX_CACHED 4096
+//slots that may wait for or be in a lookup, the others pass lines through when the workers are behind
+#define MAX_LOOKUPS (SLOT_COUNT / 2)
+//a line whose lookup takes longer goes out as it is, a hung one must not hold up the rest
+#define LOOKUP_TIMEOUT_MS 2000
+
+#define SLOT_FREE 0
+#define SLOT_PENDING 1
+#define SLOT_WORKING 2
+#define SLOT_DONE 3
+
+struct EnrichSlot
+{
+    int state;
+    unsigned long long sequence; //tail when submitted, tells a reused slot apart
+    unsigned long long deadline;
+    struct AuditEntry entry;
+    size_t length;
+    char line[LINE_SIZE];
+};
+
+struct UserName
+{
+    int uid;
+    char name[64];
+    UT_hash_handle hh;
+};
+
+struct FileInfo
+{
+    unsigned long long expires;
+    int found;
+    long long size;
+    unsigned int mode;
+    int uid;
+    UT_hash_handle hh;
+    char path[]; //key
+};
+
+struct ProcessDetails
+{
+    int pid;
+    unsigned long long expires;
+    char args[ARGS_SIZE];
+    char cwd[MAXPATHLEN];
+    UT_hash_handle hh;
+};
+
+static struct EnrichSlot* slots = NULL;
+static unsigned long long head = 0; //next to hand out, main thread only
+static unsigned long long tail = 0; //next to fill, written by the main thread under the lock
+static unsigned long long claim = 0; //next for a worker
+static unsigned int lookups = 0; //pending and working slots, under the lock
+static int enrichKinds = 0;
+static int workerCount = 0;
+static int stopping = 0;
+static int notifyPipe[2] = { -1, -1 };
+static unsigned long long skipped = 0;
+static pthread_t workers[MAX_WORKERS];
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t wakeup = PTHREAD_COND_INITIALIZER;
+
+//caches shared by the workers, each with its own lock
+static struct UserName* users = NULL;
+static struct FileInfo* files = NULL;
+static struct ProcessDetails* details = NULL;
+static pthread_mutex_t usersLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t filesLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t detailsLock = PTHREAD_MUTEX_INITIALIZER;
+
+static unsigned long long nowMilliseconds(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (unsigned long long)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+int enrichParseKinds(const char* text)
+{
+    int kinds = 0;
+    char name[16];
+
+    while (*text)
+    {
+        size_t length = strcspn(text, ",");
+        if (length == 0 || length >= sizeof(name))
+        {
+            return -1;
+        }
+
+        memcpy(name, text, length);
+        name[length] = 0;
+
+        if (strcmp(name, "user") == 0)
+        {
+            kinds |= ENRICH_USER;
+        }
+        else if (strcmp(name, "args") == 0)
+        {
+            kinds |= ENRICH_ARGS;
+        }
+        else if (strcmp(name, "cwd") == 0)
+        {
+            kinds |= ENRICH_CWD;
+        }
+        else if (strcmp(name, "file") == 0)
+        {
+            kinds |= ENRICH_FILE;
+        }
+        else
+        {
+            return -1;
+        }
+
+        text += length;
+        if (*text == ',')
+        {
+            text++;
+        }
+    }
+
+    return kinds;
+}
+
+//user names hardly ever change, so they are kept for good
+static void lookupUser(int uid, char* name, size_t size)
+{
+    struct UserName* u = NULL;
+
+    if (uid < 0)
+    {
+        snprintf(name, size, "-");
+        return;
+    }
+
+    pthread_mutex_lock(&usersLock);
+    HASH_FIND_INT(users, &uid, u);
+    if (NULL != u)
+    {
+        snprintf(name, size, "%s", u->name);
+        pthread_mutex_unlock(&usersLock);
+        return;
+    }
+    pthread_mutex_unlock(&usersLock);
+
+    struct passwd entry;
+    struct passwd* result = NULL;
+    char buffer[1024];
+
+    u = (struct UserName*)malloc(sizeof(struct UserName));
+    memset(u, 0, sizeof(struct UserName));
+    u->uid = uid;
+    if (getpwuid_r((uid_t)uid, &entry, buffer, sizeof(buffer), &result) == 0 && NULL != result)
+    {
+        snprintf(u->name, sizeof(u->name), "%s", result->pw_name);
+    }
+    else
+    {
+        snprintf(u->name, sizeof(u->name), "%d", uid);
+    }
+    snprintf(name, size, "%s", u->name);
+
+    pthread_mutex_lock(&usersLock);
+    struct UserName* existing = NULL;
+    HASH_FIND_INT(users, &uid, existing);
+    if (NULL == existing)
+    {
+        HASH_ADD_INT(users, uid, u);
+        u = NULL;
+    }
+    pthread_mutex_unlock(&usersLock);
+    free(u);
+}
+
+//the oldest entries go first when a cache is full
+#define TRIM_CACHE(cache, type) \
+    while (HASH_COUNT(cache) >= MAX_CACHED) \
+    { \
+        type* oldest = cache; \
+        HASH_DEL(cache, oldest); \
+        free(oldest); \
+    }
+
+static void lookupFile(const char* path, struct FileInfo* info)
+{
+    struct FileInfo* f = NULL;
+    size_t length = strlen(path);
+    unsigned long long now = nowMilliseconds();
+
+    pthread_mutex_lock(&filesLock);
+    HASH_FIND(hh, files, path, length, f);
+    if (NULL != f && f->expires > now)
+    {
+        memcpy(info, f, sizeof(struct FileInfo));
+        pthread_mutex_unlock(&filesLock);
+        return;
+    }
+    pthread_mutex_unlock(&filesLock);
+
+    struct stat st;
+    memset(info, 0, sizeof(struct FileInfo));
+    if (lstat(path, &st) == 0)
+    {
+        info->found = 1;
+        info->size = (long long)st.st_size;
+        info->mode = (unsigned int)st.st_mode;
+        info->uid = (int)st.st_uid;
+    }
+    info->expires = now + STAT_TTL_MS;
+
+    pthread_mutex_lock(&filesLock);
+    HASH_FIND(hh, files, path, length, f);
+    if (NULL != f)
+    {
+        HASH_DEL(files, f);
+        free(f);
+    }
+    TRIM_CACHE(files, struct FileInfo);
+    f = (struct FileInfo*)malloc(sizeof(struct FileInfo) + length + 1);
+    if (NULL != f)
+    {
+        memcpy(f, info, sizeof(struct FileInfo));
+        memcpy(f->path, path, length + 1);
+        HASH_ADD_KEYPTR(hh, files, f->path, length, f);
+    }
+    pthread_mutex_unlock(&filesLock);
+}
+
+#ifdef __APPLE__
+
+static void readProcess(int pid, struct ProcessDetails* d)
+{
+    int argMax = 0;
+    size_t size = sizeof(argMax);
+    int argMaxMib[2] = { CTL_KERN, KERN_ARGMAX };
+
+    if (sysctl(argMaxMib, 2, &argMax, &size, NULL, 0) == 0 && argMax > 0)
+    {
+        char* buffer = (char*)malloc(argMax);
+        int mib[3] = { CTL_KERN, KERN_PROCARGS2, pid };
+        size = (size_t)argMax;
+
+        //argc, the executable path, padding, then the arguments
+        if (NULL != buffer && sysctl(mib, 3, buffer, &size, NULL, 0) == 0 && size > sizeof(int))
+        {
+            int argc = 0;
+            memcpy(&argc, buffer, sizeof(int));
+            char* p = buffer + sizeof(int);
+            char* end = buffer + size;
+            p += strnlen(p, end - p);
+            while (p < end && *p == 0)
+            {
+                p++;
+            }
+
+            size_t used = 0;
+            for (int i = 0; i < argc && p < end && used + 1 < sizeof(d->args); ++i)
+            {
+                size_t length = strnlen(p, end - p);
+                used += snprintf(d->args + used, sizeof(d->args) - used, i == 0 ? "%.*s" : " %.*s", (int)length, p);
+                p += length + 1;
+            }
+        }
+        free(buffer);
+    }
+
+    struct proc_vnodepathinfo paths;
+    if (proc_pidinfo(pid, PROC_PIDVNODEPATHINFO, 0, &paths, sizeof(paths)) == sizeof(paths))
+    {
+        snprintf(d->cwd, sizeof(d->cwd), "%s", paths.pvi_cdir.vip_path);
+    }
+}
+
+#elif defined(__linux__)
+
+static void readProcess(int pid, struct ProcessDetails* d)
+{
+    char path[64];
+
+    snprintf(path, sizeof(path), "/proc/%d/cmdline", pid);
+    int fd = open(path, O_RDONLY);
+    if (fd >= 0)
+    {
+        ssize_t n = read(fd, d->args, sizeof(d->args) - 1);
+        close(fd);
+        if (n > 0)
+        {
+            //arguments are separated by NULs
+            for (ssize_t i = 0; i < n - 1; ++i)
+            {
+                if (d->args[i] == 0)
+                {
+                    d->args[i] = ' ';
+                }
+            }
+            d->args[n] = 0;
+        }
+    }
+
+    snprintf(path, sizeof(path), "/proc/%d/cwd", pid);
+    ssize_t n = readlink(path, d->cwd, sizeof(d->cwd) - 1);
+    d->cwd[n > 0 ? n : 0] = 0;
+}
+
+#else
+
+static void readProcess(int pid, struct ProcessDetails* d)
+{
+    (void)pid;
+    (void)d;
+}
+
+#endif
+
+static void lookupProcess(int pid, struct ProcessDetails* result)
+{
+    struct ProcessDetails* d = NULL;
+    unsigned long long now = nowMilliseconds();
+
+    pthread_mutex_lock(&detailsLock);
+    HASH_FIND_INT(details, &pid, d);
+    if (NULL != d && d->expires > now)
+    {
+        memcpy(result, d, sizeof(struct ProcessDetails));
+        pthread_mutex_unlock(&detailsLock);
+        return;
+    }
+    pthread_mutex_unlock(&detailsLock);
+
+    memset(result, 0, sizeof(struct ProcessDetails));
+    result->pid = pid;
+    readProcess(pid, result);
+    result->expires = now + PROCESS_TTL_MS;
+
+    pthread_mutex_lock(&detailsLock);
+    HASH_FIND_INT(details, &pid, d);
+    if (NULL != d)
+    {
+        HASH_DEL(details, d);
+        free(d);
+    }
+    TRIM_CACHE(details, struct ProcessDetails);
+    d = (struct ProcessDetails*)malloc(sizeof(struct ProcessDetails));
+    if (NULL != d)
+    {
+        memcpy(d, result, sizeof(struct ProcessDetails));
+        HASH_ADD_INT(details, pid, d);
+    }
+    pthread_mutex_unlock(&detailsLock);
+}
+
+static void append(struct EnrichSlot* slot, const char* format, ...) __attribute__((format(printf, 2, 3)));
+
+static void append(struct EnrichSlot* slot, const char* format, ...)
+{
+    va_list args;
+
+    if (slot->length + 1 >= sizeof(slot->line))
+    {
+        return;
+    }
+
+    va_start(args, format);
+    int written = vsnprintf(slot->line + slot->length, sizeof(slot->line) - slot->length, format, args);
+    va_end(args);
+
+    if (written > 0)
+    {
+        slot->length += (size_t)written;
+        if (slot->length >= sizeof(slot->line))
+        {
+            slot->length = sizeof(slot->line) - 1;
+        }
+    }
+}
+
+static void enrichSlot(struct EnrichSlot* slot)
+{
+    char name[64];
+
+    if (enrichKinds & ENRICH_USER)
+    {
+        lookupUser(slot->entry.userId, name, sizeof(name));
+        append(slot, " user:%s", name);
+    }
+
+    if (enrichKinds & (ENRICH_ARGS | ENRICH_CWD))
+    {
+        struct ProcessDetails d;
+        lookupProcess(slot->entry.pid, &d);
+        if (enrichKinds & ENRICH_ARGS)
+        {
+            append(slot, " args:\"%s\"", d.args);
+        }
+        if (enrichKinds & ENRICH_CWD)
+        {
+            append(slot, " cwd:%s", d.cwd[0] != 0 ? d.cwd : "-");
+        }
+    }
+
+    if ((enrichKinds & ENRICH_FILE) && slot->entry.pathLength > 0)
+    {
+        struct FileInfo f;
+        lookupFile(slot->entry.path, &f);
+        if (f.found)
+        {
+            lookupUser(f.uid, name, sizeof(name));
+            append(slot, " size:%lld mode:%o owner:%s", f.size, f.mode & 07777, name);
+        }
+        else
+        {
+            append(slot, " size:- mode:- owner:-");
+        }
+    }
+}
+
+static void* workerMain(void* argument)
+{
+    (void)argument;
+
+    for (;;)
+    {
+        pthread_mutex_lock(&lock);
+        while (!stopping && claim == tail)
+        {
+            pthread_cond_wait(&wakeup, &lock);
+        }
+
+        if (claim == tail)
+        {
+            pthread_mutex_unlock(&lock);
+            return NULL;
+        }
+
+        struct EnrichSlot* slot = &slots[claim % SLOT_COUNT];
+        unsigned long long sequence = claim;
+        claim++;
+        //passed through or timed out, nothing to look up
+        if (slot->state != SLOT_PENDING || slot->sequence != sequence)
+        {
+            pthread_mutex_unlock(&lock);
+            continue;
+        }
+        slot->state = SLOT_WORKING;
+        //the slot may be handed out and reused while the lookup hangs, so it works on a copy
+        struct EnrichSlot work;
+        memcpy(&work, slot, sizeof(work));
+        pthread_mutex_unlock(&lock);
+
+        enrichSlot(&work);
+
+        pthread_mutex_lock(&lock);
+        if (slot->state == SLOT_WORKING && slot->sequence == sequence)
+        {
+            memcpy(slot->line, work.line, work.length + 1);
+            slot->length = work.length;
+            slot->state = SLOT_DONE;
+        }
+        lookups--;
+        pthread_mutex_unlock(&lock);
+
+        //a full pipe already has the main thread's attention
+        char byte = 0;
+        if (write(notifyPipe[1], &byte, 1) < 0 && errno != EAGAIN)
+        {
+            perror("enrich notify");
+        }
+    }
+}
+
+int enrichStart(int kinds, int count)
+{
+    if (kinds == 0 || NULL != slots)
+    {
+        return -1;
+    }
+
+    slots = (struct EnrichSlot*)calloc(SLOT_COUNT, sizeof(struct EnrichSlot));
+    if (NULL == slots || pipe(notifyPipe) < 0)
+    {
+        free(slots);
+        slots = NULL;
+        return -1;
+    }
+
+    fcntl(notifyPipe[0], F_SETFL, fcntl(notifyPipe[0], F_GETFL) | O_NONBLOCK);
+    fcntl(notifyPipe[1], F_SETFL, fcntl(notifyPipe[1], F_GETFL) | O_NONBLOCK);
+
+    enrichKinds = kinds;
+    count = count < 1 ? 1 : count > MAX_WORKERS ? MAX_WORKERS : count;
+
+    //the workers inherit the mask, so the signals the event loop reads never land on them
+    sigset_t blocked;
+    sigset_t saved;
+    sigemptyset(&blocked);
+    sigaddset(&blocked, SIGINT);
+    sigaddset(&blocked, SIGTERM);
+    sigaddset(&blocked, SIGHUP);
+    pthread_sigmask(SIG_BLOCK, &blocked, &saved);
+    for (workerCount = 0; workerCount < count; ++workerCount)
+    {
+        if (pthread_create(&workers[workerCount], NULL, workerMain, NULL) != 0)
+        {
+            break;
+        }
+    }
+    pthread_sigmask(SIG_SETMASK, &saved, NULL);
+
+    return workerCount > 0 ? notifyPipe[0] : -1;
+}
+
+int isEnrichEnabled(void)
+{
+    return NULL != slots && workerCount > 0;
+}
+
+static int isSlotFree(const struct EnrichSlot* slot)
+{
+    pthread_mutex_lock(&lock);
+    int state = slot->state;
+    pthread_mutex_unlock(&lock);
+
+    return state == SLOT_FREE;
+}
+
+void enrichSubmit(const struct AuditEntry* entry, const char* line, size_t length, EnrichedLine handler, void* context)
+{
+    struct EnrichSlot* slot = &slots[tail % SLOT_COUNT];
+
+    //every slot holds a line not handed out yet, this one has to keep its place behind them
+    while (!isSlotFree(slot))
+    {
+        struct timespec pause = { 0, 1000000 };
+        enrichCollect(handler, context);
+        if (!isSlotFree(slot))
+        {
+            nanosleep(&pause, NULL);
+        }
+    }
+
+    //a free slot is only touched by this thread until it is queued
+    memcpy(&slot->entry, entry, sizeof(struct AuditEntry));
+    slot->length = length < sizeof(slot->line) ? length : sizeof(slot->line) - 1;
+    memcpy(slot->line, line, slot->length);
+    slot->line[slot->length] = 0;
+
+    pthread_mutex_lock(&lock);
+    slot->sequence = tail;
+    slot->deadline = nowMilliseconds() + LOOKUP_TIMEOUT_MS;
+    int passThrough = lookups >= MAX_LOOKUPS;
+    if (passThrough)
+    {
+        //the workers are behind, the line goes out as it is but in its turn
+        slot->state = SLOT_DONE;
+        skipped++;
+    }
+    else
+    {
+        slot->state = SLOT_PENDING;
+        lookups++;
+    }
+    tail++;
+    pthread_cond_signal(&wakeup);
+    pthread_mutex_unlock(&lock);
+
+    //nothing else may wake the main thread if the lines before it are done already
+    char byte = 0;
+    if (passThrough && write(notifyPipe[1], &byte, 1) < 0 && errno != EAGAIN)
+    {
+        perror("enrich notify");
+    }
+}
+
+void enrichCollect(EnrichedLine handler, void* context)
+{
+    char drain[256];
+
+    if (NULL == slots)
+    {
+        return;
+    }
+
+    while (read(notifyPipe[0], drain, sizeof(drain)) > 0)
+    {
+    }
+
+    unsigned long long now = nowMilliseconds();
+    while (head < tail)
+    {
+        struct EnrichSlot* slot = &slots[head % SLOT_COUNT];
+
+        pthread_mutex_lock(&lock);
+        int state = slot->state;
+        if (state != SLOT_DONE && now >= slot->deadline)
+        {
+            //the line is still as submitted, a worker that comes back late drops its copy
+            if (state == SLOT_PENDING)
+            {
+                lookups--;
+            }
+            slot->state = SLOT_DONE;
+            state = SLOT_DONE;
+            skipped++;
+        }
+        pthread_mutex_unlock(&lock);
+
+        if (state != SLOT_DONE)
+        {
+            break;
+        }
+
+        handler(slot->line, slot->length, context);
+
+        pthread_mutex_lock(&lock);
+        slot->state = SLOT_FREE;
+        pthread_mutex_unlock(&lock);
+        head++;
+    }
+}
+
+void enrichDrain(EnrichedLine handler, void* context)
+{
+    if (NULL == slots)
+    {
+        return;
+    }
+
+    while (head < tail)
+    {
+        struct timespec pause = { 0, 1000000 };
+        enrichCollect(handler, context);
+        nanosleep(&pause, NULL);
+    }
+}
+
+void enrichFinish(EnrichedLine handler, void* context)
+{
+    if (NULL == slots)
+    {
+        return;
+    }
+
+    enrichDrain(handler, context);
+
+    pthread_mutex_lock(&lock);
+    stopping = 1;
+    pthread_cond_broadcast(&wakeup);
+    pthread_mutex_unlock(&lock);
+
+    for (int i = 0; i < workerCount; ++i)
+    {
+        pthread_join(workers[i], NULL);
+    }
+
+    close(notifyPipe[0]);
+    close(notifyPipe[1]);
+    free(slots);
+    slots = NULL;
+    workerCount = 0;
+}
+
+unsigned long long getEnrichSkipped(void)
+{
+    return skipped;
+}
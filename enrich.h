@@ -0,0 +1,46 @@
+#ifndef ENRICH_H
+#define ENRICH_H
+
+#include <stddef.h>
+
+#include "entry.h"
+
+/*
+ * Adds user names, process arguments and working directory, and file
+ * size, mode and owner to lines that already passed every filter. The
+ * lookups run on a pool of worker threads with their own caches, so a slow
+ * lookup never holds up reading records. Lines come back in the order they
+ * were submitted. When the workers are behind a line is queued as it is,
+ * without a lookup, and only a full queue waits for the oldest line. A
+ * line whose lookup is not back within two seconds goes out as it is too.
+ */
+
+#define ENRICH_USER 1
+#define ENRICH_ARGS 2
+#define ENRICH_CWD 4
+#define ENRICH_FILE 8
+
+typedef void (*EnrichedLine)(const char* line, size_t length, void* context);
+
+//kinds is a comma separated list of user, args, cwd and file, returns -1 if invalid
+int enrichParseKinds(const char* text);
+
+//returns the fd that becomes readable when lines are ready, -1 on failure
+int enrichStart(int kinds, int workers);
+int isEnrichEnabled(void);
+
+//line is the formatted event without the newline, a full queue hands its oldest lines to handler first
+void enrichSubmit(const struct AuditEntry* entry, const char* line, size_t length, EnrichedLine handler, void* context);
+
+//hands finished lines to handler in submission order
+void enrichCollect(EnrichedLine handler, void* context);
+
+//waits for the submitted lines and hands them to handler
+void enrichDrain(EnrichedLine handler, void* context);
+
+//waits for the submitted lines, hands them to handler and stops the workers
+void enrichFinish(EnrichedLine handler, void* context);
+
+unsigned long long getEnrichSkipped(void);
+
+#endif //ENRICH_H
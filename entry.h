@@ -0,0 +1,26 @@
+#ifndef ENTRY_H
+#define ENTRY_H
+
+#include <stddef.h>
+#include <sys/param.h>
+
+//one decoded file event, whatever source it came from
+struct AuditEntry
+{
+    char path[MAXPATHLEN];
+    size_t pathLength;
+    int pid;
+    int userId;
+    int type;
+    int childPid;
+    int parentPid; //0 if the source does not tell
+    unsigned long long timestamp; //milliseconds since the epoch
+    unsigned long long position; //offset of the record in its trail file, for checkpoints
+    unsigned int device; //of the file acted on, 0 with the inode if the source does not tell
+    unsigned long long inode;
+    char processPath[MAXPATHLEN]; //empty if the source does not tell, it is looked up then
+};
+
+typedef void (*EntryHandler)(struct AuditEntry* entry, void* context);
+
+#endif //ENTRY_H
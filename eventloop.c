@@ -0,0 +1,420 @@
+#include "eventloop.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#if defined(__APPLE__) || defined(__FreeBSD__) || defined(__NetBSD__) || defined(__OpenBSD__)
+#define HAVE_KQUEUE 1
+#include <sys/event.h>
+#else
+#include <sys/epoll.h>
+#include <sys/inotify.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+#endif
+
+#define MAX_HANDLERS 64
+#define EVENTS_PER_WAIT 32
+
+#define HANDLER_READER 0
+#define HANDLER_TIMER 1
+#define HANDLER_SIGNAL 2
+#define HANDLER_WATCH 3
+
+struct Handler
+{
+    int used;
+    int kind;
+    int fd; //reader fd, timerfd/signalfd/inotify on Linux, signal number for kqueue signals, watched file for kqueue
+    int ident;
+    EventCallback callback;
+    void* context;
+};
+
+struct EventLoop
+{
+    int pollFd;
+    int running;
+    int nextTimerId;
+    IdleCallback idle;
+    void* idleContext;
+    struct Handler handlers[MAX_HANDLERS];
+};
+
+static struct Handler* addHandler(struct EventLoop* loop, int kind, EventCallback callback, void* context)
+{
+    for (int i = 0; i < MAX_HANDLERS; ++i)
+    {
+        if (!loop->handlers[i].used)
+        {
+            struct Handler* h = &loop->handlers[i];
+            memset(h, 0, sizeof(struct Handler));
+            h->used = 1;
+            h->kind = kind;
+            h->fd = -1;
+            h->callback = callback;
+            h->context = context;
+            return h;
+        }
+    }
+
+    errno = ENOSPC;
+    return NULL;
+}
+
+static int setNonBlocking(int fd)
+{
+    int flags = fcntl(fd, F_GETFL, 0);
+
+    if (flags < 0)
+    {
+        return -1;
+    }
+
+    return fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+struct EventLoop* eventLoopCreate(void)
+{
+    struct EventLoop* loop = (struct EventLoop*)malloc(sizeof(struct EventLoop));
+    memset(loop, 0, sizeof(struct EventLoop));
+
+#ifdef HAVE_KQUEUE
+    loop->pollFd = kqueue();
+#else
+    loop->pollFd = epoll_create1(EPOLL_CLOEXEC);
+#endif
+
+    if (loop->pollFd < 0)
+    {
+        free(loop);
+        return NULL;
+    }
+
+    return loop;
+}
+
+void eventLoopDestroy(struct EventLoop* loop)
+{
+    if (NULL == loop)
+    {
+        return;
+    }
+
+    for (int i = 0; i < MAX_HANDLERS; ++i)
+    {
+        struct Handler* h = &loop->handlers[i];
+#ifdef HAVE_KQUEUE
+        if (h->used && h->kind == HANDLER_WATCH)
+#else
+        if (h->used && h->kind != HANDLER_READER)
+#endif
+        {
+            close(h->fd);
+        }
+    }
+
+    close(loop->pollFd);
+    free(loop);
+}
+
+#ifndef HAVE_KQUEUE
+static int epollAdd(struct EventLoop* loop, struct Handler* h)
+{
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.ptr = h;
+
+    return epoll_ctl(loop->pollFd, EPOLL_CTL_ADD, h->fd, &ev);
+}
+#endif
+
+int eventLoopAddReader(struct EventLoop* loop, int fd, EventCallback callback, void* context)
+{
+    struct Handler* h = addHandler(loop, HANDLER_READER, callback, context);
+
+    if (NULL == h || setNonBlocking(fd) < 0)
+    {
+        if (h)
+        {
+            h->used = 0;
+        }
+        return -1;
+    }
+
+    h->fd = fd;
+    h->ident = fd;
+
+#ifdef HAVE_KQUEUE
+    struct kevent change;
+    EV_SET(&change, fd, EVFILT_READ, EV_ADD, 0, 0, h);
+    if (kevent(loop->pollFd, &change, 1, NULL, 0, NULL) < 0)
+#else
+    if (epollAdd(loop, h) < 0)
+#endif
+    {
+        h->used = 0;
+        return -1;
+    }
+
+    return 0;
+}
+
+int eventLoopRemoveReader(struct EventLoop* loop, int fd)
+{
+    for (int i = 0; i < MAX_HANDLERS; ++i)
+    {
+        struct Handler* h = &loop->handlers[i];
+        if (h->used && h->kind == HANDLER_READER && h->fd == fd)
+        {
+#ifdef HAVE_KQUEUE
+            struct kevent change;
+            EV_SET(&change, fd, EVFILT_READ, EV_DELETE, 0, 0, NULL);
+            kevent(loop->pollFd, &change, 1, NULL, 0, NULL);
+#else
+            epoll_ctl(loop->pollFd, EPOLL_CTL_DEL, fd, NULL);
+#endif
+            h->used = 0;
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+int eventLoopAddTimer(struct EventLoop* loop, int intervalMs, EventCallback callback, void* context)
+{
+    struct Handler* h = addHandler(loop, HANDLER_TIMER, callback, context);
+
+    if (NULL == h)
+    {
+        return -1;
+    }
+
+    h->ident = ++loop->nextTimerId;
+
+#ifdef HAVE_KQUEUE
+    struct kevent change;
+    EV_SET(&change, h->ident, EVFILT_TIMER, EV_ADD, 0, intervalMs, h);
+    if (kevent(loop->pollFd, &change, 1, NULL, 0, NULL) < 0)
+    {
+        h->used = 0;
+        return -1;
+    }
+#else
+    struct itimerspec spec;
+    memset(&spec, 0, sizeof(spec));
+    spec.it_interval.tv_sec = intervalMs / 1000;
+    spec.it_interval.tv_nsec = (long)(intervalMs % 1000) * 1000000;
+    spec.it_value = spec.it_interval;
+
+    h->fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (h->fd < 0 || timerfd_settime(h->fd, 0, &spec, NULL) < 0 || epollAdd(loop, h) < 0)
+    {
+        if (h->fd >= 0)
+        {
+            close(h->fd);
+        }
+        h->used = 0;
+        return -1;
+    }
+#endif
+
+    return h->ident;
+}
+
+int eventLoopAddWatch(struct EventLoop* loop, const char* path, EventCallback callback, void* context)
+{
+    struct Handler* h = addHandler(loop, HANDLER_WATCH, callback, context);
+
+    if (NULL == h)
+    {
+        return -1;
+    }
+
+    h->ident = ++loop->nextTimerId;
+
+#ifdef HAVE_KQUEUE
+#ifdef O_EVTONLY
+    h->fd = open(path, O_EVTONLY);
+#else
+    h->fd = open(path, O_RDONLY);
+#endif
+    struct kevent change;
+    EV_SET(&change, h->fd, EVFILT_VNODE, EV_ADD | EV_CLEAR,
+        NOTE_WRITE | NOTE_EXTEND | NOTE_ATTRIB | NOTE_RENAME | NOTE_DELETE, 0, h);
+    if (h->fd < 0 || kevent(loop->pollFd, &change, 1, NULL, 0, NULL) < 0)
+#else
+    h->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (h->fd < 0
+        || inotify_add_watch(h->fd, path, IN_MODIFY | IN_ATTRIB | IN_CREATE | IN_MOVED_TO | IN_MOVE_SELF | IN_DELETE_SELF) < 0
+        || epollAdd(loop, h) < 0)
+#endif
+    {
+        if (h->fd >= 0)
+        {
+            close(h->fd);
+        }
+        h->used = 0;
+        return -1;
+    }
+
+    return h->ident;
+}
+
+int eventLoopRemoveWatch(struct EventLoop* loop, int id)
+{
+    for (int i = 0; i < MAX_HANDLERS; ++i)
+    {
+        struct Handler* h = &loop->handlers[i];
+        if (h->used && h->kind == HANDLER_WATCH && h->ident == id)
+        {
+            //closing the fd also drops its kevent or epoll registration
+            close(h->fd);
+            h->used = 0;
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+int eventLoopAddSignal(struct EventLoop* loop, int signalNumber, EventCallback callback, void* context)
+{
+    struct Handler* h = addHandler(loop, HANDLER_SIGNAL, callback, context);
+
+    if (NULL == h)
+    {
+        return -1;
+    }
+
+    h->ident = signalNumber;
+
+#ifdef HAVE_KQUEUE
+    struct kevent change;
+    signal(signalNumber, SIG_IGN);
+    EV_SET(&change, signalNumber, EVFILT_SIGNAL, EV_ADD, 0, 0, h);
+    if (kevent(loop->pollFd, &change, 1, NULL, 0, NULL) < 0)
+    {
+        h->used = 0;
+        return -1;
+    }
+#else
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, signalNumber);
+    sigprocmask(SIG_BLOCK, &mask, NULL);
+
+    h->fd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (h->fd < 0 || epollAdd(loop, h) < 0)
+    {
+        if (h->fd >= 0)
+        {
+            close(h->fd);
+        }
+        h->used = 0;
+        return -1;
+    }
+#endif
+
+    return 0;
+}
+
+static void dispatch(struct EventLoop* loop, struct Handler* h)
+{
+    if (!h->used)
+    {
+        //removed by an earlier callback of the same batch
+        return;
+    }
+
+#ifndef HAVE_KQUEUE
+    if (h->kind == HANDLER_TIMER)
+    {
+        uint64_t expirations = 0;
+        if (read(h->fd, &expirations, sizeof(expirations)) < 0)
+        {
+            return;
+        }
+    }
+    else if (h->kind == HANDLER_SIGNAL)
+    {
+        struct signalfd_siginfo info;
+        while (read(h->fd, &info, sizeof(info)) == sizeof(info))
+        {
+        }
+    }
+    else if (h->kind == HANDLER_WATCH)
+    {
+        //the callback looks at the file itself, the event details are not needed
+        char events[4096];
+        while (read(h->fd, events, sizeof(events)) > 0)
+        {
+        }
+    }
+#endif
+
+    h->callback(loop, h->kind == HANDLER_READER ? h->fd : h->ident, h->context);
+}
+
+void eventLoopSetIdle(struct EventLoop* loop, IdleCallback callback, void* context)
+{
+    loop->idle = callback;
+    loop->idleContext = context;
+}
+
+int eventLoopRun(struct EventLoop* loop)
+{
+    int pending = 0;
+
+    loop->running = 1;
+
+    while (loop->running)
+    {
+#ifdef HAVE_KQUEUE
+        struct kevent events[EVENTS_PER_WAIT];
+        struct timespec zero = { 0, 0 };
+        int count = kevent(loop->pollFd, NULL, 0, events, EVENTS_PER_WAIT, pending ? &zero : NULL);
+#else
+        struct epoll_event events[EVENTS_PER_WAIT];
+        int count = epoll_wait(loop->pollFd, events, EVENTS_PER_WAIT, pending ? 0 : -1);
+#endif
+
+        if (count < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return -1;
+        }
+
+        for (int i = 0; i < count && loop->running; ++i)
+        {
+#ifdef HAVE_KQUEUE
+            dispatch(loop, (struct Handler*)events[i].udata);
+#else
+            dispatch(loop, (struct Handler*)events[i].data.ptr);
+#endif
+        }
+
+        if (NULL != loop->idle && loop->running)
+        {
+            pending = loop->idle(loop, loop->idleContext);
+        }
+    }
+
+    return 0;
+}
+
+void eventLoopStop(struct EventLoop* loop)
+{
+    loop->running = 0;
+}
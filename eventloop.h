@@ -0,0 +1,39 @@
+#ifndef EVENTLOOP_H
+#define EVENTLOOP_H
+
+/*
+ * Single threaded readiness loop over kqueue, or epoll with timerfd,
+ * signalfd and inotify on Linux. Readers are expected to drain their fd in bounded
+ * batches and return, so one busy source can't starve the others.
+ */
+
+struct EventLoop;
+
+typedef void (*EventCallback)(struct EventLoop* loop, int fd, void* context);
+
+struct EventLoop* eventLoopCreate(void);
+void eventLoopDestroy(struct EventLoop* loop);
+
+//fds are switched to non-blocking mode
+int eventLoopAddReader(struct EventLoop* loop, int fd, EventCallback callback, void* context);
+int eventLoopRemoveReader(struct EventLoop* loop, int fd);
+
+int eventLoopAddTimer(struct EventLoop* loop, int intervalMs, EventCallback callback, void* context);
+
+//calls back when the file or directory at path is written, renamed or
+//removed, fd is the returned watch id
+int eventLoopAddWatch(struct EventLoop* loop, const char* path, EventCallback callback, void* context);
+int eventLoopRemoveWatch(struct EventLoop* loop, int id);
+
+//the signal is no longer delivered asynchronously, fd is the signal number
+int eventLoopAddSignal(struct EventLoop* loop, int signalNumber, EventCallback callback, void* context);
+
+//called after every batch of events, returning non-zero means there is more
+//work queued and the loop only polls instead of sleeping
+typedef int (*IdleCallback)(struct EventLoop* loop, void* context);
+void eventLoopSetIdle(struct EventLoop* loop, IdleCallback callback, void* context);
+
+int eventLoopRun(struct EventLoop* loop);
+void eventLoopStop(struct EventLoop* loop);
+
+#endif //EVENTLOOP_H
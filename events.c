@@ -0,0 +1,431 @@
+#include "events.h"
+
+#include <string.h>
+#include <stdlib.h>
+
+#include "inttable.h"
+
+#include "eventcatalog.h"
+
+#define BSM_EVENT_COUNT (sizeof(bsmEvents) / sizeof(bsmEvents[0]))
+
+struct LinuxSyscall
+{
+    const char* name;
+    int x86_64;
+    int aarch64;
+    const char* event;
+};
+
+//-1 where the architecture has no such syscall
+static const struct LinuxSyscall linuxSyscalls[] = {
+    { "read", 0, 63, "AUE_READ" },
+    { "write", 1, 64, "AUE_WRITE" },
+    { "open", 2, -1, "AUE_OPEN" },
+    { "close", 3, 57, "AUE_CLOSE" },
+    { "pread64", 17, 67, "AUE_PREAD" },
+    { "pwrite64", 18, 68, "AUE_PWRITE" },
+    { "clone", 56, 220, "AUE_FORK" },
+    { "fork", 57, -1, "AUE_FORK" },
+    { "vfork", 58, -1, "AUE_VFORK" },
+    { "execve", 59, 221, "AUE_EXECVE" },
+    { "exit", 60, 93, "AUE_EXIT" },
+    { "truncate", 76, 45, "AUE_TRUNCATE" },
+    { "ftruncate", 77, 46, "AUE_FTRUNCATE" },
+    { "rename", 82, -1, "AUE_RENAME" },
+    { "mkdir", 83, -1, "AUE_MKDIR" },
+    { "rmdir", 84, -1, "AUE_RMDIR" },
+    { "creat", 85, -1, "AUE_CREAT" },
+    { "link", 86, -1, "AUE_LINK" },
+    { "unlink", 87, -1, "AUE_UNLINK" },
+    { "symlink", 88, -1, "AUE_SYMLINK" },
+    { "chmod", 90, -1, "AUE_CHMOD" },
+    { "fchmod", 91, 52, "AUE_FCHMOD" },
+    { "chown", 92, -1, "AUE_CHOWN" },
+    { "fchown", 93, 55, "AUE_FCHOWN" },
+    { "lchown", 94, -1, "AUE_LCHOWN" },
+    { "exit_group", 231, 94, "AUE_EXIT" },
+    { "openat", 257, 56, "AUE_OPENAT" },
+    { "mkdirat", 258, 34, "AUE_MKDIRAT" },
+    { "fchownat", 260, 54, "AUE_FCHOWNAT" },
+    { "unlinkat", 263, 35, "AUE_UNLINKAT" },
+    { "renameat", 264, 38, "AUE_RENAMEAT" },
+    { "linkat", 265, 37, "AUE_LINKAT" },
+    { "symlinkat", 266, 36, "AUE_SYMLINKAT" },
+    { "fchmodat", 268, 53, "AUE_FCHMODAT" },
+    { "renameat2", 316, 276, "AUE_RENAMEAT" },
+    { "execveat", 322, 281, "AUE_EXECVE" },
+    { "clone3", 435, 435, "AUE_FORK" },
+};
+
+#define LINUX_SYSCALL_COUNT (sizeof(linuxSyscalls) / sizeof(linuxSyscalls[0]))
+#define MAX_SYSCALL_NUMBER 512
+
+//open flags as Linux defines them, whatever host reads its logs
+#define LINUX_O_ACCMODE 03
+#define LINUX_O_CREAT 0100
+#define LINUX_O_TRUNC 01000
+#define LINUX_CLONE_THREAD 0x00010000
+
+struct EventOverride
+{
+    int id;
+    char name[128];
+};
+
+//id to EventOverride from -E
+static struct IntTable *overrides = NULL;
+//id to catalog entry, built on the first lookup
+static struct IntTable *catalogIndex = NULL;
+static int catalogIndexFailed = 0;
+static int linuxEvents[LINUX_SYSCALL_COUNT];
+static int x86_64Events[MAX_SYSCALL_NUMBER];
+static int aarch64Events[MAX_SYSCALL_NUMBER];
+static int linuxEventsResolved = 0;
+//open and openat, then O_RDONLY, O_WRONLY and O_RDWR, then O_CREAT and O_TRUNC
+static int openEvents[2];
+static int openVariants[2][3][4];
+
+static const struct EventType* searchEventType(int id)
+{
+    size_t low = 0;
+    size_t high = BSM_EVENT_COUNT;
+
+    while (low < high)
+    {
+        size_t middle = low + (high - low) / 2;
+
+        if (bsmEvents[middle].id == id)
+        {
+            return &bsmEvents[middle];
+        }
+
+        if (bsmEvents[middle].id < id)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+
+    return NULL;
+}
+
+//names are looked up for every printed event, a hash probe beats the binary search
+const struct EventType* findEventType(int id)
+{
+    if (NULL == catalogIndex && !catalogIndexFailed)
+    {
+        catalogIndex = intTableCreate(BSM_EVENT_COUNT);
+        for (size_t i = 0; NULL != catalogIndex && i < BSM_EVENT_COUNT; ++i)
+        {
+            if (intTableInsert(catalogIndex, bsmEvents[i].id, (void*)&bsmEvents[i]) < 0)
+            {
+                intTableDestroy(catalogIndex);
+                catalogIndex = NULL;
+            }
+        }
+        catalogIndexFailed = NULL == catalogIndex;
+    }
+
+    if (NULL == catalogIndex)
+    {
+        return searchEventType(id);
+    }
+
+    return (const struct EventType*)intTableFind(catalogIndex, id);
+}
+
+const char* getEventName(int id)
+{
+    if (NULL != overrides)
+    {
+        struct EventOverride *e = (struct EventOverride*)intTableFind(overrides, id);
+        if (NULL != e)
+        {
+            return e->name;
+        }
+    }
+
+    const struct EventType* type = findEventType(id);
+
+    return NULL != type ? type->name : NULL;
+}
+
+struct NameSearch
+{
+    const char* name;
+    int id;
+};
+
+static int compareOverrideName(int id, void* value, void* context)
+{
+    struct NameSearch* search = (struct NameSearch*)context;
+
+    if (strcmp(((struct EventOverride*)value)->name, search->name) == 0)
+    {
+        search->id = id;
+        return 0;
+    }
+
+    return 1;
+}
+
+int getEventId(const char* name)
+{
+    struct NameSearch search = { name, 0 };
+
+    if (NULL != overrides)
+    {
+        intTableForEach(overrides, compareOverrideName, &search);
+        if (search.id != 0)
+        {
+            return search.id;
+        }
+    }
+
+    for (size_t i = 0; i < BSM_EVENT_COUNT; ++i)
+    {
+        if (strcmp(bsmEvents[i].name, name) == 0)
+        {
+            return bsmEvents[i].id;
+        }
+    }
+
+    return 0;
+}
+
+int loadEventNames(const char* path)
+{
+    FILE* auditEventsFile = fopen(path, "r");
+
+    if (NULL == auditEventsFile)
+    {
+        return -1;
+    }
+
+    if (NULL == overrides)
+    {
+        overrides = intTableCreate(0);
+        if (NULL == overrides)
+        {
+            fclose(auditEventsFile);
+            return -1;
+        }
+    }
+
+    char part[512];
+    char lineBuffer[512];
+    memset(part, 0, sizeof(part));
+    memset(lineBuffer, 0, sizeof(lineBuffer));
+    while (fgets(lineBuffer, sizeof(lineBuffer), auditEventsFile))
+    {
+        char* begin = lineBuffer;
+        char* end = strchr(begin, ':');
+        int id = 0;
+
+        if (end && end > begin && sscanf(begin, "%d", &id) > 0)
+        {
+            begin = end + 1;
+            end = strchr(begin, ':');
+
+            if (end && end > begin && (size_t)(end - begin) < sizeof(((struct EventOverride*)0)->name))
+            {
+                int length = end - begin;
+                strncpy(part, begin, length);
+                part[length] = 0;
+
+                struct EventOverride *e = (struct EventOverride*)intTableFind(overrides, id);
+                if (NULL == e)
+                {
+                    e = (struct EventOverride*)malloc(sizeof(struct EventOverride));
+                    if (NULL == e)
+                    {
+                        break;
+                    }
+                    memset(e, 0, sizeof(struct EventOverride));
+                    e->id = id;
+                    if (intTableInsert(overrides, id, e) < 0)
+                    {
+                        free(e);
+                        break;
+                    }
+                }
+                strcpy(e->name, part);
+            }
+        }
+
+        memset(part, 0, sizeof(part));
+        memset(lineBuffer, 0, sizeof(lineBuffer));
+    }
+
+    fclose(auditEventsFile);
+    linuxEventsResolved = 0;
+    return 0;
+}
+
+static int listOverride(int id, void* value, void* context)
+{
+    if (NULL == findEventType(id))
+    {
+        fprintf((FILE*)context, "%d: %s\n", id, ((struct EventOverride*)value)->name);
+    }
+
+    return 1;
+}
+
+void listEventNames(FILE* out)
+{
+    for (size_t i = 0; i < BSM_EVENT_COUNT; ++i)
+    {
+        fprintf(out, "%d: %s\n", bsmEvents[i].id, getEventName(bsmEvents[i].id));
+    }
+
+    if (NULL != overrides)
+    {
+        intTableForEach(overrides, listOverride, out);
+    }
+}
+
+//the table names events so it needs no per platform ids, they are looked up
+//once into arrays indexed by syscall number
+static void resolveLinuxEvents(void)
+{
+    memset(x86_64Events, 0, sizeof(x86_64Events));
+    memset(aarch64Events, 0, sizeof(aarch64Events));
+
+    for (size_t i = 0; i < LINUX_SYSCALL_COUNT; ++i)
+    {
+        linuxEvents[i] = getEventId(linuxSyscalls[i].event);
+
+        if (linuxSyscalls[i].x86_64 >= 0)
+        {
+            x86_64Events[linuxSyscalls[i].x86_64] = linuxEvents[i];
+        }
+
+        if (linuxSyscalls[i].aarch64 >= 0)
+        {
+            aarch64Events[linuxSyscalls[i].aarch64] = linuxEvents[i];
+        }
+    }
+
+    //BSM names the variants AUE_OPEN_RWTC and the like
+    static const char* const bases[] = { "AUE_OPEN", "AUE_OPENAT" };
+    static const char* const modes[] = { "R", "W", "RW" };
+    char name[32];
+    for (int b = 0; b < 2; ++b)
+    {
+        openEvents[b] = getEventId(bases[b]);
+        for (int m = 0; m < 3; ++m)
+        {
+            for (int k = 0; k < 4; ++k)
+            {
+                snprintf(name, sizeof(name), "%s_%s%s%s", bases[b], modes[m], k & 2 ? "T" : "", k & 1 ? "C" : "");
+                openVariants[b][m][k] = getEventId(name);
+            }
+        }
+    }
+
+    linuxEventsResolved = 1;
+}
+
+int linuxSyscallEvent(unsigned int arch, int number)
+{
+    if (!linuxEventsResolved)
+    {
+        resolveLinuxEvents();
+    }
+
+    if (number < 0 || number >= MAX_SYSCALL_NUMBER)
+    {
+        return 0;
+    }
+
+    switch (arch)
+    {
+        case LINUX_ARCH_X86_64:
+        return x86_64Events[number];
+        case LINUX_ARCH_AARCH64:
+        return aarch64Events[number];
+    }
+
+    return 0;
+}
+
+int linuxSyscallNameEvent(const char* name)
+{
+    if (!linuxEventsResolved)
+    {
+        resolveLinuxEvents();
+    }
+
+    for (size_t i = 0; i < LINUX_SYSCALL_COUNT; ++i)
+    {
+        if (strcmp(linuxSyscalls[i].name, name) == 0)
+        {
+            return linuxEvents[i];
+        }
+    }
+
+    return 0;
+}
+
+int linuxOpenEvent(int event, const unsigned long long* args)
+{
+    if (!linuxEventsResolved)
+    {
+        resolveLinuxEvents();
+    }
+
+    for (int b = 0; b < 2; ++b)
+    {
+        if (event == 0 || event != openEvents[b])
+        {
+            continue;
+        }
+
+        //open(path, flags), openat(dirfd, path, flags)
+        unsigned long long flags = args[b + 1];
+        int mode = (int)(flags & LINUX_O_ACCMODE);
+        if (mode > 2)
+        {
+            return event;
+        }
+
+        int variant = openVariants[b][mode][((flags & LINUX_O_TRUNC) ? 2 : 0) | ((flags & LINUX_O_CREAT) ? 1 : 0)];
+        return variant != 0 ? variant : event;
+    }
+
+    return event;
+}
+
+int linuxIsThreadClone(unsigned int arch, int number, const char* name, const unsigned long long* args)
+{
+    //clone(flags, ...) on both architectures
+    if (!(args[0] & LINUX_CLONE_THREAD))
+    {
+        return 0;
+    }
+
+    for (size_t i = 0; i < LINUX_SYSCALL_COUNT; ++i)
+    {
+        const struct LinuxSyscall* syscall = &linuxSyscalls[i];
+        if (strcmp(syscall->name, "clone") != 0)
+        {
+            continue;
+        }
+
+        switch (arch)
+        {
+            case LINUX_ARCH_X86_64:
+            return number == syscall->x86_64;
+            case LINUX_ARCH_AARCH64:
+            return number == syscall->aarch64;
+        }
+        return strcmp(name, syscall->name) == 0;
+    }
+
+    return 0;
+}
@@ -0,0 +1,44 @@
+#ifndef EVENTS_H
+#define EVENTS_H
+
+#include <stdio.h>
+
+/*
+ * Event catalog generated at build time (see gencatalog.sh), so nothing is
+ * parsed at startup. An audit_event file can still be loaded on top of it
+ * to override or add names. Linux syscalls map onto the same BSM event
+ * ids, so every source prints and filters by one set of events.
+ */
+
+struct EventType
+{
+    int id;
+    const char* name;
+    const char* description;
+    const char* classes;
+};
+
+#define LINUX_ARCH_X86_64 0xc000003e
+#define LINUX_ARCH_AARCH64 0xc00000b7
+
+const struct EventType* findEventType(int id);
+const char* getEventName(int id);
+
+//returns 0 if there is no event of that name
+int getEventId(const char* name);
+
+//returns -1 if the file could not be opened
+int loadEventNames(const char* path);
+void listEventNames(FILE* out);
+
+//maps an audit arch and syscall number or a syscall name to an event id, 0 if unknown
+int linuxSyscallEvent(unsigned int arch, int number);
+int linuxSyscallNameEvent(const char* name);
+//open and openat become the BSM variant of their access mode, O_CREAT and
+//O_TRUNC, args are the syscall's first four arguments
+int linuxOpenEvent(int event, const unsigned long long* args);
+//clone with CLONE_THREAD starts a thread of the calling process, not a child,
+//clone3 passes its flags in memory the log does not show
+int linuxIsThreadClone(unsigned int arch, int number, const char* name, const unsigned long long* args);
+
+#endif //EVENTS_H
@@ -0,0 +1,389 @@
+#define _GNU_SOURCE
+
+#include "fanotify.h"
+
+#include <errno.h>
+#include <stdlib.h>
+
+#ifdef __linux__
+
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/fanotify.h>
+
+#include "bsmids.h"
+#include "uthash.h"
+
+#define DEFAULT_CACHE_SIZE 4096
+#define READ_BUFFER_SIZE (64 * 1024)
+#define MAX_KEY_SIZE (sizeof(__kernel_fsid_t) + sizeof(int) + MAX_HANDLE_SZ)
+
+#define WATCH_MASK (FAN_CREATE | FAN_DELETE | FAN_MOVED_FROM | FAN_MOVED_TO | FAN_CLOSE_WRITE | FAN_ONDIR)
+
+struct DirectoryPath
+{
+    unsigned char key[MAX_KEY_SIZE]; //fsid, handle type, handle bytes
+    size_t keyLength;
+    char path[PATH_MAX];
+    size_t pathLength;
+    UT_hash_handle hh;
+};
+
+struct FanotifySource
+{
+    int fd;
+    int mountFd;
+    int cacheSize;
+    struct DirectoryPath* cache; //uthash keeps insertion order, the head is the least recently used
+    unsigned long long hits;
+    unsigned long long misses;
+    unsigned long long overflows;
+    size_t used;
+    size_t position;
+    unsigned char buffer[READ_BUFFER_SIZE];
+};
+
+struct FanotifySource* fanotifyOpen(const char* mountPath, int cacheSize)
+{
+    int fd = fanotify_init(FAN_CLASS_NOTIF | FAN_REPORT_DFID_NAME | FAN_CLOEXEC | FAN_NONBLOCK, O_RDONLY | O_LARGEFILE);
+    if (fd < 0)
+    {
+        return NULL;
+    }
+
+    if (fanotify_mark(fd, FAN_MARK_ADD | FAN_MARK_FILESYSTEM, WATCH_MASK, AT_FDCWD, mountPath) < 0)
+    {
+        int error = errno;
+        close(fd);
+        errno = error;
+        return NULL;
+    }
+
+    //open_by_handle_at() only needs some fd on the same filesystem
+    int mountFd = open(mountPath, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (mountFd < 0)
+    {
+        int error = errno;
+        close(fd);
+        errno = error;
+        return NULL;
+    }
+
+    struct FanotifySource* source = (struct FanotifySource*)malloc(sizeof(struct FanotifySource));
+    memset(source, 0, sizeof(struct FanotifySource));
+    source->fd = fd;
+    source->mountFd = mountFd;
+    source->cacheSize = cacheSize > 0 ? cacheSize : DEFAULT_CACHE_SIZE;
+
+    return source;
+}
+
+void fanotifyClose(struct FanotifySource* source)
+{
+    struct DirectoryPath *d = NULL;
+    struct DirectoryPath *tmp = NULL;
+
+    if (NULL == source)
+    {
+        return;
+    }
+
+    HASH_ITER(hh, source->cache, d, tmp)
+    {
+        HASH_DEL(source->cache, d);
+        free(d);
+    }
+
+    close(source->mountFd);
+    close(source->fd);
+    free(source);
+}
+
+int fanotifyFd(const struct FanotifySource* source)
+{
+    return source->fd;
+}
+
+void fanotifyCacheStats(const struct FanotifySource* source, unsigned long long* hits, unsigned long long* misses)
+{
+    *hits = source->hits;
+    *misses = source->misses;
+}
+
+unsigned long long fanotifyOverflows(const struct FanotifySource* source)
+{
+    return source->overflows;
+}
+
+static size_t makeKey(const struct fanotify_event_info_fid* fid, const struct file_handle* handle, unsigned char* key)
+{
+    size_t length = 0;
+
+    memcpy(key, &fid->fsid, sizeof(fid->fsid));
+    length += sizeof(fid->fsid);
+    memcpy(key + length, &handle->handle_type, sizeof(handle->handle_type));
+    length += sizeof(handle->handle_type);
+    memcpy(key + length, handle->f_handle, handle->handle_bytes);
+    length += handle->handle_bytes;
+
+    return length;
+}
+
+static int resolveHandle(struct FanotifySource* source, struct file_handle* handle, char* path, size_t pathSize)
+{
+    char link[64];
+
+    int fd = open_by_handle_at(source->mountFd, handle, O_PATH | O_CLOEXEC);
+    if (fd < 0)
+    {
+        return -1;
+    }
+
+    snprintf(link, sizeof(link), "/proc/self/fd/%d", fd);
+    ssize_t length = readlink(link, path, pathSize - 1);
+    close(fd);
+
+    if (length < 0)
+    {
+        return -1;
+    }
+    path[length] = 0;
+
+    return (int)length;
+}
+
+static const struct DirectoryPath* lookupDirectory(struct FanotifySource* source, const struct fanotify_event_info_fid* fid)
+{
+    struct file_handle* handle = (struct file_handle*)fid->handle;
+    struct DirectoryPath *d = NULL;
+    unsigned char key[MAX_KEY_SIZE];
+
+    if (handle->handle_bytes > MAX_HANDLE_SZ)
+    {
+        return NULL;
+    }
+
+    size_t keyLength = makeKey(fid, handle, key);
+    HASH_FIND(hh, source->cache, key, keyLength, d);
+
+    if (NULL != d)
+    {
+        //move to the most recently used end
+        source->hits++;
+        HASH_DELETE(hh, source->cache, d);
+        HASH_ADD(hh, source->cache, key[0], d->keyLength, d);
+        return d;
+    }
+
+    source->misses++;
+
+    if (HASH_COUNT(source->cache) >= (unsigned int)source->cacheSize)
+    {
+        d = source->cache;
+        HASH_DELETE(hh, source->cache, d);
+    }
+    else
+    {
+        d = (struct DirectoryPath*)malloc(sizeof(struct DirectoryPath));
+    }
+
+    memset(d, 0, sizeof(struct DirectoryPath));
+    int length = resolveHandle(source, handle, d->path, sizeof(d->path));
+    if (length < 0)
+    {
+        free(d);
+        return NULL;
+    }
+
+    memcpy(d->key, key, keyLength);
+    d->keyLength = keyLength;
+    d->pathLength = length;
+    HASH_ADD(hh, source->cache, key[0], d->keyLength, d);
+
+    return d;
+}
+
+//drops the cached directory and everything below it
+static void invalidateDirectory(struct FanotifySource* source, const char* path, size_t length)
+{
+    struct DirectoryPath *d = NULL;
+    struct DirectoryPath *tmp = NULL;
+
+    HASH_ITER(hh, source->cache, d, tmp)
+    {
+        if (d->pathLength >= length && strncmp(d->path, path, length) == 0
+            && (d->path[length] == 0 || d->path[length] == '/'))
+        {
+            HASH_DELETE(hh, source->cache, d);
+            free(d);
+        }
+    }
+}
+
+static int eventType(unsigned long long mask)
+{
+    int directory = (mask & FAN_ONDIR) != 0;
+
+    if (mask & FAN_CREATE)
+    {
+        return directory ? AUE_MKDIR : AUE_CREAT;
+    }
+    if (mask & FAN_DELETE)
+    {
+        return directory ? AUE_RMDIR : AUE_UNLINK;
+    }
+    if (mask & (FAN_MOVED_FROM | FAN_MOVED_TO))
+    {
+        return AUE_RENAME;
+    }
+
+    return AUE_CLOSE;
+}
+
+static void handleEvent(struct FanotifySource* source, const struct fanotify_event_metadata* metadata, EntryHandler handler, void* context)
+{
+    const unsigned char* info = (const unsigned char*)metadata + metadata->metadata_len;
+    const unsigned char* end = (const unsigned char*)metadata + metadata->event_len;
+    struct AuditEntry entry;
+    struct timespec now;
+
+    //fanotify events carry no time, stamp them when they are read
+    clock_gettime(CLOCK_REALTIME, &now);
+
+    while (info + sizeof(struct fanotify_event_info_header) <= end)
+    {
+        const struct fanotify_event_info_header* header = (const struct fanotify_event_info_header*)info;
+        if (header->len == 0)
+        {
+            break;
+        }
+
+        if (header->info_type == FAN_EVENT_INFO_TYPE_DFID_NAME)
+        {
+            const struct fanotify_event_info_fid* fid = (const struct fanotify_event_info_fid*)info;
+            const struct file_handle* handle = (const struct file_handle*)fid->handle;
+            const char* name = (const char*)(handle->f_handle + handle->handle_bytes);
+            const struct DirectoryPath* directory = lookupDirectory(source, fid);
+
+            memset(&entry, 0, sizeof(struct AuditEntry));
+            entry.pid = metadata->pid;
+            entry.userId = -1;
+            entry.type = eventType(metadata->mask);
+            entry.timestamp = (unsigned long long)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+            if (NULL != directory)
+            {
+                //the mount root already ends in a separator
+                const char* separator = directory->pathLength > 0 && directory->path[directory->pathLength - 1] == '/' ? "" : "/";
+                if (snprintf(entry.path, sizeof(entry.path), "%s%s%s", directory->path, separator, name) >= (int)sizeof(entry.path))
+                {
+                    entry.path[sizeof(entry.path) - 1] = 0;
+                }
+            }
+            else
+            {
+                //the directory is already gone
+                snprintf(entry.path, sizeof(entry.path), "?/%s", name);
+            }
+            entry.pathLength = strlen(entry.path);
+
+            if ((metadata->mask & FAN_ONDIR) && (metadata->mask & (FAN_MOVED_FROM | FAN_DELETE)) && NULL != directory)
+            {
+                invalidateDirectory(source, entry.path, entry.pathLength);
+            }
+
+            handler(&entry, context);
+        }
+
+        info += header->len;
+    }
+}
+
+int fanotifyDrain(struct FanotifySource* source, int maxEvents, EntryHandler handler, void* context)
+{
+    int handled = 0;
+
+    while (handled < maxEvents)
+    {
+        if (source->position >= source->used)
+        {
+            ssize_t n = read(source->fd, source->buffer, sizeof(source->buffer));
+            if (n < 0 && (errno == EAGAIN || errno == EINTR))
+            {
+                break;
+            }
+            if (n <= 0)
+            {
+                return handled > 0 ? handled : -1;
+            }
+            source->used = n;
+            source->position = 0;
+        }
+
+        const struct fanotify_event_metadata* metadata = (const struct fanotify_event_metadata*)(source->buffer + source->position);
+        size_t available = source->used - source->position;
+        if (!FAN_EVENT_OK(metadata, available))
+        {
+            source->position = source->used;
+            continue;
+        }
+
+        source->position += metadata->event_len;
+        if (metadata->mask & FAN_Q_OVERFLOW)
+        {
+            source->overflows++;
+        }
+        else if (metadata->vers == FANOTIFY_METADATA_VERSION)
+        {
+            handleEvent(source, metadata, handler, context);
+        }
+        handled++;
+    }
+
+    return handled;
+}
+
+#else //__linux__
+
+struct FanotifySource* fanotifyOpen(const char* mountPath, int cacheSize)
+{
+    (void)mountPath; (void)cacheSize;
+    errno = ENOSYS;
+    return NULL;
+}
+
+void fanotifyClose(struct FanotifySource* source)
+{
+    (void)source;
+}
+
+int fanotifyFd(const struct FanotifySource* source)
+{
+    (void)source;
+    return -1;
+}
+
+int fanotifyDrain(struct FanotifySource* source, int maxEvents, EntryHandler handler, void* context)
+{
+    (void)source; (void)maxEvents; (void)handler; (void)context;
+    errno = ENOSYS;
+    return -1;
+}
+
+void fanotifyCacheStats(const struct FanotifySource* source, unsigned long long* hits, unsigned long long* misses)
+{
+    (void)source;
+    *hits = 0;
+    *misses = 0;
+}
+
+unsigned long long fanotifyOverflows(const struct FanotifySource* source)
+{
+    (void)source;
+    return 0;
+}
+
+#endif //__linux__
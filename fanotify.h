@@ -0,0 +1,30 @@
+#ifndef FANOTIFY_H
+#define FANOTIFY_H
+
+#include "entry.h"
+
+/*
+ * Filesystem wide create/delete/move/close_write watching through fanotify
+ * in FAN_REPORT_DFID_NAME mode on Linux. Events carry a directory handle
+ * and a name; handles are resolved to paths once and kept in an LRU cache
+ * that is invalidated when directories are renamed or deleted. Events are
+ * reported as AuditEntry with the closest BSM event id.
+ */
+
+struct FanotifySource;
+
+//returns NULL with errno set, ENOSYS where fanotify is not available
+struct FanotifySource* fanotifyOpen(const char* mountPath, int cacheSize);
+void fanotifyClose(struct FanotifySource* source);
+
+int fanotifyFd(const struct FanotifySource* source);
+
+//handles at most maxEvents events, returns the number handled or -1 on error
+int fanotifyDrain(struct FanotifySource* source, int maxEvents, EntryHandler handler, void* context);
+
+void fanotifyCacheStats(const struct FanotifySource* source, unsigned long long* hits, unsigned long long* misses);
+
+//number of FAN_Q_OVERFLOW events, the kernel dropped events before each
+unsigned long long fanotifyOverflows(const struct FanotifySource* source);
+
+#endif //FANOTIFY_H
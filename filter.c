@@ -0,0 +1,278 @@
+#include "filter.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pathmatch.h"
+#include "strsearch.h"
+
+static struct FilterSet emptySet;
+static struct FilterSet* current = &emptySet;
+static struct FilterSet* retired = NULL;
+static unsigned int generation = 0;
+
+//the DFA is built lazily while matching, so every thread needs its own
+static _Thread_local struct PathMatcher* threadMatcher = NULL;
+static _Thread_local unsigned int threadGeneration = 0;
+
+struct FilterSet* filterSetCreate(int event, int pid, const char* processName)
+{
+    struct FilterSet* set = (struct FilterSet*)malloc(sizeof(struct FilterSet));
+    memset(set, 0, sizeof(struct FilterSet));
+    set->event = event;
+    set->pid = pid;
+    if (NULL != processName)
+    {
+        strncpy(set->processName, processName, sizeof(set->processName) - 1);
+    }
+    set->processNameLength = strlen(set->processName);
+
+    return set;
+}
+
+static void clearPaths(struct FilterSet* set)
+{
+    for (int i = 0; i < set->pathCount; ++i)
+    {
+        free(set->paths[i]);
+    }
+    free(set->paths);
+    free(set->pathLengths);
+    set->paths = NULL;
+    set->pathLengths = NULL;
+    set->pathCount = 0;
+    set->literal = 0;
+}
+
+void filterSetDestroy(struct FilterSet* set)
+{
+    if (NULL == set || &emptySet == set)
+    {
+        return;
+    }
+
+    clearPaths(set);
+    free(set);
+}
+
+int filterSetAddPath(struct FilterSet* set, const char* pattern, char* error, size_t errorSize)
+{
+    struct PathMatcher* matcher = pathMatcherCreate(0);
+    int valid = pathMatcherAdd(matcher, pattern, error, errorSize);
+    pathMatcherDestroy(matcher);
+    if (valid < 0)
+    {
+        return -1;
+    }
+
+    char** paths = (char**)realloc(set->paths, (set->pathCount + 1) * sizeof(char*));
+    if (NULL == paths)
+    {
+        snprintf(error, errorSize, "out of memory");
+        return -1;
+    }
+    set->paths = paths;
+
+    size_t* lengths = (size_t*)realloc(set->pathLengths, (set->pathCount + 1) * sizeof(size_t));
+    if (NULL == lengths)
+    {
+        snprintf(error, errorSize, "out of memory");
+        return -1;
+    }
+    set->pathLengths = lengths;
+
+    set->paths[set->pathCount] = strdup(pattern);
+    set->pathLengths[set->pathCount] = strlen(pattern);
+    set->pathCount++;
+    set->literal = set->pathCount == 1 && pathMatcherIsLiteral(pattern);
+
+    return 0;
+}
+
+//splits "keyword value" in place, the value runs to the end of the line
+static char* splitLine(char* line, char** value)
+{
+    size_t length = strlen(line);
+    while (length > 0 && isspace((unsigned char)line[length - 1]))
+    {
+        line[--length] = 0;
+    }
+
+    while (isspace((unsigned char)*line))
+    {
+        line++;
+    }
+
+    char* end = line;
+    while (*end != 0 && !isspace((unsigned char)*end))
+    {
+        end++;
+    }
+
+    *value = end;
+    if (*end != 0)
+    {
+        *end = 0;
+        *value = end + 1;
+        while (isspace((unsigned char)**value))
+        {
+            (*value)++;
+        }
+    }
+
+    return line;
+}
+
+int filterSetLoadFile(struct FilterSet* set, const char* path, int (*eventId)(const char* name), char* error, size_t errorSize)
+{
+    char line[1024];
+    char reason[128];
+    int lineNumber = 0;
+    int filePaths = 0;
+    int result = 0;
+
+    FILE* file = fopen(path, "r");
+    if (NULL == file)
+    {
+        snprintf(error, errorSize, "could not open %s", path);
+        return -1;
+    }
+
+    while (result == 0 && fgets(line, sizeof(line), file))
+    {
+        char* value = NULL;
+        char* keyword = splitLine(line, &value);
+        lineNumber++;
+
+        if (*keyword == 0 || *keyword == '#')
+        {
+            continue;
+        }
+
+        if (*value == 0)
+        {
+            snprintf(error, errorSize, "%s:%d: missing value for %s", path, lineNumber, keyword);
+            result = -1;
+        }
+        else if (strcmp(keyword, "path") == 0)
+        {
+            //the file's paths replace the command line ones rather than adding to them
+            if (filePaths++ == 0)
+            {
+                clearPaths(set);
+            }
+
+            if (filterSetAddPath(set, value, reason, sizeof(reason)) < 0)
+            {
+                snprintf(error, errorSize, "%s:%d: invalid path filter '%s': %s", path, lineNumber, value, reason);
+                result = -1;
+            }
+        }
+        else if (strcmp(keyword, "event") == 0)
+        {
+            set->event = 0;
+            if (sscanf(value, "%d", &set->event) <= 0 && (NULL == eventId || (set->event = eventId(value)) == 0))
+            {
+                snprintf(error, errorSize, "%s:%d: unknown event '%s'", path, lineNumber, value);
+                result = -1;
+            }
+        }
+        else if (strcmp(keyword, "process") == 0)
+        {
+            set->pid = 0;
+            memset(set->processName, 0, sizeof(set->processName));
+            if (strncmp(value, "tree:", 5) == 0)
+            {
+                //membership is worked out as processes appear, it can not change afterwards
+                snprintf(error, errorSize, "%s:%d: tree: filters are only taken from -p", path, lineNumber);
+                result = -1;
+            }
+            else if (sscanf(value, "%d", &set->pid) <= 0
+                && snprintf(set->processName, sizeof(set->processName), "%s", value) >= (int)sizeof(set->processName))
+            {
+                snprintf(error, errorSize, "%s:%d: process name '%s' is longer than %d characters", path, lineNumber, value, (int)sizeof(set->processName) - 1);
+                memset(set->processName, 0, sizeof(set->processName));
+                result = -1;
+            }
+            set->processNameLength = strlen(set->processName);
+        }
+        else
+        {
+            snprintf(error, errorSize, "%s:%d: unknown filter '%s', use path, event or process", path, lineNumber, keyword);
+            result = -1;
+        }
+    }
+
+    fclose(file);
+
+    return result;
+}
+
+const struct FilterSet* filterCurrent(void)
+{
+    return __atomic_load_n(&current, __ATOMIC_ACQUIRE);
+}
+
+void filterPublish(struct FilterSet* set)
+{
+    set->generation = ++generation;
+
+    struct FilterSet* replaced = current;
+    __atomic_store_n(&current, set, __ATOMIC_RELEASE);
+
+    if (&emptySet != replaced)
+    {
+        replaced->retired = retired;
+        retired = replaced;
+    }
+}
+
+void filterReclaim(void)
+{
+    while (NULL != retired)
+    {
+        struct FilterSet* next = retired->retired;
+        filterSetDestroy(retired);
+        retired = next;
+    }
+}
+
+int filterMatchPath(const struct FilterSet* set, const char* path, size_t length)
+{
+    if (set->pathCount == 0)
+    {
+        return 1;
+    }
+
+    if (set->literal)
+    {
+        return findSubstring(path, length, set->paths[0], set->pathLengths[0]) != NULL;
+    }
+
+    if (threadGeneration != set->generation || NULL == threadMatcher)
+    {
+        char error[128];
+        pathMatcherDestroy(threadMatcher);
+        threadMatcher = pathMatcherCreate(0);
+        for (int i = 0; i < set->pathCount; ++i)
+        {
+            pathMatcherAdd(threadMatcher, set->paths[i], error, sizeof(error));
+        }
+        pathMatcherCompile(threadMatcher);
+        threadGeneration = set->generation;
+    }
+
+    return pathMatcherMatch(threadMatcher, path);
+}
+
+void filterShutdown(void)
+{
+    filterReclaim();
+    filterSetDestroy(current);
+    current = &emptySet;
+    pathMatcherDestroy(threadMatcher);
+    threadMatcher = NULL;
+    threadGeneration = 0;
+}
@@ -0,0 +1,55 @@
+#ifndef FILTER_H
+#define FILTER_H
+
+#include <stddef.h>
+
+/*
+ * The event, pid, process name and path filters as one set that is never
+ * changed once published. A reload builds a new set and publishes it with
+ * a single pointer store, so the shard workers read the filters without a
+ * lock. Every thread builds its own path matcher from the set it last saw,
+ * as the DFA grows while matching. A replaced set is only freed once the
+ * caller knows that no worker can still be using it.
+ */
+
+#define FILTER_NAME_SIZE 64
+
+struct FilterSet
+{
+    unsigned int generation; //set on publish, processes recompute their verdict when it changes
+    int event;
+    int pid;
+    char processName[FILTER_NAME_SIZE];
+    size_t processNameLength;
+    char** paths;
+    size_t* pathLengths;
+    int pathCount;
+    int literal; //a single plain text path, matched as a substring
+    struct FilterSet* retired; //main thread only
+};
+
+struct FilterSet* filterSetCreate(int event, int pid, const char* processName);
+void filterSetDestroy(struct FilterSet* set);
+
+//returns -1 on a syntax error described in error
+int filterSetAddPath(struct FilterSet* set, const char* pattern, char* error, size_t errorSize);
+
+//path, event and process lines of the file replace those of the set, returns -1 with a description in error
+int filterSetLoadFile(struct FilterSet* set, const char* path, int (*eventId)(const char* name), char* error, size_t errorSize);
+
+//the set in use, never NULL, matches everything before the first publish
+const struct FilterSet* filterCurrent(void);
+
+//makes set the current one, the replaced one waits for filterReclaim
+void filterPublish(struct FilterSet* set);
+
+//frees the replaced sets, no other thread may still be matching with them
+void filterReclaim(void);
+
+//uses the calling thread's matcher, rebuilt when the set changed
+int filterMatchPath(const struct FilterSet* set, const char* path, size_t length);
+
+//frees every set and the calling thread's matcher
+void filterShutdown(void);
+
+#endif //FILTER_H
@@ -0,0 +1,180 @@
+#include "follow.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
+#include <sys/stat.h>
+
+struct TrailFollower
+{
+    char path[MAXPATHLEN];
+    char directory[MAXPATHLEN];
+    struct RecordSource* source;
+    dev_t device;
+    ino_t inode;
+    struct EventLoop* loop;
+    EventCallback callback;
+    void* context;
+    int fileWatch;
+    int directoryWatch;
+    unsigned long long rotations;
+};
+
+static struct RecordSource* openTrail(struct TrailFollower* follower)
+{
+    struct stat status;
+    struct RecordSource* source = sourceOpen(follower->path);
+
+    if (NULL == source)
+    {
+        return NULL;
+    }
+
+    if (fstat(source->fd, &status) < 0)
+    {
+        sourceClose(source);
+        return NULL;
+    }
+
+    source->follow = 1;
+    follower->device = status.st_dev;
+    follower->inode = status.st_ino;
+    return source;
+}
+
+struct TrailFollower* followOpen(const char* path)
+{
+    struct TrailFollower* follower = (struct TrailFollower*)malloc(sizeof(struct TrailFollower));
+    memset(follower, 0, sizeof(struct TrailFollower));
+    follower->fileWatch = -1;
+    follower->directoryWatch = -1;
+    strncpy(follower->path, path, sizeof(follower->path) - 1);
+
+    //rotation replaces the directory entry, which only the directory sees
+    strncpy(follower->directory, path, sizeof(follower->directory) - 1);
+    char* slash = strrchr(follower->directory, '/');
+    if (NULL == slash)
+    {
+        strcpy(follower->directory, ".");
+    }
+    else
+    {
+        slash[slash == follower->directory ? 1 : 0] = 0;
+    }
+
+    follower->source = openTrail(follower);
+    if (NULL == follower->source)
+    {
+        free(follower);
+        return NULL;
+    }
+
+    return follower;
+}
+
+void followClose(struct TrailFollower* follower)
+{
+    if (NULL == follower)
+    {
+        return;
+    }
+
+    if (NULL != follower->loop)
+    {
+        eventLoopRemoveWatch(follower->loop, follower->fileWatch);
+        eventLoopRemoveWatch(follower->loop, follower->directoryWatch);
+    }
+    sourceClose(follower->source);
+    free(follower);
+}
+
+int followWatch(struct TrailFollower* follower, struct EventLoop* loop, EventCallback callback, void* context)
+{
+    follower->loop = loop;
+    follower->callback = callback;
+    follower->context = context;
+    follower->fileWatch = eventLoopAddWatch(loop, follower->path, callback, context);
+    follower->directoryWatch = eventLoopAddWatch(loop, follower->directory, callback, context);
+
+    return follower->fileWatch < 0 || follower->directoryWatch < 0 ? -1 : 0;
+}
+
+static int isRotated(const struct TrailFollower* follower)
+{
+    struct stat status;
+
+    return stat(follower->path, &status) == 0
+        && (status.st_dev != follower->device || status.st_ino != follower->inode);
+}
+
+static int switchTrail(struct TrailFollower* follower)
+{
+    struct RecordSource* next = openTrail(follower);
+
+    if (NULL == next)
+    {
+        return -1;
+    }
+
+    sourceClose(follower->source);
+    follower->source = next;
+    follower->rotations++;
+
+    if (NULL != follower->loop)
+    {
+        eventLoopRemoveWatch(follower->loop, follower->fileWatch);
+        follower->fileWatch = eventLoopAddWatch(follower->loop, follower->path, follower->callback, follower->context);
+    }
+
+    return 0;
+}
+
+int followDrain(struct TrailFollower* follower, int maxRecords, RecordHandler handler, void* context)
+{
+    struct stat status;
+    int handled = sourceDrain(follower->source, maxRecords, handler, context);
+    int count = 0;
+
+    if (handled != 0)
+    {
+        return handled;
+    }
+
+    //truncated in place, as logrotate's copytruncate does
+    if (fstat(follower->source->fd, &status) == 0 && (unsigned long long)status.st_size < follower->source->offset)
+    {
+        sourceSeek(follower->source, 0);
+        return sourceDrain(follower->source, maxRecords, handler, context);
+    }
+
+    if (!isRotated(follower))
+    {
+        return 0;
+    }
+
+    //auditd finishes the old trail before it points the path at the new one
+    while ((count = sourceDrain(follower->source, maxRecords, handler, context)) > 0)
+    {
+        handled += count;
+    }
+
+    if (switchTrail(follower) < 0)
+    {
+        //opening failed, the next change of the directory tries again
+        return handled;
+    }
+
+    //the new trail may have been written to before it was watched
+    count = sourceDrain(follower->source, maxRecords, handler, context);
+    return count > 0 ? handled + count : handled;
+}
+
+struct RecordSource* followSource(const struct TrailFollower* follower)
+{
+    return follower->source;
+}
+
+unsigned long long followRotations(const struct TrailFollower* follower)
+{
+    return follower->rotations;
+}
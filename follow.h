@@ -0,0 +1,32 @@
+#ifndef FOLLOW_H
+#define FOLLOW_H
+
+#include "eventloop.h"
+#include "source.h"
+
+/*
+ * Follows a trail file that auditd is still writing, such as
+ * /var/audit/current or /var/log/audit/audit.log. The file and its
+ * directory are watched, so nothing is read until one of them changes.
+ * Records are only handed on once they are complete. When the path names
+ * another file after a rotation, the old file is read to its end before
+ * the new one is started at its beginning, so no record is skipped.
+ */
+
+struct TrailFollower;
+
+struct TrailFollower* followOpen(const char* path);
+void followClose(struct TrailFollower* follower);
+
+//callback runs when the trail may have grown or been rotated
+int followWatch(struct TrailFollower* follower, struct EventLoop* loop, EventCallback callback, void* context);
+
+//hands at most maxRecords records of each file to handler, returns the
+//number handled, 0 once everything written so far is handled, -1 on error
+int followDrain(struct TrailFollower* follower, int maxRecords, RecordHandler handler, void* context);
+
+//the file read at the moment, it changes on rotation
+struct RecordSource* followSource(const struct TrailFollower* follower);
+unsigned long long followRotations(const struct TrailFollower* follower);
+
+#endif //FOLLOW_H
@@ -0,0 +1,47 @@
+#!/bin/sh
+# Writes the BSM event table, sorted by id, as C to stdout. It is generated
+# from audit_event when the build host has it, otherwise from the AUE_
+# defines of audit_kevents.h, which have no descriptions or classes. Hosts
+# without OpenBSM, like Linux, get the ids watchfs defines in bsmids.h.
+#
+# usage: gencatalog.sh [audit_event] [audit_kevents.h]
+
+EVENTS=${1:-/etc/security/audit_event}
+KEVENTS=${2:-}
+
+if [ -z "$KEVENTS" ]; then
+    for f in /usr/include/bsm/audit_kevents.h "$(xcrun --show-sdk-path 2>/dev/null)/usr/include/bsm/audit_kevents.h"; do
+        if [ -r "$f" ]; then
+            KEVENTS=$f
+            break
+        fi
+    done
+fi
+
+if [ -r "$EVENTS" ]; then
+    SOURCE=$EVENTS
+elif [ -n "$KEVENTS" ] && [ -r "$KEVENTS" ]; then
+    SOURCE=$KEVENTS
+else
+    KEVENTS="$(dirname "$0")/bsmids.h"
+    SOURCE=$KEVENTS
+fi
+
+if [ "$SOURCE" = "$EVENTS" ]; then
+    # id:name:description:classes, the line number keeps the first of duplicate ids
+    awk -F: '$1 ~ /^[0-9]+$/ && NF >= 2 { print $1 ":" $2 ":" $3 ":" $4 ":" NR }' "$EVENTS"
+else
+    awk '$1 == "#define" && $2 ~ /^AUE_/ && $3 ~ /^[0-9]+$/ { print $3 ":" $2 ":::" NR }' "$KEVENTS"
+fi | sort -t: -k1,1n -k5,5n | awk -F: -v source="$SOURCE" '
+BEGIN {
+    print "//generated by gencatalog.sh from " source ", do not edit"
+    print "static const struct EventType bsmEvents[] = {"
+}
+!seen[$1]++ {
+    gsub(/\\/, "/", $3)
+    gsub(/"/, "\\\"", $3)
+    printf "    { %d, \"%s\", \"%s\", \"%s\" },\n", $1, $2, $3, $4
+}
+END {
+    print "};"
+}'
@@ -0,0 +1,249 @@
+#include "heatmap.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
+
+#include "uthash.h"
+
+#define DEFAULT_NODE_LIMIT 100000
+#define DEFAULT_DEPTH_LIMIT 12
+#define DEFAULT_MIN_SHARE 5
+
+struct HeatNode
+{
+    struct HeatNode* parent;
+    struct HeatNode* children;
+    struct HeatCounts counts;
+    UT_hash_handle hh;
+    char name[]; //path component
+};
+
+static struct HeatNode* root = NULL;
+static unsigned int nodeCount = 0;
+static unsigned int maxNodes = 0;
+static int maxDepth = DEFAULT_DEPTH_LIMIT;
+static int minShare = DEFAULT_MIN_SHARE;
+static unsigned long long truncated = 0;
+
+static struct HeatNode* createNode(struct HeatNode* parent, const char* name, size_t length)
+{
+    struct HeatNode* node = (struct HeatNode*)malloc(sizeof(struct HeatNode) + length + 1);
+
+    if (NULL == node)
+    {
+        return NULL;
+    }
+
+    memset(node, 0, sizeof(struct HeatNode));
+    memcpy(node->name, name, length);
+    node->name[length] = 0;
+    node->parent = parent;
+    nodeCount++;
+
+    if (NULL != parent)
+    {
+        HASH_ADD_KEYPTR(hh, parent->children, node->name, length, node);
+    }
+
+    return node;
+}
+
+static void freeNode(struct HeatNode* node)
+{
+    struct HeatNode *child = NULL;
+    struct HeatNode *tmp = NULL;
+
+    HASH_ITER(hh, node->children, child, tmp)
+    {
+        HASH_DEL(node->children, child);
+        freeNode(child);
+    }
+
+    nodeCount--;
+    free(node);
+}
+
+void heatmapConfigure(unsigned int nodeLimit, int depthLimit, int minSharePercent)
+{
+    maxNodes = nodeLimit > 0 ? nodeLimit : DEFAULT_NODE_LIMIT;
+    maxDepth = depthLimit > 0 ? depthLimit : DEFAULT_DEPTH_LIMIT;
+    minShare = minSharePercent > 0 ? minSharePercent : DEFAULT_MIN_SHARE;
+
+    if (NULL == root)
+    {
+        root = createNode(NULL, "", 0);
+    }
+}
+
+int isHeatmapEnabled(void)
+{
+    return NULL != root;
+}
+
+static void countType(struct HeatCounts* counts, int type)
+{
+    counts->total++;
+
+    for (int i = 0; i < HEAT_TYPES; ++i)
+    {
+        if (counts->counts[i] == 0)
+        {
+            counts->types[i] = type;
+        }
+
+        if (counts->types[i] == type)
+        {
+            counts->counts[i]++;
+            return;
+        }
+    }
+
+    counts->other++;
+}
+
+void heatmapAdd(const char* path, int type)
+{
+    struct HeatNode* node = root;
+    const char* component = path;
+    int depth = 0;
+
+    if (NULL == root)
+    {
+        return;
+    }
+
+    //the last component is the file itself, only directories get nodes
+    const char* last = strrchr(path, '/');
+
+    countType(&root->counts, type);
+
+    while (NULL != last && component < last && depth < maxDepth)
+    {
+        while (*component == '/')
+        {
+            component++;
+        }
+
+        const char* end = strchr(component, '/');
+        if (NULL == end || end > last || end == component)
+        {
+            break;
+        }
+
+        size_t length = end - component;
+        struct HeatNode* child = NULL;
+        HASH_FIND(hh, node->children, component, length, child);
+
+        if (NULL == child)
+        {
+            if (nodeCount >= maxNodes)
+            {
+                truncated++;
+                break;
+            }
+
+            child = createNode(node, component, length);
+            if (NULL == child)
+            {
+                break;
+            }
+        }
+
+        node = child;
+        countType(&node->counts, type);
+        component = end;
+        depth++;
+    }
+}
+
+static int hotterFirst(const struct HeatNode* a, const struct HeatNode* b)
+{
+    if (a->counts.total == b->counts.total)
+    {
+        return 0;
+    }
+
+    return a->counts.total > b->counts.total ? -1 : 1;
+}
+
+static void reportNode(struct HeatNode* node, char* path, size_t pathLength, int depth, unsigned long long all, HeatReport report, void* context)
+{
+    struct HeatNode *child = NULL;
+    struct HeatNode *tmp = NULL;
+
+    report(depth == 0 ? "/" : path, depth, &node->counts, all, context);
+
+    HASH_SRT(hh, node->children, hotterFirst);
+
+    HASH_ITER(hh, node->children, child, tmp)
+    {
+        size_t nameLength = strlen(child->name);
+
+        //sorted, so the rest is colder
+        if (child->counts.total * 100 < all * (unsigned long long)minShare)
+        {
+            break;
+        }
+
+        if (pathLength + 1 + nameLength >= MAXPATHLEN)
+        {
+            continue;
+        }
+
+        path[pathLength] = '/';
+        memcpy(path + pathLength + 1, child->name, nameLength + 1);
+        reportNode(child, path, pathLength + 1 + nameLength, depth + 1, all, report, context);
+        path[pathLength] = 0;
+    }
+}
+
+//frees the subtrees that got no events this interval and resets the rest
+static void pruneNode(struct HeatNode* node)
+{
+    struct HeatNode *child = NULL;
+    struct HeatNode *tmp = NULL;
+
+    HASH_ITER(hh, node->children, child, tmp)
+    {
+        if (child->counts.total == 0)
+        {
+            HASH_DEL(node->children, child);
+            freeNode(child);
+        }
+        else
+        {
+            pruneNode(child);
+        }
+    }
+
+    memset(&node->counts, 0, sizeof(struct HeatCounts));
+}
+
+void heatmapRollup(HeatReport report, void* context)
+{
+    char path[MAXPATHLEN];
+
+    if (NULL == root)
+    {
+        return;
+    }
+
+    if (root->counts.total > 0 && NULL != report)
+    {
+        path[0] = 0;
+        reportNode(root, path, 0, 0, root->counts.total, report, context);
+    }
+
+    pruneNode(root);
+}
+
+unsigned int getHeatmapNodeCount(void)
+{
+    return nodeCount;
+}
+
+unsigned long long getHeatmapTruncated(void)
+{
+    return truncated;
+}
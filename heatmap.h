@@ -0,0 +1,36 @@
+#ifndef HEATMAP_H
+#define HEATMAP_H
+
+/*
+ * Event counts aggregated into a tree of path components. Every event is
+ * counted on its directory and all ancestors, so a node holds the totals of
+ * its whole subtree. Each interval the nodes holding at least a share of
+ * all events are reported, then subtrees that stayed cold are freed and the
+ * counters restart. Memory is bounded by a node limit and a depth limit,
+ * past either the event is counted on the deepest node that exists.
+ */
+
+#define HEAT_TYPES 4
+
+struct HeatCounts
+{
+    unsigned long long total;
+    int types[HEAT_TYPES]; //the first event types seen on the node
+    unsigned long long counts[HEAT_TYPES];
+    unsigned long long other; //events of any further type
+};
+
+typedef void (*HeatReport)(const char* path, int depth, const struct HeatCounts* counts, unsigned long long all, void* context);
+
+void heatmapConfigure(unsigned int nodeLimit, int depthLimit, int minSharePercent);
+int isHeatmapEnabled(void);
+
+void heatmapAdd(const char* path, int type);
+
+//reports the hot subtrees hottest first, then prunes and resets
+void heatmapRollup(HeatReport report, void* context);
+
+unsigned int getHeatmapNodeCount(void);
+unsigned long long getHeatmapTruncated(void);
+
+#endif //HEATMAP_H
@@ -0,0 +1,238 @@
+#include "inttable.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define MIN_CAPACITY 16
+
+struct IntTable
+{
+    unsigned int capacity; //power of two
+    unsigned int shift; //32 - log2(capacity)
+    unsigned int count;
+    int* keys;
+    void** values; //NULL marks a free slot
+};
+
+//Fibonacci hashing, the top bits depend on every bit of the key
+static unsigned int slotOf(const struct IntTable* table, int key)
+{
+    return ((unsigned int)key * 2654435769u) >> table->shift;
+}
+
+static int allocate(struct IntTable* table, unsigned int capacity)
+{
+    table->keys = (int*)malloc(capacity * sizeof(int));
+    table->values = (void**)calloc(capacity, sizeof(void*));
+    if (NULL == table->keys || NULL == table->values)
+    {
+        free(table->keys);
+        free(table->values);
+        return -1;
+    }
+
+    table->capacity = capacity;
+    table->shift = 32;
+    for (unsigned int c = capacity; c > 1; c >>= 1)
+    {
+        table->shift--;
+    }
+    return 0;
+}
+
+struct IntTable* intTableCreate(unsigned int expected)
+{
+    struct IntTable* table = (struct IntTable*)malloc(sizeof(struct IntTable));
+    unsigned int capacity = MIN_CAPACITY;
+
+    if (NULL == table)
+    {
+        return NULL;
+    }
+
+    while (capacity < expected * 2)
+    {
+        capacity *= 2;
+    }
+
+    table->count = 0;
+    if (allocate(table, capacity) < 0)
+    {
+        free(table);
+        return NULL;
+    }
+
+    return table;
+}
+
+void intTableDestroy(struct IntTable* table)
+{
+    if (NULL == table)
+    {
+        return;
+    }
+
+    free(table->keys);
+    free(table->values);
+    free(table);
+}
+
+void* intTableFind(const struct IntTable* table, int key)
+{
+    unsigned int mask = table->capacity - 1;
+
+    for (unsigned int slot = slotOf(table, key); NULL != table->values[slot]; slot = (slot + 1) & mask)
+    {
+        if (table->keys[slot] == key)
+        {
+            return table->values[slot];
+        }
+    }
+
+    return NULL;
+}
+
+static int grow(struct IntTable* table)
+{
+    struct IntTable old = *table;
+
+    if (allocate(table, old.capacity * 2) < 0)
+    {
+        return -1;
+    }
+
+    unsigned int mask = table->capacity - 1;
+    for (unsigned int i = 0; i < old.capacity; ++i)
+    {
+        if (NULL != old.values[i])
+        {
+            unsigned int slot = slotOf(table, old.keys[i]);
+            while (NULL != table->values[slot])
+            {
+                slot = (slot + 1) & mask;
+            }
+            table->keys[slot] = old.keys[i];
+            table->values[slot] = old.values[i];
+        }
+    }
+
+    free(old.keys);
+    free(old.values);
+    return 0;
+}
+
+int intTableInsert(struct IntTable* table, int key, void* value)
+{
+    if ((table->count + 1) * 2 > table->capacity && grow(table) < 0)
+    {
+        return -1;
+    }
+
+    unsigned int mask = table->capacity - 1;
+    unsigned int slot = slotOf(table, key);
+    while (NULL != table->values[slot])
+    {
+        if (table->keys[slot] == key)
+        {
+            table->values[slot] = value;
+            return 0;
+        }
+        slot = (slot + 1) & mask;
+    }
+
+    table->keys[slot] = key;
+    table->values[slot] = value;
+    table->count++;
+    return 0;
+}
+
+//moves the following entries of the probe run back into the hole
+static void removeAt(struct IntTable* table, unsigned int hole)
+{
+    unsigned int mask = table->capacity - 1;
+    unsigned int slot = hole;
+
+    for (;;)
+    {
+        slot = (slot + 1) & mask;
+        if (NULL == table->values[slot])
+        {
+            break;
+        }
+
+        //an entry may only move back if the hole is not before its home slot
+        unsigned int home = slotOf(table, table->keys[slot]);
+        if (((slot - home) & mask) >= ((slot - hole) & mask))
+        {
+            table->keys[hole] = table->keys[slot];
+            table->values[hole] = table->values[slot];
+            hole = slot;
+        }
+    }
+
+    table->values[hole] = NULL;
+    table->count--;
+}
+
+void* intTableRemove(struct IntTable* table, int key)
+{
+    unsigned int mask = table->capacity - 1;
+
+    for (unsigned int slot = slotOf(table, key); NULL != table->values[slot]; slot = (slot + 1) & mask)
+    {
+        if (table->keys[slot] == key)
+        {
+            void* value = table->values[slot];
+            removeAt(table, slot);
+            return value;
+        }
+    }
+
+    return NULL;
+}
+
+unsigned int intTableCount(const struct IntTable* table)
+{
+    return NULL != table ? table->count : 0;
+}
+
+void intTableForEach(const struct IntTable* table, IntTableVisit visit, void* context)
+{
+    for (unsigned int i = 0; i < table->capacity; ++i)
+    {
+        if (NULL != table->values[i] && !visit(table->keys[i], table->values[i], context))
+        {
+            return;
+        }
+    }
+}
+
+void intTableRemoveIf(struct IntTable* table, IntTableVisit keep, void* context)
+{
+    //starting on a free slot no probe run is entered halfway, so removals
+    //only shift entries into the current slot or ones not visited yet
+    unsigned int mask = table->capacity - 1;
+    unsigned int start = 0;
+    while (NULL != table->values[start])
+    {
+        start = (start + 1) & mask;
+        if (start == 0)
+        {
+            break;
+        }
+    }
+
+    unsigned int slot = start;
+    unsigned int remaining = table->capacity;
+    while (remaining > 0)
+    {
+        if (NULL != table->values[slot] && !keep(table->keys[slot], table->values[slot], context))
+        {
+            //the next entry may have moved into this slot, look at it again
+            removeAt(table, slot);
+            continue;
+        }
+        slot = (slot + 1) & mask;
+        remaining--;
+    }
+}
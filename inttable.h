@@ -0,0 +1,36 @@
+#ifndef INTTABLE_H
+#define INTTABLE_H
+
+/*
+ * Open addressing hash table from int keys to pointers for the per event
+ * lookups (pids, event ids). Keys and values are kept in separate arrays
+ * and probed linearly, so a lookup reads one or two cache lines of keys
+ * instead of following a chain of nodes. Removal shifts the following
+ * entries back, there are no tombstones. The table grows at 1/2 load.
+ */
+
+struct IntTable;
+
+//return 0 to stop a visit, or to remove the entry in intTableRemoveIf
+typedef int (*IntTableVisit)(int key, void* value, void* context);
+
+struct IntTable* intTableCreate(unsigned int expected);
+void intTableDestroy(struct IntTable* table);
+
+void* intTableFind(const struct IntTable* table, int key);
+
+//replaces the value of an existing key, returns -1 if out of memory
+int intTableInsert(struct IntTable* table, int key, void* value);
+
+//returns the removed value or NULL
+void* intTableRemove(struct IntTable* table, int key);
+
+unsigned int intTableCount(const struct IntTable* table);
+
+//calls visit for every entry until it returns 0
+void intTableForEach(const struct IntTable* table, IntTableVisit visit, void* context);
+
+//removes the entries keep returns 0 for, keep frees their values
+void intTableRemoveIf(struct IntTable* table, IntTableVisit keep, void* context);
+
+#endif //INTTABLE_H
@@ -0,0 +1,467 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "bsmids.h"
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "source.h"
+
+/*
+ * Load generator for watchfs -f. It replays the records of an audit trail,
+ * or synthetic ones, into a FIFO or stdout at a fixed rate in bursts, or
+ * as fast as possible. Every burst is stamped with the time it is sent, so
+ * watchfs can tell the latency. Like the audit pipe it drops records when
+ * the reader falls behind, unless -w is given.
+ */
+
+#define SYNTHETIC_RECORDS 4096
+#define DEFAULT_COUNT 1000000
+#define MAX_RECORD_SIZE 4096
+#define BATCH_SIZE (16 * 1024)
+
+struct Record
+{
+    u_char* data;
+    int length;
+};
+
+struct Record* records = NULL;
+int recordCount = 0;
+int recordCapacity = 0;
+
+double rate = 0;
+int burst = 1;
+unsigned long long count = DEFAULT_COUNT;
+int duration = 0;
+int blocking = 0;
+const char* outputPath = NULL;
+const char* trailPath = NULL;
+volatile sig_atomic_t stopping = 0;
+unsigned long long sent = 0;
+unsigned long long dropped = 0;
+
+void printUsage(const char* name)
+{
+    printf("Usage:  %s [-r records_per_second] [-b burst] [-n records] [-t seconds] [-w] [-o fifo] [trail_file]\n", name);
+    printf("Arguments:\n");
+    printf("\t-r records_per_second      Target rate, 0 or missing sends as fast as possible.\n");
+    printf("\t-b burst                   Records sent back to back per tick (default 1).\n");
+    printf("\t-n records                 Records to send (default %d).\n", DEFAULT_COUNT);
+    printf("\t-t seconds                 Send for this long instead of a number of records.\n");
+    printf("\t-w                         Wait for the reader instead of dropping records.\n");
+    printf("\t-o fifo                    Write to a FIFO or file instead of stdout.\n");
+    printf("\ttrail_file                 Records to replay, synthetic records if missing.\n");
+}
+
+void addRecord(const u_char* data, int length)
+{
+    if (recordCount == recordCapacity)
+    {
+        recordCapacity = recordCapacity > 0 ? recordCapacity * 2 : 1024;
+        records = (struct Record*)realloc(records, recordCapacity * sizeof(struct Record));
+    }
+
+    records[recordCount].data = (u_char*)malloc(length);
+    memcpy(records[recordCount].data, data, length);
+    records[recordCount].length = length;
+    recordCount++;
+}
+
+void onTrailRecord(u_char* record, int length, void* context)
+{
+    (void)context;
+
+    if (length <= MAX_RECORD_SIZE)
+    {
+        addRecord(record, length);
+    }
+}
+
+//the whole trail is kept in memory so the disk does not limit the rate
+int loadTrail(const char* path)
+{
+    struct RecordSource* source = sourceOpen(path);
+
+    if (NULL == source)
+    {
+        return -1;
+    }
+
+    while (sourceDrain(source, 1024, onTrailRecord, NULL) >= 0)
+    {
+    }
+
+    sourceClose(source);
+    return recordCount > 0 ? 0 : -1;
+}
+
+u_char* put8(u_char* p, u_int8_t value)
+{
+    *p = value;
+    return p + 1;
+}
+
+u_char* put16(u_char* p, u_int16_t value)
+{
+    p[0] = value >> 8;
+    p[1] = value;
+    return p + 2;
+}
+
+u_char* put32(u_char* p, u_int32_t value)
+{
+    p[0] = value >> 24;
+    p[1] = value >> 16;
+    p[2] = value >> 8;
+    p[3] = value;
+    return p + 4;
+}
+
+u_char* put64(u_char* p, u_int64_t value)
+{
+    p = put32(p, value >> 32);
+    return put32(p, (u_int32_t)value);
+}
+
+//header32, subject32, path, return32 and trailer, like a kernel file event
+void makeSyntheticRecords()
+{
+    static const int types[] = { AUE_OPEN_R, AUE_OPEN_RW, AUE_CLOSE, AUE_UNLINK, AUE_RENAME, AUE_MKDIR, AUE_CREAT, AUE_OPEN_R };
+    u_char record[MAX_RECORD_SIZE];
+    char path[256];
+
+    for (int i = 0; i < SYNTHETIC_RECORDS; ++i)
+    {
+        int pid = 1000 + i % 64;
+        int pathLength = snprintf(path, sizeof(path), "/tmp/watchfs-load/d%d/file%d.txt", i % 32, i) + 1;
+        u_char* p = record;
+
+        p = put8(p, AUT_HEADER32);
+        p = put32(p, 0); //size, set below
+        p = put8(p, 11);
+        p = put16(p, types[i % (sizeof(types) / sizeof(types[0]))]);
+        p = put16(p, 0);
+        p = put32(p, 0);
+        p = put32(p, 0);
+
+        p = put8(p, AUT_SUBJECT32);
+        p = put32(p, 501); //auid
+        p = put32(p, 501); //euid
+        p = put32(p, 20); //egid
+        p = put32(p, 501); //ruid
+        p = put32(p, 20); //rgid
+        p = put32(p, pid);
+        p = put32(p, 100000); //sid
+        p = put32(p, 0); //port
+        p = put32(p, 0); //machine
+
+        p = put8(p, AUT_PATH);
+        p = put16(p, pathLength);
+        memcpy(p, path, pathLength);
+        p += pathLength;
+
+        p = put8(p, AUT_RETURN32);
+        p = put8(p, 0);
+        p = put32(p, 0);
+
+        int length = (int)(p - record) + 7;
+        p = put8(p, AUT_TRAILER);
+        p = put16(p, 0xb105);
+        p = put32(p, length);
+
+        put32(record + 1, length);
+        addRecord(record, length);
+    }
+}
+
+//rewrites the header time, so watchfs measures the delay from here
+void stampRecord(u_char* record, int length, const struct timespec* now)
+{
+    int offset = 0;
+    int addressLength = 0;
+
+    switch (record[0])
+    {
+        case AUT_HEADER32:
+        case AUT_HEADER64:
+        offset = 10;
+        break;
+        case AUT_HEADER32_EX:
+        case AUT_HEADER64_EX:
+        addressLength = (record[10] << 24) | (record[11] << 16) | (record[12] << 8) | record[13];
+        offset = 14 + addressLength;
+        break;
+        default:
+        return;
+    }
+
+    if (record[0] == AUT_HEADER64 || record[0] == AUT_HEADER64_EX)
+    {
+        if (offset + 16 <= length)
+        {
+            u_char* p = put64(record + offset, now->tv_sec);
+            put64(p, now->tv_nsec / 1000000);
+        }
+    }
+    else if (offset + 8 <= length)
+    {
+        u_char* p = put32(record + offset, now->tv_sec);
+        put32(p, now->tv_nsec / 1000000);
+    }
+}
+
+void onSignal(int signalNumber)
+{
+    (void)signalNumber;
+
+    stopping = 1;
+}
+
+//a batch the reader has no room for is dropped as a whole, like the kernel
+//does, but one that was partly written is finished so no record is split
+int writeBatch(int fd, const u_char* batch, size_t length, int batched)
+{
+    size_t written = 0;
+
+    while (written < length)
+    {
+        ssize_t n = write(fd, batch + written, length - written);
+
+        if (n > 0)
+        {
+            written += n;
+        }
+        else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        {
+            if (written == 0)
+            {
+                dropped += batched;
+                return 0;
+            }
+            struct timespec pause = { 0, 50000 };
+            nanosleep(&pause, NULL);
+        }
+        else if (n < 0 && errno != EINTR)
+        {
+            fprintf(stderr, "error: write failed: %s\n", strerror(errno));
+            return -1;
+        }
+    }
+
+    sent += batched;
+    return 0;
+}
+
+double secondsBetween(const struct timespec* a, const struct timespec* b)
+{
+    return (b->tv_sec - a->tv_sec) + (b->tv_nsec - a->tv_nsec) / 1e9;
+}
+
+int openOutput(const char* path)
+{
+    struct stat info;
+
+    if (NULL == path)
+    {
+        return STDOUT_FILENO;
+    }
+
+    //a FIFO that does not exist yet is created, opening blocks until watchfs reads
+    if (stat(path, &info) < 0 && errno == ENOENT && mkfifo(path, 0600) < 0)
+    {
+        return -1;
+    }
+
+    return open(path, O_WRONLY);
+}
+
+int main(int argc, char** argv)
+{
+    int ret_option = 0;
+    while ((ret_option = getopt(argc, argv, ":r:b:n:t:wo:")) != -1)
+    {
+        switch (ret_option)
+        {
+            case 'r':
+                if (sscanf(optarg, "%lf", &rate) <= 0 || rate < 0)
+                {
+                    printf("error: invalid rate for -r\n");
+                    printUsage(argv[0]);
+                    exit(1);
+                }
+            break;
+            case 'b':
+                if (sscanf(optarg, "%d", &burst) <= 0 || burst <= 0)
+                {
+                    printf("error: invalid burst for -b\n");
+                    printUsage(argv[0]);
+                    exit(1);
+                }
+            break;
+            case 'n':
+                if (sscanf(optarg, "%llu", &count) <= 0)
+                {
+                    printf("error: invalid record count for -n\n");
+                    printUsage(argv[0]);
+                    exit(1);
+                }
+            break;
+            case 't':
+                if (sscanf(optarg, "%d", &duration) <= 0 || duration <= 0)
+                {
+                    printf("error: invalid duration for -t\n");
+                    printUsage(argv[0]);
+                    exit(1);
+                }
+            break;
+            case 'w':
+                blocking = 1;
+            break;
+            case 'o':
+                outputPath = optarg;
+            break;
+            case ':':
+                printf("error: missing argument for -%c\n", optopt);
+                printUsage(argv[0]);
+                exit(1);
+            break;
+            case '?':
+                printf("error: unknown argument -%c\n", optopt);
+                printUsage(argv[0]);
+                exit(1);
+            break;
+        }
+    }
+
+    if (optind < argc)
+    {
+        trailPath = argv[optind];
+        if (loadTrail(trailPath) < 0)
+        {
+            fprintf(stderr, "Could not read records from %s!\n", trailPath);
+            return 1;
+        }
+    }
+    else
+    {
+        makeSyntheticRecords();
+    }
+
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+    signal(SIGPIPE, SIG_IGN);
+
+    int fd = openOutput(outputPath);
+    if (fd < 0)
+    {
+        fprintf(stderr, "Could not open %s: %s\n", outputPath, strerror(errno));
+        return 1;
+    }
+
+    if (!blocking)
+    {
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    }
+
+    u_char batch[BATCH_SIZE];
+    unsigned long long ticks = 0;
+    unsigned long long lastSent = 0;
+    unsigned long long lastDropped = 0;
+    int next = 0;
+    struct timespec start;
+    struct timespec now;
+    struct timespec lastReport;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    lastReport = start;
+
+    while (!stopping && (duration > 0 || sent + dropped < count))
+    {
+        clock_gettime(CLOCK_MONOTONIC, &now);
+
+        if (duration > 0 && secondsBetween(&start, &now) >= duration)
+        {
+            break;
+        }
+
+        if (rate > 0)
+        {
+            //deadlines follow the schedule, so a late tick is caught up and the average rate holds
+            double due = ticks * burst / rate;
+            double elapsed = secondsBetween(&start, &now);
+            if (due > elapsed)
+            {
+                double wait = due - elapsed;
+                struct timespec pause = { (time_t)wait, (long)((wait - (time_t)wait) * 1e9) };
+                nanosleep(&pause, NULL);
+            }
+        }
+        ticks++;
+
+        struct timespec wallClock;
+        clock_gettime(CLOCK_REALTIME, &wallClock);
+
+        size_t used = 0;
+        int batched = 0;
+        for (int i = 0; i < burst && (duration > 0 || sent + dropped + batched < count); ++i)
+        {
+            struct Record* r = &records[next];
+            next = (next + 1) % recordCount;
+
+            if (used + r->length > sizeof(batch))
+            {
+                if (writeBatch(fd, batch, used, batched) < 0)
+                {
+                    stopping = 1;
+                    break;
+                }
+                used = 0;
+                batched = 0;
+            }
+
+            stampRecord(r->data, r->length, &wallClock);
+            memcpy(batch + used, r->data, r->length);
+            used += r->length;
+            batched++;
+        }
+
+        if (used > 0 && writeBatch(fd, batch, used, batched) < 0)
+        {
+            break;
+        }
+
+        if (secondsBetween(&lastReport, &now) >= 1.0)
+        {
+            double seconds = secondsBetween(&lastReport, &now);
+            fprintf(stderr, "loadgen: sent:%llu dropped:%llu rate:%.0f/s drop_rate:%.0f/s\n",
+                sent, dropped, (sent - lastSent) / seconds, (dropped - lastDropped) / seconds);
+            lastSent = sent;
+            lastDropped = dropped;
+            lastReport = now;
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    double seconds = secondsBetween(&start, &now);
+    fprintf(stderr, "loadgen: sent %llu records, dropped %llu in %.3f s (%.0f records/s)\n",
+        sent, dropped, seconds, seconds > 0 ? sent / seconds : 0.0);
+
+    if (fd != STDOUT_FILENO)
+    {
+        close(fd);
+    }
+
+    for (int i = 0; i < recordCount; ++i)
+    {
+        free(records[i].data);
+    }
+    free(records);
+    return 0;
+}
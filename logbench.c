@@ -0,0 +1,183 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "auditlog.h"
+
+/*
+ * Measures how fast Linux audit logs are parsed, with the vectorized and
+ * the scalar field splitting, and how long ausearch takes for the same file
+ * if it is installed. Without a file a log of the given number of events is
+ * generated, each a SYSCALL, CWD, two PATH, PROCTITLE and EOE record with a
+ * single record login event after every fifth.
+ */
+
+#define DEFAULT_EVENTS 1000000
+
+struct BenchTotals
+{
+    unsigned long long events;
+    unsigned long long checksum;
+};
+
+static double nowSeconds(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static void writeLog(FILE* file, unsigned long long events)
+{
+    static const char* names[] = { "hosts", "passwd", "resolv.conf", "ssh/sshd_config", "nginx/nginx.conf" };
+    static const int syscalls[] = { 257, 257, 257, 87, 82, 59 };
+
+    for (unsigned long long i = 0; i < events; ++i)
+    {
+        unsigned long long serial = 1000 + i;
+        unsigned long long seconds = 1700000000 + i / 1000;
+        unsigned int milliseconds = (unsigned int)(i % 1000);
+        int pid = 3000 + (int)(i % 500);
+
+        fprintf(file, "type=SYSCALL msg=audit(%llu.%03u:%llu): arch=c000003e syscall=%d success=yes exit=3 a0=ffffff9c"
+            " a1=7ffd5c1b2e50 a2=241 a3=1b6 items=2 ppid=2686 pid=%d auid=1000 uid=1000 gid=1000 euid=1000 suid=1000"
+            " fsuid=1000 egid=1000 sgid=1000 fsgid=1000 tty=pts0 ses=1 comm=\"vim\" exe=\"/usr/bin/vim\""
+            " subj=unconfined_u:unconfined_r:unconfined_t:s0-s0:c0.c1023 key=\"watch_etc\"\n",
+            seconds, milliseconds, serial, syscalls[i % 6], pid);
+        fprintf(file, "type=CWD msg=audit(%llu.%03u:%llu): cwd=\"/home/user\"\n", seconds, milliseconds, serial);
+        fprintf(file, "type=PATH msg=audit(%llu.%03u:%llu): item=0 name=\"/etc/\" inode=131073 dev=fd:00 mode=040755"
+            " ouid=0 ogid=0 rdev=00:00 nametype=PARENT cap_fp=0 cap_fi=0 cap_fe=0 cap_fver=0 cap_frootid=0\n",
+            seconds, milliseconds, serial);
+        fprintf(file, "type=PATH msg=audit(%llu.%03u:%llu): item=1 name=\"/etc/%s\" inode=%llu dev=fd:00 mode=0100644"
+            " ouid=0 ogid=0 rdev=00:00 nametype=NORMAL cap_fp=0 cap_fi=0 cap_fe=0 cap_fver=0 cap_frootid=0\n",
+            seconds, milliseconds, serial, names[i % 5], 131099 + i % 5);
+        fprintf(file, "type=PROCTITLE msg=audit(%llu.%03u:%llu): proctitle=76696D002F6574632F686F737473\n",
+            seconds, milliseconds, serial);
+        fprintf(file, "type=EOE msg=audit(%llu.%03u:%llu): \n", seconds, milliseconds, serial);
+
+        if (i % 5 == 4)
+        {
+            fprintf(file, "type=USER_ACCT msg=audit(%llu.%03u:%llu): pid=%d uid=0 auid=1000 ses=1"
+                " msg='op=PAM:accounting grantors=pam_unix acct=\"root\" exe=\"/usr/bin/sudo\" hostname=? addr=?"
+                " terminal=/dev/pts/0 res=success'\n", seconds, milliseconds, serial + events, pid);
+        }
+    }
+}
+
+static char* readWhole(const char* path, size_t* length)
+{
+    FILE* file = fopen(path, "rb");
+    if (NULL == file)
+    {
+        return NULL;
+    }
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    char* data = (char*)malloc(size > 0 ? size : 1);
+    *length = NULL != data ? fread(data, 1, size, file) : 0;
+    fclose(file);
+    return data;
+}
+
+static void countEntry(struct AuditEntry* entry, void* context)
+{
+    struct BenchTotals* totals = (struct BenchTotals*)context;
+
+    totals->events++;
+    totals->checksum += entry->pathLength + entry->type + entry->pid;
+}
+
+static double parseAll(const char* data, size_t length, struct BenchTotals* totals)
+{
+    struct AuditLogParser* parser = auditLogCreate(countEntry, totals);
+    double start = nowSeconds();
+
+    for (size_t position = 0; position < length; )
+    {
+        const char* end = (const char*)memchr(data + position, '\n', length - position);
+        size_t lineLength = NULL != end ? (size_t)(end - data - position) + 1 : length - position;
+
+        auditLogFeed(parser, data + position, lineLength, position);
+        position += lineLength;
+    }
+    auditLogFlush(parser);
+
+    double seconds = nowSeconds() - start;
+    auditLogDestroy(parser);
+    return seconds;
+}
+
+int main(int argc, char** argv)
+{
+    unsigned long long events = DEFAULT_EVENTS;
+    char generated[] = "/tmp/watchfs-logbench-XXXXXX";
+    const char* path = NULL;
+
+    if (argc > 1 && (access(argv[1], R_OK) == 0 || sscanf(argv[1], "%llu", &events) <= 0))
+    {
+        path = argv[1];
+    }
+
+    if (NULL == path)
+    {
+        int fd = mkstemp(generated);
+        FILE* file = fd >= 0 ? fdopen(fd, "w") : NULL;
+        if (NULL == file)
+        {
+            fprintf(stderr, "Could not create %s\n", generated);
+            return 1;
+        }
+        writeLog(file, events);
+        fclose(file);
+        path = generated;
+    }
+
+    size_t length = 0;
+    char* data = readWhole(path, &length);
+    if (NULL == data)
+    {
+        printf("Usage:  %s [events | audit.log]\n", argv[0]);
+        return 1;
+    }
+
+    struct BenchTotals vector = { 0, 0 };
+    const char* variant = auditLogTokenizerVariant();
+    double vectorSeconds = parseAll(data, length, &vector);
+
+    struct BenchTotals scalar = { 0, 0 };
+    auditLogUseScalarTokenizer();
+    double scalarSeconds = parseAll(data, length, &scalar);
+
+    printf("bytes:%zu events:%llu %s_mb_s:%.0f %s_events_s:%.0f scalar_mb_s:%.0f scalar_events_s:%.0f speedup:%.2f%s\n",
+        length, vector.events, variant, length / vectorSeconds / 1e6, variant, vector.events / vectorSeconds,
+        length / scalarSeconds / 1e6, scalar.events / scalarSeconds, vectorSeconds > 0 ? scalarSeconds / vectorSeconds : 0.0,
+        vector.events == scalar.events && vector.checksum == scalar.checksum ? "" : " MISMATCH");
+
+    //ausearch joins the records of every event too, its output is thrown away
+    if (system("command -v ausearch > /dev/null 2>&1") == 0)
+    {
+        char command[256];
+        snprintf(command, sizeof(command), "ausearch --input '%s' -m SYSCALL --raw > /dev/null 2>&1", path);
+        double start = nowSeconds();
+        int status = system(command);
+        double seconds = nowSeconds() - start;
+        printf("ausearch_seconds:%.2f ausearch_mb_s:%.0f watchfs_speedup:%.1f%s\n", seconds, length / seconds / 1e6,
+            seconds / vectorSeconds, status == 0 ? "" : " (ausearch failed)");
+    }
+    else
+    {
+        printf("ausearch not found, install the audit tools to compare\n");
+    }
+
+    free(data);
+    if (path == generated)
+    {
+        unlink(generated);
+    }
+    return 0;
+}
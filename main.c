@@ -1,178 +1,301 @@
+#include <errno.h>
 #include <fcntl.h>
+#include <signal.h>
 #include <unistd.h>
 #include <sys/ioctl.h>
+#include <sys/stat.h>
 
+#include "bsmids.h"
+#ifdef HAVE_BSM
 #include <security/audit/audit_ioctl.h>
-#include <bsm/libbsm.h>
-#include <libproc.h>
+#endif
 
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <time.h>
 
-#include "uthash.h"
+#include "entry.h"
+#include "events.h"
+#include "pathmatch.h"
+#include "strsearch.h"
+#include "process.h"
+#include "eventloop.h"
+#include "source.h"
+#include "control.h"
+#include "output.h"
+#include "uring.h"
+#include "fanotify.h"
+#include "queue.h"
+#include "sample.h"
+#include "session.h"
+#include "heatmap.h"
+#include "rules.h"
+#include "enrich.h"
+#include "merge.h"
+#include "shard.h"
+#include "inttable.h"
+#include "checkpoint.h"
+#include "follow.h"
+#include "auditlog.h"
+#include "filter.h"
+#include "targets.h"
+#include "canonical.h"
 
-struct AuditEntry
-{
-    char path[MAXPATHLEN];
-    int pid;
-    int userId;
-    int type;
-};
+//records handled per wakeup before other sources and timers get a turn
+#define RECORDS_PER_WAKEUP 256
+//records moved from the pipe into the queue per wakeup, larger so that
+//reading keeps ahead of the slower stages
+#define RECORDS_PER_INGEST 1024
+#define DEFAULT_QUEUE_CAPACITY 65536
+#define MAX_RULE_SPECS 16
+#define DEFAULT_MERGE_WINDOW_MS 500
+//log2 buckets of milliseconds
+#define LATENCY_BUCKETS 24
+#define LINE_SIZE (3 * MAXPATHLEN)
+#define FLUSH_INTERVAL_MS 1000
+#define PRUNE_INTERVAL_MS 30000
+#define URING_ENTRIES 32
+#define CHECKPOINT_INTERVAL_MS 10000
 
-struct ProcessInfo
+struct Stats
 {
-    int pid;
-    char processPath[PROC_PIDPATHINFO_MAXSIZE];
-    UT_hash_handle hh; /* makes this structure hashable */
+    unsigned long long records;
+    unsigned long long matched;
+    unsigned long long printed;
+    unsigned long long sampledOut;
+    unsigned long long filterReloads;
+    unsigned long long latencyCount;
+    unsigned long long latencySum;
+    unsigned long long latencyMax;
+    unsigned long long latency[LATENCY_BUCKETS];
 };
 
-struct EventInfo
+struct EventCount
 {
-    int id;
-    char name[128];
-    UT_hash_handle hh; /* makes this structure hashable */
+    int type;
+    unsigned long long count;
 };
 
-struct ProcessInfo *processes = NULL;
-struct EventInfo *eventNames = NULL;
+//event type to EventCount while overloaded
+struct IntTable *summaryCounts = NULL;
+struct RecordSource *pipeSource = NULL;
+//indexed by merge source id, the trails are the only sources when replaying
+struct RecordSource *replaySources[MAX_MERGE_SOURCES];
+struct Uring *ring = NULL;
+struct FanotifySource *fanotifySource = NULL;
+struct TrailFollower *trailFollower = NULL;
+//indexed by merge source id, for sources that turned out to be Linux audit logs
+struct AuditLogParser *logParsers[MAX_MERGE_SOURCES];
+struct RecordQueue *recordQueue = NULL;
+struct Stats stats;
 
-void updateProcess(int pid)
-{
-    struct ProcessInfo *p = NULL;
-    char processPath[PROC_PIDPATHINFO_MAXSIZE];
-    memset(processPath, 0, sizeof(processPath));
-    if (proc_pidpath(pid, processPath, sizeof(processPath)) <= 0)
-    {
-        return;
-    }
+//the command line filters, a filter file's lines replace them on every load
+int eventFilter = 0;
+int pidFilter = 0;
+char processFilter[FILTER_NAME_SIZE];
+char** pathPatterns = NULL;
+int pathPatternCount = 0;
+const char* filterPath = NULL;
+int auditPipeFd = -1;
+int statsInterval = 0;
+const char* controlPath = NULL;
+const char* replayPaths[MAX_MERGE_SOURCES];
+int replayCount = 0;
+int useUring = 0;
+const char* mountPath = NULL;
+int overloadPolicy = OVERLOAD_BLOCK;
+int queueLimit = DEFAULT_QUEUE_CAPACITY;
+int degradeToSummary = 0;
+int overloaded = 0;
+int readerPaused = 0;
+int typeCap = 0;
+int sessionTimeout = 0;
+int heatmapInterval = 0;
+const char* ruleSpecs[MAX_RULE_SPECS];
+int ruleSpecCount = 0;
+unsigned long long latestTimestamp = 0;
+const char* feedPath = NULL;
+const char* followPath = NULL;
+//the followed trail has more records than one batch, the idle hook reads on
+int followPending = 0;
+int measureLatency = 0;
+int enrichKinds = 0;
+int enrichWorkers = 2;
+int mergeWindow = DEFAULT_MERGE_WINDOW_MS;
+//merge source ids, handleRecord gets a pointer to one of them as context
+int replayIds[MAX_MERGE_SOURCES];
+int pipeMergeId = 0;
+int fanotifyMergeId = 0;
+int followMergeId = 0;
+int shardWorkers = 0;
+//written by each worker, read without the lock as it is only for the stats
+unsigned int shardProcessCounts[MAX_SHARDS];
+const char* checkpointPath = NULL;
+struct Checkpoint resumeCheckpoint;
+volatile sig_atomic_t replayStopped = 0;
 
-    HASH_FIND_INT(processes, &pid, p);
-    if (NULL == p)
+void updateLineage(const struct AuditEntry* entry)
+{
+    switch (entry->type)
     {
-        p = (struct ProcessInfo*)malloc(sizeof(struct ProcessInfo));
-        memset(p, 0, sizeof(struct ProcessInfo));
-        p->pid = pid;
-        HASH_ADD_INT(processes, pid, p);
+        case AUE_FORK:
+        case AUE_VFORK:
+#ifdef AUE_POSIX_SPAWN
+        case AUE_POSIX_SPAWN:
+#endif
+        if (entry->childPid > 0)
+        {
+            processForked(entry->pid, entry->childPid);
+        }
+        break;
+        case AUE_EXIT:
+        processExited(entry->pid);
+        break;
     }
-    
-    strcpy(p->processPath, processPath);
 }
 
-const char* getProcessName(int pid)
+int isExecEvent(int type)
 {
-    struct ProcessInfo *p = NULL;
-
-    HASH_FIND_INT(processes, &pid, p);
-
-    if (NULL != p)
+    switch (type)
     {
-        return p->processPath;
+        case AUE_EXECVE:
+#ifdef AUE_EXEC
+        case AUE_EXEC:
+#endif
+#ifdef AUE_MAC_EXECVE
+        case AUE_MAC_EXECVE:
+#endif
+#ifdef AUE_FEXECVE
+        case AUE_FEXECVE:
+#endif
+        return 1;
     }
 
-    return NULL;
+    return 0;
 }
 
-const char* getEventName(int id)
+//the command line filters with the filter file's on top, NULL with a description in error
+struct FilterSet* loadFilters(char* error, size_t errorSize)
 {
-    struct EventInfo *e = NULL;
+    char reason[128];
+    struct FilterSet* filters = filterSetCreate(eventFilter, pidFilter, processFilter);
 
-    HASH_FIND_INT(eventNames, &id, e);
+    for (int i = 0; i < pathPatternCount; ++i)
+    {
+        if (filterSetAddPath(filters, pathPatterns[i], reason, sizeof(reason)) < 0)
+        {
+            snprintf(error, errorSize, "invalid path filter '%s': %s", pathPatterns[i], reason);
+            filterSetDestroy(filters);
+            return NULL;
+        }
+    }
 
-    if (NULL != e)
+    if (NULL != filterPath && filterSetLoadFile(filters, filterPath, getEventId, error, errorSize) < 0)
     {
-        return e->name;
+        filterSetDestroy(filters);
+        return NULL;
     }
 
-    return NULL;
+    if (filters->pathCount == 0 && !isTargetEnabled())
+    {
+        snprintf(error, errorSize, "%s has no path filter", filterPath);
+        filterSetDestroy(filters);
+        return NULL;
+    }
+
+    return filters;
 }
 
-void parseEventNames(int printOnly)
+//event and process filters are only printed if the filter file changed them
+void printFilters(FILE* out, const struct FilterSet* filters)
 {
-    FILE* auditEventsFile = fopen("/etc/security/audit_event", "r");
-
-    if (auditEventsFile)
+    for (int i = 0; i < filters->pathCount; ++i)
     {
-        char part[512];
-        char lineBuffer[512];
-        memset(part, 0, sizeof(part));
-        memset(lineBuffer, 0, sizeof(lineBuffer));
-        while (fgets(lineBuffer, sizeof(lineBuffer), auditEventsFile))
-        {
-            char* begin = lineBuffer;
-            char* end = strchr(begin, ':');
+        fprintf(out, filters->literal ? "Using '%s' for path filtering.\n" : "Using pattern '%s' for path filtering.\n", filters->paths[i]);
+    }
 
-            if (end)
-            {
-                int length = end - begin;
-                if (length > 0)
-                {
-                    strncpy(part, begin, length);
-                    part[length] = 0;
-                    int id = 0;
-                    if (sscanf(part, "%d", &id) > 0)
-                    {
-                        begin = end + 1;
+    if (filters->event != eventFilter)
+    {
+        fprintf(out, "Using %d for event filtering.\n", filters->event);
+    }
 
-                        end = strchr(begin, ':');
-                        length = end - begin;
-                        if (length > 0)
-                        {
-                            strncpy(part, begin, length);
-                            part[length] = 0;
-
-                            if (printOnly)
-                            {
-                                printf("%d: %s\n", id, part);
-                            }
-                            else
-                            {
-                                struct EventInfo *e = NULL;
-                                HASH_FIND_INT(eventNames, &id, e);
-                                if (NULL == e)
-                                {
-                                    e = (struct EventInfo*)malloc(sizeof(struct EventInfo));
-                                    memset(e, 0, sizeof(struct EventInfo));
-                                    e->id = id;
-                                    strcpy(e->name, part);
-                                    HASH_ADD_INT(eventNames, id, e);
-                                }
-                            }
-                        }
-                    }
-                }
-                
-            }
-            
-            memset(part, 0, sizeof(part));
-            memset(lineBuffer, 0, sizeof(lineBuffer));
-        }
-        
-        fclose(auditEventsFile);
+    if (filters->pid != pidFilter && filters->pid > 0)
+    {
+        fprintf(out, "Using pid %d for process filtering.\n", filters->pid);
+    }
+    else if (strcmp(filters->processName, processFilter) != 0 && filters->processNameLength > 0)
+    {
+        fprintf(out, "Using name '%s' for process filtering.\n", filters->processName);
     }
 }
 
 void printUsage(const char* name)
 {
-    printf("Usage:  %s [-p pid | process_name] [-e event_id] path_filter\n", name);
-    printf("        %s -l\n", name);
+    printf("Usage:  %s [-p pid | process_name | tree:pid | tree:name] [-e event_id] [-i seconds] [-c socket_path] [-r trail_file ...] [-W milliseconds] [-U] [-m mount_path] [-o policy] [-q records] [-d] [-s sample] [-t per_second] [-a idle_seconds] [-H seconds] [-R rule] [-f fifo] [-F trail_file] [-K] [-C container] [-x enrichment] [-X threads] [-j workers] [-S checkpoint_file] [-L filter_file] [-I target ...] [-N] path_filter [path_filter ...]\n", name);
+    printf("        %s [-E audit_event_file] -l\n", name);
     printf("Arguments:\n");
     printf("\t-p pid | process_name      Filter by process id if it is a number otherwise process_name.\n");
+    printf("\t-p tree:pid | tree:name    Filter by the process and all of its descendants.\n");
     printf("\t-e event_id                Filter by event_id.\n");
     printf("\t-l                         List event id and names.\n");
+    printf("\t-E audit_event_file        Override the built in event names with an audit_event file.\n");
+    printf("\t-i seconds                 Print statistics to stderr every interval and on exit.\n");
+    printf("\t-c socket_path             Accept stats, flush, reload and quit commands on a unix socket.\n");
+    printf("\t-r trail_file              Read records from an audit trail or Linux audit.log instead of the audit pipe, repeat to merge.\n");
+    printf("\t-W milliseconds            How long events of several sources wait for a later source to be merged in order (default %d).\n", DEFAULT_MERGE_WINDOW_MS);
+    printf("\t-U                         Use io_uring for trail reads and output where available.\n");
+    printf("\t-m mount_path              Watch create, delete, move and close_write on a whole filesystem with fanotify (Linux).\n");
+    printf("\t-o block|newest|oldest|priority\n");
+    printf("\t                           What to drop when the record queue is full (default block, which lets the kernel drop).\n");
+    printf("\t-q records                 Record queue capacity (default %d).\n", DEFAULT_QUEUE_CAPACITY);
+    printf("\t-d                         Print per event summaries instead of every match while the queue is overloaded.\n");
+    printf("\t-s rate | pid:rate | path:rate\n");
+    printf("\t                           Keep that fraction of records, or of processes or paths as a whole.\n");
+    printf("\t-t per_second              Keep at most that many records per second of each event type.\n");
+    printf("\t-a idle_seconds            Fold open, read, write and close of a file by a process into one session line.\n");
+    printf("\t-H seconds                 Print the directories with the most events every interval instead of each event.\n");
+    printf("\t-R key:event:count/seconds Only print alerts when a pid, uid, dir or type key reaches count events in the window.\n");
+    printf("\t-f fifo | -                Read records from a FIFO or stdin, e.g. from watchfs-loadgen, instead of the audit pipe.\n");
+    printf("\t                           Together with -m both are merged.\n");
+    printf("\t-F trail_file              Follow a trail or audit.log that auditd is writing, e.g. /var/audit/current, across rotations.\n");
+    printf("\t-K                         Print the container or service id and cgroup (jail on FreeBSD) of each process.\n");
+    printf("\t-C container               Filter by text in the container id, service or cgroup, implies -K.\n");
+    printf("\t-x user,args,cwd,file      Add user name, process arguments, working directory or file size, mode and owner.\n");
+    printf("\t-X threads                 Threads doing the -x lookups (default 2).\n");
+    printf("\t-j workers                 Split process lookups and filtering by pid over that many threads, one per core.\n");
+    printf("\t-S checkpoint_file         Save trail positions and known processes every 10 s and on exit, continue from there on start.\n");
+    printf("\t-L filter_file             Take path, event and process filters from a file, reloaded on SIGHUP or the reload command.\n");
+    printf("\t-I target                  Match a file by device and inode under any name, also after renames, repeat for more.\n");
+    printf("\t-N                         Canonicalize paths: drop // . and .., resolve symlinked directories through a cache.\n");
+    printf("Path filters:\n");
+    printf("\ttext                       Path contains text.\n");
+    printf("\tglob or glob:glob          Glob with * ? [] and **, matched on the file name if it has no '/'.\n");
+    printf("\tre:regex                   Regex with . [] * + ? | () and ^ $ anchors.\n");
+    printf("Filter file lines:\n");
+    printf("\tpath path_filter           Replaces the command line path filters, repeat for more.\n");
+    printf("\tevent event_id | name      Replaces -e.\n");
+    printf("\tprocess pid | process_name Replaces -p, tree: only works with -p.\n");
 }
 
-void parseArgs(int argc, char** argv, int* eventFilter, int* pidFilter, char* processFilter, char* pathFilter)
+void parseArgs(int argc, char** argv, int* eventFilter, int* pidFilter, char* processFilter)
 {
     int ret_option = 0;
-    while ((ret_option = getopt (argc, argv, ":p:e:l")) != -1)
+    while ((ret_option = getopt (argc, argv, ":p:e:lE:i:c:r:W:Um:o:q:ds:t:a:H:R:f:F:KC:x:X:j:S:L:I:N")) != -1)
     {
         switch (ret_option)
         {
             case 'l':
-                parseEventNames(1);
+                listEventNames(stdout);
                 exit(0);
             break;
+            case 'E':
+                if (loadEventNames(optarg) < 0)
+                {
+                    printf("error: could not read event names from %s\n", optarg);
+                    exit(1);
+                }
+            break;
             case 'p':
                 if (optarg == NULL || (optarg && optarg[0] == '-'))
                 {
@@ -182,14 +305,29 @@ void parseArgs(int argc, char** argv, int* eventFilter, int* pidFilter, char* pr
                 }
                 else
                 {
+                    if (strncmp(optarg, "tree:", 5) == 0)
+                    {
+                        int rootPid = 0;
+                        const char* root = optarg + 5;
+                        if (sscanf(root, "%d", &rootPid) > 0)
+                        {
+                            setProcessTreeRoot(rootPid, NULL);
+                            printf("Using process tree of pid %d for process filtering.\n", rootPid);
+                        }
+                        else
+                        {
+                            setProcessTreeRoot(0, root);
+                            printf("Using process tree of '%s' for process filtering.\n", root);
+                        }
+                    }
                     //try integer parse first for pid
-                    if (sscanf(optarg, "%d", pidFilter) > 0)
+                    else if (sscanf(optarg, "%d", pidFilter) > 0)
                     {
                         printf("Using pid %d for process filtering.\n", *pidFilter);
                     }
                     else
                     {
-                        strcpy(processFilter, optarg);
+                        strncpy(processFilter, optarg, FILTER_NAME_SIZE - 1);
                         printf("Using name '%s' for process filtering.\n", processFilter);
                     }
                 }
@@ -215,6 +353,157 @@ void parseArgs(int argc, char** argv, int* eventFilter, int* pidFilter, char* pr
                     }
                 }
             break;
+            case 'i':
+                if (sscanf(optarg, "%d", &statsInterval) <= 0 || statsInterval <= 0)
+                {
+                    printf("error: invalid interval for -i\n");
+                    printUsage(argv[0]);
+                    exit(1);
+                }
+            break;
+            case 'c':
+                controlPath = optarg;
+            break;
+            case 'r':
+                if (replayCount >= MAX_MERGE_SOURCES)
+                {
+                    printf("error: at most %d trail files\n", MAX_MERGE_SOURCES);
+                    exit(1);
+                }
+                replayPaths[replayCount++] = optarg;
+            break;
+            case 'W':
+                if (sscanf(optarg, "%d", &mergeWindow) <= 0 || mergeWindow < 0)
+                {
+                    printf("error: invalid merge window for -W\n");
+                    printUsage(argv[0]);
+                    exit(1);
+                }
+            break;
+            case 'U':
+                useUring = 1;
+            break;
+            case 'm':
+                mountPath = optarg;
+            break;
+            case 'o':
+                overloadPolicy = queueParsePolicy(optarg);
+                if (overloadPolicy < 0)
+                {
+                    printf("error: unknown overload policy '%s' for -o\n", optarg);
+                    printUsage(argv[0]);
+                    exit(1);
+                }
+            break;
+            case 'q':
+                if (sscanf(optarg, "%d", &queueLimit) <= 0 || queueLimit <= 0)
+                {
+                    printf("error: invalid queue capacity for -q\n");
+                    printUsage(argv[0]);
+                    exit(1);
+                }
+            break;
+            case 'd':
+                degradeToSummary = 1;
+            break;
+            case 's':
+                if (samplerConfigure(optarg) < 0)
+                {
+                    printf("error: invalid sample '%s' for -s, use a rate in (0, 1]\n", optarg);
+                    printUsage(argv[0]);
+                    exit(1);
+                }
+            break;
+            case 't':
+                if (sscanf(optarg, "%d", &typeCap) <= 0 || typeCap <= 0)
+                {
+                    printf("error: invalid rate for -t\n");
+                    printUsage(argv[0]);
+                    exit(1);
+                }
+            break;
+            case 'a':
+                if (sscanf(optarg, "%d", &sessionTimeout) <= 0 || sessionTimeout <= 0)
+                {
+                    printf("error: invalid idle timeout for -a\n");
+                    printUsage(argv[0]);
+                    exit(1);
+                }
+            break;
+            case 'H':
+                if (sscanf(optarg, "%d", &heatmapInterval) <= 0 || heatmapInterval <= 0)
+                {
+                    printf("error: invalid interval for -H\n");
+                    printUsage(argv[0]);
+                    exit(1);
+                }
+            break;
+            case 'f':
+                feedPath = optarg;
+            break;
+            case 'F':
+                followPath = optarg;
+            break;
+            case 'x':
+                enrichKinds = enrichParseKinds(optarg);
+                if (enrichKinds <= 0)
+                {
+                    printf("error: invalid enrichment '%s' for -x, use user, args, cwd and file\n", optarg);
+                    printUsage(argv[0]);
+                    exit(1);
+                }
+            break;
+            case 'X':
+                if (sscanf(optarg, "%d", &enrichWorkers) <= 0 || enrichWorkers <= 0)
+                {
+                    printf("error: invalid thread count for -X\n");
+                    printUsage(argv[0]);
+                    exit(1);
+                }
+            break;
+            case 'j':
+                if (sscanf(optarg, "%d", &shardWorkers) <= 0 || shardWorkers <= 0 || shardWorkers > MAX_SHARDS)
+                {
+                    printf("error: invalid worker count for -j, use 1 to %d\n", MAX_SHARDS);
+                    printUsage(argv[0]);
+                    exit(1);
+                }
+            break;
+            case 'S':
+                checkpointPath = optarg;
+            break;
+            case 'L':
+                filterPath = optarg;
+            break;
+            case 'I':
+                if (targetAdd(optarg) < 0)
+                {
+                    printf("error: could not resolve target %s\n", optarg);
+                    exit(1);
+                }
+                printf("Using device and inode of '%s' for path filtering.\n", optarg);
+            break;
+            case 'N':
+                canonicalConfigure(0);
+            break;
+            case 'K':
+                if (!isCgroupAttributionEnabled())
+                {
+                    setCgroupAttribution(NULL);
+                }
+            break;
+            case 'C':
+                setCgroupAttribution(optarg);
+                printf("Using '%s' for container filtering.\n", optarg);
+            break;
+            case 'R':
+                if (ruleSpecCount >= MAX_RULE_SPECS)
+                {
+                    printf("error: at most %d rules\n", MAX_RULE_SPECS);
+                    exit(1);
+                }
+                ruleSpecs[ruleSpecCount++] = optarg;
+            break;
             case ':':
                 printf("error: missing argument for -%c\n", optopt);
                 printUsage(argv[0]);
@@ -231,154 +520,1516 @@ void parseArgs(int argc, char** argv, int* eventFilter, int* pidFilter, char* pr
         }
     }
 
-    if (optind < argc)
-    {
-        strcpy(pathFilter, argv[optind]);
-        printf("Using '%s' for path filtering.\n", pathFilter);
-    }
-    else
+    //a filter file or inode targets may take their place
+    if (optind == argc && NULL == filterPath && !isTargetEnabled())
     {
         printf("error: missing argument path_filter\n");
         printUsage(argv[0]);
         exit(1);
     }
+
+    pathPatterns = argv + optind;
+    pathPatternCount = argc - optind;
     
 }
 
+void handleEntry(struct AuditEntry* entry, void* context);
 
-int main(int argc, char** argv)
+//the same line as printed directly, for the enrichment workers to extend
+size_t formatEntry(char* line, size_t size, const struct AuditEntry* entry, const struct ProcessInfo* process, const char* processName, double weight)
 {
-    int eventFilter = 0;
-    int pidFilter = 0;
-    char processFilter[64];
-    char pathFilter[128];
-    memset(processFilter, 0, sizeof(processFilter));
-    memset(pathFilter, 0, sizeof(pathFilter));
-
-    parseArgs(argc, argv, &eventFilter, &pidFilter, processFilter, pathFilter);
+    int length = snprintf(line, size, "path:%s event:%s(%d) process:%s(%d)", entry->path, getEventName(entry->type), entry->type, processName, entry->pid);
 
-    const char* pipePath = "/dev/auditpipe";
+    if (isSamplingEnabled() && length >= 0 && (size_t)length < size)
+    {
+        length += snprintf(line + length, size - length, " weight:%g", weight);
+    }
 
-    if (geteuid() != 0)
+    if (isCgroupAttributionEnabled() && NULL != process && length >= 0 && (size_t)length < size)
     {
-        printf("error: need root privileges!\n");
-        return 0;
+        length += snprintf(line + length, size - length, " container:%s cgroup:%s",
+            process->container[0] != 0 ? process->container : "-", process->cgroup[0] != 0 ? process->cgroup : "-");
     }
 
-    parseEventNames(0);
+    return length < 0 ? 0 : (size_t)length < size ? (size_t)length : size - 1;
+}
 
-    FILE* pipeFile = fopen(pipePath, "r");
-    int fd = fileno(pipeFile);
+void onEnrichedLine(const char* line, size_t length, void* context)
+{
+    (void)context;
 
-    if (fd < 0)
-    {
-        fprintf(stderr, "Could not open pipe!\n");
+    outputPrintf("%.*s\n", (int)length, line);
+}
 
-        return 1;
-    }
+void onEnrichReady(struct EventLoop* loop, int fd, void* context)
+{
+    (void)loop; (void)fd; (void)context;
 
-    int mode = AUDITPIPE_PRESELECT_MODE_LOCAL;
-    if (ioctl(fd, AUDITPIPE_SET_PRESELECT_MODE, &mode) < 0)
+    enrichCollect(onEnrichedLine, NULL);
+}
+
+unsigned long long wallClockMilliseconds()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+
+    return (unsigned long long)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+//time from the record being written to it being handled, queueing included
+void recordLatency(unsigned long long timestamp)
+{
+    unsigned long long milliseconds = wallClockMilliseconds();
+    unsigned long long latency = milliseconds > timestamp ? milliseconds - timestamp : 0;
+    int bucket = 0;
+
+    while (bucket + 1 < LATENCY_BUCKETS && (latency >> bucket) > 0)
     {
-        fprintf(stderr, "Error: AUDITPIPE_SET_PRESELECT_MODE\n");
+        bucket++;
     }
 
-    int queueLength = 0;
-    if (ioctl(fd, AUDITPIPE_GET_QLIMIT_MAX, &queueLength) < 0)
+    stats.latencyCount++;
+    stats.latencySum += latency;
+    stats.latency[bucket]++;
+    if (latency > stats.latencyMax)
     {
-        fprintf(stderr, "Error: AUDITPIPE_GET_QLIMIT_MAX\n");
+        stats.latencyMax = latency;
     }
+}
 
-    if (ioctl(fd, AUDITPIPE_SET_QLIMIT, &queueLength) < 0)
+//upper bound of the bucket holding the given share of latencies
+unsigned long long latencyPercentile(double share)
+{
+    unsigned long long seen = 0;
+
+    for (int bucket = 0; bucket < LATENCY_BUCKETS; ++bucket)
     {
-        fprintf(stderr, "Error: AUDITPIPE_SET_QLIMIT\n");
+        seen += stats.latency[bucket];
+        if (seen >= stats.latencyCount * share)
+        {
+            return bucket == 0 ? 0 : (1ULL << bucket) - 1;
+        }
     }
 
-    u_int mask = 0xFFFFFFFF;
-    
-    if (ioctl(fd, AUDITPIPE_SET_PRESELECT_FLAGS, &mask) < 0)
+    return stats.latencyMax;
+}
+
+//rules name events, so they are compiled once the event names are known
+void compileRules()
+{
+    char error[128];
+
+    for (int i = 0; i < ruleSpecCount; ++i)
     {
-        fprintf(stderr, "Error: AUDITPIPE_SET_PRESELECT_FLAGS\n");
+        if (rulesAdd(ruleSpecs[i], getEventId, error, sizeof(error)) < 0)
+        {
+            printf("error: invalid rule '%s': %s\n", ruleSpecs[i], error);
+            exit(1);
+        }
+        printf("Using rule '%s'.\n", ruleSpecs[i]);
     }
+}
 
-    if (ioctl(fd, AUDITPIPE_SET_PRESELECT_NAFLAGS, &mask) < 0)
+//context is the process name, the process table may be on a shard thread
+void onAlert(const char* rule, const char* key, unsigned int count, const struct AuditEntry* entry, void* context)
+{
+    const char* processName = (const char*)context;
+
+    stats.printed++;
+    outputPrintf("alert: rule:%s key:%s count:%u path:%s event:%s(%d) process:%s(%d)\n",
+        rule, key, count, entry->path, getEventName(entry->type), entry->type, processName, entry->pid);
+}
+
+//with more than one source the merge stage decides when an entry is handled
+void deliverEntry(struct AuditEntry* entry, int source)
+{
+    if (isMergeEnabled())
     {
-        fprintf(stderr, "Error: AUDITPIPE_SET_PRESELECT_NAFLAGS\n");
+        mergePush(source, entry);
+    }
+    else
+    {
+        handleEntry(entry, NULL);
     }
+}
 
-    while (1)
+//the file or stream a merge source reads, NULL for fanotify
+struct RecordSource* getRecordSource(int id)
+{
+    if (NULL != trailFollower && id == followMergeId)
     {
-        u_char* buffer = NULL;
+        return followSource(trailFollower);
+    }
+
+    return NULL != pipeSource && id == pipeMergeId ? pipeSource : replaySources[id];
+}
 
-        int position = 0;
-        int length = au_read_rec(pipeFile, &buffer);
+//context points to the merge source id, as for BSM records
+void onLogEntry(struct AuditEntry* entry, void* context)
+{
+    stats.records++;
 
-        struct AuditEntry entry;
-        memset(&entry, 0, sizeof(struct AuditEntry));
-        
+    deliverEntry(entry, *(int*)context);
+}
 
-        while (length > 0)
+void handleLogLine(int* source, const struct RecordSource* from, const u_char* line, int length)
+{
+    if (NULL == logParsers[*source])
+    {
+        logParsers[*source] = auditLogCreate(onLogEntry, source);
+        if (NULL == logParsers[*source])
         {
-            tokenstr_t token;
+            return;
+        }
+    }
 
-            if (au_fetch_tok(&token, buffer + position, length) < 0)
-            {
-                break;
-            }
+    auditLogFeed(logParsers[*source], (const char*)line, length, from != pipeSource ? from->offset : 0);
+}
 
-            switch (token.id)
-            {
-                case AUT_HEADER32:
-                case AUT_HEADER32_EX:
-                case AUT_HEADER64:
-                case AUT_HEADER64_EX:
-                entry.type = token.tt.hdr32.e_type;
-                break;
-                case AUT_SUBJECT32:
-                case AUT_SUBJECT32_EX:
-                case AUT_SUBJECT64:
-                case AUT_SUBJECT64_EX:
-                entry.pid = token.tt.subj32.pid;
-                entry.userId = token.tt.subj32.ruid;
-                updateProcess(entry.pid);
-                break;
-                case AUT_PATH:
-                strcpy(entry.path, token.tt.path.path);
-                break;
-            }
+//context points to the merge source id of the record
+void handleRecord(u_char* buffer, int length, void* context)
+{
+    struct RecordSource* from = getRecordSource(*(int*)context);
 
-            position += token.len;
-            length -= token.len;
-        }
+    if (NULL != from && from->format == SOURCE_FORMAT_TEXT)
+    {
+        handleLogLine((int*)context, from, buffer, length);
+        return;
+    }
+
+    stats.records++;
 
-        free(buffer);
+#ifndef HAVE_BSM
+    //the tokens are parsed by libbsm, only audit.log can be read without it
+    static int warned = 0;
+    if (!warned++)
+    {
+        fprintf(stderr, "Could not read BSM records, this build has no libbsm!\n");
+    }
+#else
+    int position = 0;
+    struct AuditEntry entry;
+    memset(&entry, 0, sizeof(struct AuditEntry));
+
+    while (length > 0)
+    {
+        tokenstr_t token;
 
-        if (strstr(entry.path, pathFilter) != NULL)
+        if (au_fetch_tok(&token, buffer + position, length) < 0)
         {
-            int print = 1;
+            break;
+        }
 
-            const char * processName = getProcessName(entry.pid);
-            
-            if (pidFilter > 0 && pidFilter != entry.pid)
+        switch (token.id)
+        {
+            case AUT_HEADER32:
+            entry.type = token.tt.hdr32.e_type;
+            entry.timestamp = (unsigned long long)token.tt.hdr32.s * 1000 + token.tt.hdr32.ms;
+            break;
+            case AUT_HEADER32_EX:
+            entry.type = token.tt.hdr32_ex.e_type;
+            entry.timestamp = (unsigned long long)token.tt.hdr32_ex.s * 1000 + token.tt.hdr32_ex.ms;
+            break;
+            case AUT_HEADER64:
+            entry.type = token.tt.hdr64.e_type;
+            entry.timestamp = token.tt.hdr64.s * 1000 + token.tt.hdr64.ms;
+            break;
+            case AUT_HEADER64_EX:
+            entry.type = token.tt.hdr64_ex.e_type;
+            entry.timestamp = token.tt.hdr64_ex.s * 1000 + token.tt.hdr64_ex.ms;
+            break;
+            case AUT_SUBJECT32:
+            case AUT_SUBJECT32_EX:
+            case AUT_SUBJECT64:
+            case AUT_SUBJECT64_EX:
+            entry.pid = token.tt.subj32.pid;
+            entry.userId = token.tt.subj32.ruid;
+            break;
+            case AUT_PATH:
+            //a second one is a rename's target, the source is only seen here
+            if (entry.pathLength > 0 && isCanonicalEnabled() && canonicalIsRemoval(entry.type))
             {
-                print = 0;
+                canonicalInvalidate(entry.path, entry.pathLength);
             }
-            else if (eventFilter > 0 && eventFilter != entry.type)
+            strcpy(entry.path, token.tt.path.path);
+            entry.pathLength = strlen(entry.path);
+            break;
+            //the first one belongs to the file acted on, a rename may add the replaced file's
+            case AUT_ATTR32:
+            if (entry.inode == 0)
             {
-                print = 0;
+                entry.device = token.tt.attr32.fsid;
+                entry.inode = token.tt.attr32.nid;
             }
-            else if (processFilter[0] != 0 && strstr(processName, processFilter) == NULL)
+            break;
+            case AUT_ATTR64:
+            if (entry.inode == 0)
             {
-                print = 0;
+                entry.device = token.tt.attr64.fsid;
+                entry.inode = token.tt.attr64.nid;
             }
-
-            if (print)
+            break;
+            case AUT_ARG32:
+            if (strcmp(token.tt.arg32.text, "child PID") == 0)
+            {
+                entry.childPid = token.tt.arg32.val;
+            }
+            break;
+            case AUT_ARG64:
+            if (strcmp(token.tt.arg64.text, "child PID") == 0)
             {
-                printf("path:%s event:%s(%d) process:%s(%d)\n", entry.path, getEventName(entry.type), entry.type, processName, entry.pid);
+                entry.childPid = (int)token.tt.arg64.val;
             }
+            break;
         }
+
+        position += token.len;
+        length -= token.len;
     }
 
-    fclose(pipeFile);
-    return 0;
-}
\ No newline at end of file
+    //records of the pipe went through the queue, their offset is not known
+    entry.position = NULL != from && from != pipeSource ? from->offset : 0;
+
+    deliverEntry(&entry, *(int*)context);
+#endif
+}
+
+//an inode target or a path filter, either one is enough
+int isEntryMatched(const struct FilterSet* filters, const struct AuditEntry* entry, int targetMatched)
+{
+    return targetMatched || (filters->pathCount > 0 && filterMatchPath(filters, entry->path, entry->pathLength));
+}
+
+//event and process filters, once the path matched
+int isEntrySelected(const struct FilterSet* filters, const struct AuditEntry* entry, const struct ProcessInfo* process)
+{
+    if (filters->event > 0 && filters->event != entry->type)
+    {
+        return 0;
+    }
+
+    return NULL != process ? process->selected : isProcessSelected(entry->pid);
+}
+
+//the stages after the filters, on the main thread even when sharded
+void handleMatch(struct AuditEntry* entry, const struct ProcessInfo* process, int print, double weight)
+{
+    stats.matched++;
+
+    const char * processName = NULL != process && process->processPath[0] != 0 ? process->processPath : "?";
+
+    if (print && isRulesEnabled())
+    {
+        rulesEvaluate(entry, onAlert, (void*)processName);
+        print = 0;
+    }
+
+    if (print && isSessionEnabled() && sessionObserve(entry))
+    {
+        print = 0;
+    }
+
+    if (print && isHeatmapEnabled())
+    {
+        heatmapAdd(entry->path, entry->type);
+        print = 0;
+    }
+
+    if (print && overloaded)
+    {
+        struct EventCount *c = (struct EventCount*)intTableFind(summaryCounts, entry->type);
+        if (NULL == c)
+        {
+            c = (struct EventCount*)malloc(sizeof(struct EventCount));
+            memset(c, 0, sizeof(struct EventCount));
+            c->type = entry->type;
+            intTableInsert(summaryCounts, c->type, c);
+        }
+        c->count++;
+    }
+    else if (print)
+    {
+        stats.printed++;
+        if (isEnrichEnabled())
+        {
+            char line[LINE_SIZE];
+            size_t length = formatEntry(line, sizeof(line), entry, process, processName, weight);
+            enrichSubmit(entry, line, length, onEnrichedLine, NULL);
+        }
+        else
+        {
+            outputPrintf("path:%s event:%s(%d) process:%s(%d)", entry->path, getEventName(entry->type), entry->type, processName, entry->pid);
+            if (isSamplingEnabled())
+            {
+                outputPrintf(" weight:%g", weight);
+            }
+            if (isCgroupAttributionEnabled() && NULL != process)
+            {
+                outputPrintf(" container:%s cgroup:%s", process->container[0] != 0 ? process->container : "-", process->cgroup[0] != 0 ? process->cgroup : "-");
+            }
+            outputPrintf("\n");
+        }
+    }
+}
+
+//runs on the thread owning the pid's process table entries
+void shardWork(int shard, struct ShardItem* item, void* context)
+{
+    (void)context;
+
+    struct AuditEntry* entry = &item->entry;
+
+    item->matched = 0;
+    if (!item->sampledOut)
+    {
+        if (isExecEvent(entry->type))
+        {
+            processExeced(entry->pid);
+        }
+
+        //one load per item, a reload in between takes effect with the next one
+        const struct FilterSet* filters = filterCurrent();
+        struct ProcessInfo* process = updateProcess(entry->pid, entry->parentPid, entry->processPath);
+
+        if (isEntryMatched(filters, entry, item->targetMatched))
+        {
+            item->matched = 1;
+            item->print = isEntrySelected(filters, entry, process);
+            item->hasProcess = NULL != process;
+            if (NULL != process)
+            {
+                memcpy(&item->process, process, sizeof(struct ProcessInfo));
+            }
+        }
+    }
+
+    updateLineage(entry);
+    shardProcessCounts[shard] = getProcessCount();
+}
+
+void onShardDone(struct ShardItem* item, void* context)
+{
+    (void)context;
+
+    if (item->matched)
+    {
+        handleMatch(&item->entry, item->hasProcess ? &item->process : NULL, item->print, item->weight);
+    }
+}
+
+void onShardReady(struct EventLoop* loop, int fd, void* context)
+{
+    (void)loop; (void)fd; (void)context;
+
+    shardCollect(onShardDone, NULL);
+}
+
+void handleEntry(struct AuditEntry* entry, void* context)
+{
+    (void)context;
+
+    if (entry->timestamp > latestTimestamp)
+    {
+        latestTimestamp = entry->timestamp;
+    }
+
+    if (measureLatency)
+    {
+        recordLatency(entry->timestamp);
+    }
+
+    //every later stage sees one spelling per file
+    if (isCanonicalEnabled())
+    {
+        canonicalizeEntry(entry);
+    }
+
+    //renames are followed whether or not the entry is sampled out
+    int targetMatched = isTargetEnabled() && targetObserve(entry);
+
+    double weight = 1.0;
+    int sampledOut = isSamplingEnabled() && !sampleEntry(entry, &weight);
+    if (sampledOut)
+    {
+        stats.sampledOut++;
+    }
+
+    //the process lookups and filters run on the pid's worker, the rest comes back in order
+    if (isShardingEnabled())
+    {
+        struct ShardItem* item = shardAcquire(onShardDone, NULL);
+        memcpy(&item->entry, entry, sizeof(struct AuditEntry));
+        item->weight = weight;
+        item->sampledOut = sampledOut;
+        item->targetMatched = targetMatched;
+        shardSubmit(item);
+        return;
+    }
+
+    if (sampledOut)
+    {
+        updateLineage(entry);
+        return;
+    }
+
+    if (isExecEvent(entry->type))
+    {
+        processExeced(entry->pid);
+    }
+
+    const struct FilterSet* filters = filterCurrent();
+    struct ProcessInfo* process = updateProcess(entry->pid, entry->parentPid, entry->processPath);
+
+    if (isEntryMatched(filters, entry, targetMatched))
+    {
+        handleMatch(entry, process, isEntrySelected(filters, entry, process), weight);
+    }
+
+    updateLineage(entry);
+}
+
+void onTypeCapped(int type, unsigned long long seen, unsigned long long kept, void* context)
+{
+    (void)context;
+
+    outputPrintf("sampled: event:%s(%d) seen:%llu kept:%llu\n", getEventName(type), type, seen, kept);
+}
+
+void onSessionEnd(const struct Session* session, int reason, void* context)
+{
+    (void)context;
+
+    stats.printed++;
+    outputPrintf("session: path:%s process:%s(%d) start:%llu duration_ms:%llu opens:%u reads:%u writes:%u closes:%u end:%s\n",
+        session->path, getProcessName(session->pid), session->pid, session->start, session->last - session->start,
+        session->opens, session->reads, session->writes, session->closes, sessionEndName(reason));
+}
+
+void onHeatNode(const char* path, int depth, const struct HeatCounts* counts, unsigned long long all, void* context)
+{
+    (void)context;
+
+    char types[256];
+    size_t length = 0;
+
+    types[0] = 0;
+    for (int i = 0; i < HEAT_TYPES && counts->counts[i] > 0 && length < sizeof(types); ++i)
+    {
+        const char* name = getEventName(counts->types[i]);
+        int written = NULL != name
+            ? snprintf(types + length, sizeof(types) - length, " %s:%llu", name, counts->counts[i])
+            : snprintf(types + length, sizeof(types) - length, " %d:%llu", counts->types[i], counts->counts[i]);
+        length += written > 0 ? (size_t)written : 0;
+    }
+
+    stats.printed++;
+    outputPrintf("heat: %*s%s events:%llu share:%.1f%%%s%s\n", depth * 2, "", path, counts->total,
+        100.0 * counts->total / all, types, counts->other > 0 ? " other" : "");
+}
+
+void onHeatmapTimer(struct EventLoop* loop, int id, void* context)
+{
+    (void)loop; (void)id; (void)context;
+
+    heatmapRollup(onHeatNode, NULL);
+}
+
+int printEventCount(int type, void* value, void* context)
+{
+    (void)context;
+
+    struct EventCount *c = (struct EventCount*)value;
+    outputPrintf("summary: event:%s(%d) count:%llu\n", getEventName(type), type, c->count);
+    free(c);
+
+    return 0;
+}
+
+void printSummary()
+{
+    if (NULL != summaryCounts)
+    {
+        intTableRemoveIf(summaryCounts, printEventCount, NULL);
+    }
+}
+
+//enters summary mode at 3/4 full and leaves it at 1/4 so it does not flap
+void updateOverload()
+{
+    unsigned int count = queueCount(recordQueue);
+    unsigned int capacity = queueCapacity(recordQueue);
+
+    if (!overloaded && count >= capacity / 4 * 3)
+    {
+        if (NULL == summaryCounts)
+        {
+            summaryCounts = intTableCreate(0);
+        }
+        if (NULL == summaryCounts)
+        {
+            return;
+        }
+        overloaded = 1;
+        outputPrintf("overload: queue %u/%u, printing summaries\n", count, capacity);
+    }
+    else if (overloaded && count <= capacity / 4)
+    {
+        overloaded = 0;
+        printSummary();
+        outputPrintf("overload: queue %u/%u, printing records again\n", count, capacity);
+    }
+}
+
+void enqueueRecord(u_char* buffer, int length, void* context)
+{
+    (void)context;
+
+    queuePush(recordQueue, buffer, length);
+}
+
+void onSourceReadable(struct EventLoop* loop, int fd, void* context)
+{
+    struct RecordSource* source = (struct RecordSource*)context;
+    int limit = RECORDS_PER_INGEST;
+
+    //never take more than fits so nothing read is lost, the kernel drops instead
+    if (overloadPolicy == OVERLOAD_BLOCK)
+    {
+        unsigned int room = queueCapacity(recordQueue) - queueCount(recordQueue);
+        if (room == 0)
+        {
+            eventLoopRemoveReader(loop, fd);
+            readerPaused = 1;
+            return;
+        }
+        if (room < (unsigned int)limit)
+        {
+            limit = (int)room;
+        }
+    }
+
+    if (sourceDrain(source, limit, enqueueRecord, NULL) < 0)
+    {
+        fprintf(stderr, "error: reading %s failed\n", source->name);
+        eventLoopRemoveReader(loop, fd);
+        eventLoopStop(loop);
+    }
+}
+
+void drainFollowedTrail(void)
+{
+    int handled = followDrain(trailFollower, RECORDS_PER_WAKEUP, handleRecord, &followMergeId);
+
+    if (handled < 0)
+    {
+        fprintf(stderr, "Could not read %s: %s\n", followPath, strerror(errno));
+    }
+    followPending = handled > 0;
+
+    if (isMergeEnabled())
+    {
+        mergeAdvance(wallClockMilliseconds());
+    }
+}
+
+void onTrailChanged(struct EventLoop* loop, int id, void* context)
+{
+    (void)loop; (void)id; (void)context;
+
+    drainFollowedTrail();
+}
+
+//runs the expensive stages on queued records between wakeups
+int processQueue(struct EventLoop* loop, void* context)
+{
+    (void)context;
+
+    for (int i = 0; i < RECORDS_PER_WAKEUP; ++i)
+    {
+        int length = 0;
+        u_char* record = queuePop(recordQueue, &length);
+        if (NULL == record)
+        {
+            break;
+        }
+
+        handleRecord(record, length, &pipeMergeId);
+        queueRelease(recordQueue, record, length);
+    }
+
+    if (isMergeEnabled())
+    {
+        mergeAdvance(wallClockMilliseconds());
+    }
+
+    if (degradeToSummary)
+    {
+        updateOverload();
+    }
+
+    if (readerPaused && queueCount(recordQueue) <= queueCapacity(recordQueue) / 2)
+    {
+        readerPaused = 0;
+        eventLoopAddReader(loop, pipeSource->fd, onSourceReadable, pipeSource);
+    }
+
+    return queueCount(recordQueue) > 0;
+}
+
+int onLoopIdle(struct EventLoop* loop, void* context)
+{
+    int pending = NULL != recordQueue ? processQueue(loop, context) : 0;
+
+    if (followPending)
+    {
+        drainFollowedTrail();
+    }
+
+    return pending || followPending;
+}
+
+void printStats(FILE* out)
+{
+    static unsigned long long lastRecords = 0;
+    static struct timespec lastTime;
+    struct timespec now;
+    u_int64_t drops = 0;
+    unsigned long long readCalls = NULL != pipeSource ? pipeSource->readCalls : 0;
+    readCalls += NULL != trailFollower ? followSource(trailFollower)->readCalls : 0;
+
+#ifdef HAVE_BSM
+    if (NULL != pipeSource && NULL == feedPath)
+    {
+        ioctl(pipeSource->fd, AUDITPIPE_GET_DROPS, &drops);
+    }
+#endif
+
+    //throughput since the previous stats line
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    double seconds = lastTime.tv_sec > 0 ? (now.tv_sec - lastTime.tv_sec) + (now.tv_nsec - lastTime.tv_nsec) / 1e9 : 0;
+    double recordRate = seconds > 0 ? (stats.records - lastRecords) / seconds : 0;
+    lastRecords = stats.records;
+    lastTime = now;
+
+    for (int i = 0; i < replayCount; ++i)
+    {
+        readCalls += NULL != replaySources[i] ? replaySources[i]->readCalls : 0;
+    }
+
+    unsigned int processCount = getProcessCount();
+    for (int i = 0; i < shardWorkers; ++i)
+    {
+        processCount += shardProcessCounts[i];
+    }
+
+    unsigned long long cacheHits = 0;
+    unsigned long long cacheMisses = 0;
+    if (NULL != fanotifySource)
+    {
+        fanotifyCacheStats(fanotifySource, &cacheHits, &cacheMisses);
+    }
+
+    fprintf(out, "stats: records:%llu rate:%.0f/s sampled_out:%llu matched:%llu printed:%llu pipe_drops:%llu processes:%u reads:%llu writes:%llu uring_calls:%llu dir_cache_hits:%llu dir_cache_misses:%llu",
+        stats.records, recordRate, stats.sampledOut, stats.matched, stats.printed, (unsigned long long)drops, processCount,
+        readCalls, outputWriteCalls(), ring ? uringSystemCalls(ring) : 0, cacheHits, cacheMisses);
+
+    if (stats.latencyCount > 0)
+    {
+        fprintf(out, " latency_avg_ms:%.1f latency_p50_ms:%llu latency_p99_ms:%llu latency_max_ms:%llu",
+            (double)stats.latencySum / stats.latencyCount, latencyPercentile(0.5), latencyPercentile(0.99), stats.latencyMax);
+    }
+
+    if (NULL != fanotifySource)
+    {
+        fprintf(out, " fanotify_overflows:%llu", fanotifyOverflows(fanotifySource));
+    }
+
+    if (NULL != trailFollower)
+    {
+        fprintf(out, " trail_rotations:%llu", followRotations(trailFollower));
+    }
+
+    if (NULL != filterPath)
+    {
+        fprintf(out, " filter_reloads:%llu", stats.filterReloads);
+    }
+
+    if (isTargetEnabled())
+    {
+        fprintf(out, " targets:%u target_renames:%llu", getTargetCount(), getTargetRenames());
+    }
+
+    if (isCanonicalEnabled())
+    {
+        unsigned long long aliasHits = 0;
+        unsigned long long aliasMisses = 0;
+        unsigned long long aliasInvalidated = 0;
+        canonicalCacheStats(&aliasHits, &aliasMisses, &aliasInvalidated);
+        fprintf(out, " realpath_cache_hits:%llu realpath_cache_misses:%llu realpath_cache_invalidated:%llu", aliasHits, aliasMisses, aliasInvalidated);
+    }
+
+    for (unsigned int i = 0; i < getMergeSourceCount(); ++i)
+    {
+        if (NULL != logParsers[i])
+        {
+            fprintf(out, " log_events[%s]:%llu log_skipped[%s]:%llu", getMergeSourceName(i), auditLogEvents(logParsers[i]),
+                getMergeSourceName(i), auditLogSkipped(logParsers[i]));
+        }
+    }
+
+    if (isSessionEnabled())
+    {
+        fprintf(out, " sessions:%u", getSessionCount());
+    }
+
+    if (isHeatmapEnabled())
+    {
+        fprintf(out, " heat_nodes:%u heat_truncated:%llu", getHeatmapNodeCount(), getHeatmapTruncated());
+    }
+
+    if (isRulesEnabled())
+    {
+        fprintf(out, " rule_keys:%u rule_untracked:%llu", getRuleKeyCount(), getRuleUntracked());
+    }
+
+    if (isEnrichEnabled())
+    {
+        fprintf(out, " enrich_skipped:%llu", getEnrichSkipped());
+    }
+
+    if (isMergeEnabled())
+    {
+        for (unsigned int i = 0; i < getMergeSourceCount(); ++i)
+        {
+            const char* name = getMergeSourceName(i);
+            fprintf(out, " lag_ms[%s]:%llu max_lag_ms[%s]:%llu late[%s]:%llu",
+                name, getMergeLag(i), name, getMergeMaxLag(i), name, getMergeLate(i));
+        }
+    }
+
+    if (NULL != recordQueue)
+    {
+        fprintf(out, " queued:%u/%u", queueCount(recordQueue), queueCapacity(recordQueue));
+        for (int reason = 0; reason < DROP_REASON_COUNT; ++reason)
+        {
+            fprintf(out, " %s:%llu", queueDropReasonName(reason), queueDrops(recordQueue, reason));
+        }
+    }
+
+    fprintf(out, "\n");
+}
+
+void onFlushTimer(struct EventLoop* loop, int id, void* context)
+{
+    (void)loop; (void)id; (void)context;
+
+    if (overloaded)
+    {
+        printSummary();
+    }
+
+    if (isSessionEnabled() || isRulesEnabled() || isMergeEnabled())
+    {
+        unsigned long long milliseconds = wallClockMilliseconds();
+        //a quiet source holds the others up for at most the merge window
+        mergeAdvance(milliseconds);
+        sessionExpire(milliseconds);
+        rulesExpire(milliseconds);
+    }
+
+    outputFlush();
+}
+
+void onPruneTimer(struct EventLoop* loop, int id, void* context)
+{
+    (void)loop; (void)id; (void)context;
+
+    pruneExitedProcesses();
+}
+
+void onStatsTimer(struct EventLoop* loop, int id, void* context)
+{
+    (void)loop; (void)id; (void)context;
+
+    printStats(stderr);
+}
+
+//records still waiting in the merge or in an open audit log event are read again after a restart
+unsigned long long getResumePosition(int id, const struct RecordSource* source)
+{
+    unsigned long long position = source->offset;
+    unsigned long long older = 0;
+
+    if (NULL != logParsers[id] && auditLogOldestPosition(logParsers[id], &older) && older < position)
+    {
+        position = older;
+    }
+
+    if (getMergeOldestPosition(id, &older) && older < position)
+    {
+        position = older;
+    }
+
+    return position;
+}
+
+//waits for the stages so that no record before the saved positions is still in flight
+void saveCheckpoint(void)
+{
+    struct Checkpoint checkpoint;
+    memset(&checkpoint, 0, sizeof(struct Checkpoint));
+
+    shardDrain(onShardDone, NULL);
+    enrichDrain(onEnrichedLine, NULL);
+    outputFlush();
+
+    checkpoint.latestTimestamp = latestTimestamp;
+    for (int i = 0; i < replayCount && NULL != replaySources[i]; ++i)
+    {
+        checkpointSetSource(&checkpoint.sources[checkpoint.sourceCount++], replayPaths[i], replaySources[i]->fd,
+            getResumePosition(replayIds[i], replaySources[i]));
+    }
+
+    if (NULL != trailFollower)
+    {
+        checkpointSetSource(&checkpoint.sources[checkpoint.sourceCount++], followPath, followSource(trailFollower)->fd,
+            getResumePosition(followMergeId, followSource(trailFollower)));
+    }
+
+    //the workers keep their processes to themselves
+    if (checkpointWrite(checkpointPath, &checkpoint, shardWorkers == 0) < 0)
+    {
+        fprintf(stderr, "Could not write checkpoint %s: %s\n", checkpointPath, strerror(errno));
+    }
+}
+
+void onCheckpointTimer(struct EventLoop* loop, int id, void* context)
+{
+    (void)loop; (void)id; (void)context;
+
+    saveCheckpoint();
+}
+
+void onReplaySignal(int signalNumber)
+{
+    (void)signalNumber;
+
+    replayStopped = 1;
+}
+
+void onShutdownSignal(struct EventLoop* loop, int signalNumber, void* context)
+{
+    (void)signalNumber; (void)context;
+
+    eventLoopStop(loop);
+}
+
+#ifdef HAVE_BSM
+//the classes of the filtered event and of the process lifecycle events the lineage needs, all without an event filter
+void applyPreselection(int fd, const struct FilterSet* filters)
+{
+    static const int lifecycleEvents[] = { AUE_FORK, AUE_VFORK, AUE_EXECVE, AUE_EXIT };
+    au_mask_t mask;
+    au_class_t classes = 0xFFFFFFFF;
+
+    if (fd < 0)
+    {
+        return;
+    }
+
+    struct au_event_ent* event = filters->event > 0 ? getauevnum(filters->event) : NULL;
+    if (NULL != event)
+    {
+        classes = event->ae_class;
+        for (size_t i = 0; i < sizeof(lifecycleEvents) / sizeof(lifecycleEvents[0]); ++i)
+        {
+            //an event unknown to audit_event could be in any class
+            event = getauevnum(lifecycleEvents[i]);
+            classes |= NULL != event ? event->ae_class : 0xFFFFFFFF;
+        }
+    }
+
+    mask.am_success = classes;
+    mask.am_failure = classes;
+
+    if (ioctl(fd, AUDITPIPE_SET_PRESELECT_FLAGS, &mask) < 0)
+    {
+        fprintf(stderr, "Error: AUDITPIPE_SET_PRESELECT_FLAGS\n");
+    }
+
+    if (ioctl(fd, AUDITPIPE_SET_PRESELECT_NAFLAGS, &mask) < 0)
+    {
+        fprintf(stderr, "Error: AUDITPIPE_SET_PRESELECT_NAFLAGS\n");
+    }
+}
+#else
+//there is no audit pipe to preselect on
+void applyPreselection(int fd, const struct FilterSet* filters)
+{
+    (void)fd; (void)filters;
+}
+#endif
+
+//-1 with the reason printed if the file is unusable, the old filters stay then
+int reloadFilters(void)
+{
+    char error[256];
+    struct FilterSet* filters = loadFilters(error, sizeof(error));
+
+    if (NULL == filters)
+    {
+        fprintf(stderr, "Could not reload the filters: %s\n", error);
+        return -1;
+    }
+
+    filterPublish(filters);
+    applyPreselection(auditPipeFd, filters);
+    stats.filterReloads++;
+    fprintf(stderr, "Reloaded the filters from %s.\n", filterPath);
+    printFilters(stderr, filters);
+
+    //every item handed back was matched before or after the swap, either way no worker still reads the old set
+    shardDrain(onShardDone, NULL);
+    filterReclaim();
+    return 0;
+}
+
+void onReloadSignal(struct EventLoop* loop, int signalNumber, void* context)
+{
+    (void)loop; (void)signalNumber; (void)context;
+
+    reloadFilters();
+}
+
+void onControlCommand(const char* command, int clientFd, void* context)
+{
+    struct EventLoop* loop = (struct EventLoop*)context;
+
+    if (strcmp(command, "stats") == 0)
+    {
+        FILE* out = fdopen(dup(clientFd), "w");
+        if (out)
+        {
+            printStats(out);
+            fclose(out);
+        }
+    }
+    else if (strcmp(command, "flush") == 0)
+    {
+        outputFlush();
+        dprintf(clientFd, "ok\n");
+    }
+    else if (strcmp(command, "quit") == 0)
+    {
+        dprintf(clientFd, "ok\n");
+        eventLoopStop(loop);
+    }
+    else if (strcmp(command, "reload") == 0)
+    {
+        if (NULL == filterPath)
+        {
+            dprintf(clientFd, "error: no filter file, start with -L\n");
+        }
+        else
+        {
+            dprintf(clientFd, reloadFilters() == 0 ? "ok\n" : "error: filter file rejected, see stderr\n");
+        }
+    }
+    else
+    {
+        dprintf(clientFd, "error: unknown command '%s', use stats, flush, reload or quit\n", command);
+    }
+}
+
+#ifdef HAVE_BSM
+struct RecordSource* openAuditPipe(const char* pipePath)
+{
+    struct RecordSource* source = sourceOpen(pipePath);
+
+    if (NULL == source)
+    {
+        return NULL;
+    }
+
+    int fd = source->fd;
+
+    int mode = AUDITPIPE_PRESELECT_MODE_LOCAL;
+    if (ioctl(fd, AUDITPIPE_SET_PRESELECT_MODE, &mode) < 0)
+    {
+        fprintf(stderr, "Error: AUDITPIPE_SET_PRESELECT_MODE\n");
+    }
+
+    int queueLength = 0;
+    if (ioctl(fd, AUDITPIPE_GET_QLIMIT_MAX, &queueLength) < 0)
+    {
+        fprintf(stderr, "Error: AUDITPIPE_GET_QLIMIT_MAX\n");
+    }
+
+    if (ioctl(fd, AUDITPIPE_SET_QLIMIT, &queueLength) < 0)
+    {
+        fprintf(stderr, "Error: AUDITPIPE_SET_QLIMIT\n");
+    }
+
+    auditPipeFd = fd;
+    applyPreselection(fd, filterCurrent());
+
+    return source;
+}
+#else
+struct RecordSource* openAuditPipe(const char* pipePath)
+{
+    (void)pipePath;
+    fprintf(stderr, "There is no audit pipe on this system, use -m, -r, -F or -f.\n");
+
+    return NULL;
+}
+#endif
+
+//a FIFO is also opened for writing so that it never reports the end when
+//one load generator run finishes and before the next one starts
+struct RecordSource* openFeed(const char* path)
+{
+    struct stat info;
+
+    if (strcmp(path, "-") == 0)
+    {
+        return sourceOpenFd("stdin", STDIN_FILENO);
+    }
+
+    int fd = stat(path, &info) == 0 && S_ISFIFO(info.st_mode)
+        ? open(path, O_RDWR | O_NONBLOCK)
+        : open(path, O_RDONLY | O_NONBLOCK);
+
+    if (fd < 0)
+    {
+        return NULL;
+    }
+
+    return sourceOpenFd(path, fd);
+}
+
+void onFanotifyEntry(struct AuditEntry* entry, void* context)
+{
+    (void)context;
+
+    stats.records++;
+    deliverEntry(entry, fanotifyMergeId);
+}
+
+void onFanotifyReadable(struct EventLoop* loop, int fd, void* context)
+{
+    struct FanotifySource* source = (struct FanotifySource*)context;
+
+    if (fanotifyDrain(source, RECORDS_PER_WAKEUP, onFanotifyEntry, NULL) < 0)
+    {
+        fprintf(stderr, "error: reading fanotify events failed\n");
+        eventLoopRemoveReader(loop, fd);
+        eventLoopStop(loop);
+    }
+
+    if (isMergeEnabled())
+    {
+        mergeAdvance(wallClockMilliseconds());
+    }
+}
+
+//reads trail files as fast as possible, the event loop is not needed for that
+int replayTrails(const char** paths, int count)
+{
+    struct timespec start;
+    struct timespec end;
+    int ended[MAX_MERGE_SOURCES];
+    unsigned long long bytes = 0;
+
+    compileRules();
+
+    mergeConfigure(mergeWindow, handleEntry, NULL);
+    for (int i = 0; i < count; ++i)
+    {
+        replaySources[i] = sourceOpen(paths[i]);
+        if (NULL == replaySources[i])
+        {
+            fprintf(stderr, "Could not open %s!\n", paths[i]);
+            return 1;
+        }
+        replayIds[i] = mergeAddSource(paths[i]);
+        ended[i] = 0;
+
+        //a trail that was replaced or cut since the checkpoint is read from the start
+        unsigned long long position = checkpointResumePosition(&resumeCheckpoint, paths[i], replaySources[i]->fd);
+        if (position > 0 && sourceSeek(replaySources[i], position) < 0)
+        {
+            fprintf(stderr, "Could not continue %s at offset %llu, reading it from the start.\n", paths[i], position);
+        }
+        else if (position > 0)
+        {
+            fprintf(stderr, "Continuing %s at offset %llu.\n", paths[i], position);
+        }
+    }
+
+    //the reads of one file keep the ring busy, so it is not shared
+    if (NULL != ring && count == 1 && sourceUseUring(replaySources[0], ring) < 0)
+    {
+        fprintf(stderr, "Could not read %s through io_uring, using read.\n", paths[0]);
+    }
+
+    outputInit(STDOUT_FILENO, ring);
+
+    unsigned long long nextCheckpoint = wallClockMilliseconds() + CHECKPOINT_INTERVAL_MS;
+    if (NULL != checkpointPath)
+    {
+        //stops at the next round so that the exit checkpoint has the positions
+        signal(SIGINT, onReplaySignal);
+        signal(SIGTERM, onReplaySignal);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int remaining = count; remaining > 0 && !replayStopped; )
+    {
+        for (int i = 0; i < count; ++i)
+        {
+            //a trail with records still queued in the merge is ahead, read the others
+            if (ended[i] || getMergeQueued(replayIds[i]) > 0)
+            {
+                continue;
+            }
+
+            if (sourceDrain(replaySources[i], RECORDS_PER_WAKEUP, handleRecord, &replayIds[i]) < 0)
+            {
+                ended[i] = 1;
+                remaining--;
+                if (NULL != logParsers[replayIds[i]])
+                {
+                    auditLogFlush(logParsers[replayIds[i]]);
+                }
+                mergeSourceDone(replayIds[i]);
+            }
+        }
+
+        //the trail's own clock decides when sessions and rule keys time out
+        sessionExpire(latestTimestamp);
+        rulesExpire(latestTimestamp);
+        shardCollect(onShardDone, NULL);
+        enrichCollect(onEnrichedLine, NULL);
+
+        if (NULL != checkpointPath && wallClockMilliseconds() >= nextCheckpoint)
+        {
+            saveCheckpoint();
+            nextCheckpoint = wallClockMilliseconds() + CHECKPOINT_INTERVAL_MS;
+        }
+    }
+    mergeFinish();
+    shardFinish(onShardDone, NULL);
+    enrichFinish(onEnrichedLine, NULL);
+    if (NULL != checkpointPath)
+    {
+        saveCheckpoint();
+    }
+    sessionFinish();
+    samplerFinish();
+    heatmapRollup(onHeatNode, NULL);
+    outputFinish();
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    for (int i = 0; i < count; ++i)
+    {
+        bytes += replaySources[i]->bytes;
+    }
+
+    double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    fprintf(stderr, "replayed %llu records, %llu bytes in %.3f s (%.0f records/s)\n",
+        stats.records, bytes, seconds, seconds > 0 ? stats.records / seconds : 0.0);
+    if (statsInterval > 0)
+    {
+        printStats(stderr);
+    }
+
+    for (int i = 0; i < count; ++i)
+    {
+        sourceClose(replaySources[i]);
+        auditLogDestroy(logParsers[replayIds[i]]);
+    }
+    uringDestroy(ring);
+    filterShutdown();
+    canonicalFinish();
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    memset(processFilter, 0, sizeof(processFilter));
+
+    parseArgs(argc, argv, &eventFilter, &pidFilter, processFilter);
+
+    char filterError[256];
+    struct FilterSet* filters = loadFilters(filterError, sizeof(filterError));
+    if (NULL == filters)
+    {
+        printf("error: %s\n", filterError);
+        return 1;
+    }
+    printFilters(stdout, filters);
+    filterPublish(filters);
+
+    if (typeCap > 0)
+    {
+        samplerSetTypeCap(typeCap, onTypeCapped, NULL);
+    }
+
+    if (sessionTimeout > 0)
+    {
+        sessionConfigure(0, sessionTimeout, onSessionEnd, NULL);
+    }
+
+    if (heatmapInterval > 0)
+    {
+        heatmapConfigure(0, 0, 0);
+    }
+
+    int shardFd = -1;
+    if (shardWorkers > 0)
+    {
+        //the workers do not see every process, nor do they report sessions
+        if (isProcessTreeEnabled() || isSessionEnabled())
+        {
+            printf("error: -j does not work with tree: process filters or -a\n");
+            return 1;
+        }
+
+        //picks the search variant before several threads would
+        findSubstringVariant();
+
+        shardFd = shardStart(shardWorkers, shardWork, NULL);
+        if (shardFd < 0)
+        {
+            fprintf(stderr, "Could not start the worker threads!\n");
+            return 1;
+        }
+    }
+
+    int enrichFd = -1;
+    if (enrichKinds > 0)
+    {
+        enrichFd = enrichStart(enrichKinds, enrichWorkers);
+        if (enrichFd < 0)
+        {
+            fprintf(stderr, "Could not start the enrichment threads!\n");
+            return 1;
+        }
+    }
+
+    const char* pipePath = "/dev/auditpipe";
+
+    if (useUring)
+    {
+        ring = uringCreate(URING_ENTRIES);
+        if (NULL == ring)
+        {
+            fprintf(stderr, "io_uring is not available, using read and write.\n");
+        }
+    }
+
+    memset(&resumeCheckpoint, 0, sizeof(struct Checkpoint));
+    if (NULL != checkpointPath && checkpointRead(checkpointPath, &resumeCheckpoint, shardWorkers == 0) < 0)
+    {
+        fprintf(stderr, "Could not read checkpoint %s, starting from scratch.\n", checkpointPath);
+        memset(&resumeCheckpoint, 0, sizeof(struct Checkpoint));
+    }
+    latestTimestamp = resumeCheckpoint.latestTimestamp;
+
+    if (replayCount > 0)
+    {
+        if (NULL != followPath)
+        {
+            printf("error: -F does not work with -r\n");
+            return 1;
+        }
+
+        return replayTrails(replayPaths, replayCount);
+    }
+
+    if (geteuid() != 0 && NULL == feedPath && NULL == followPath)
+    {
+        printf("error: need root privileges!\n");
+        return 0;
+    }
+
+    measureLatency = statsInterval > 0 || NULL != controlPath;
+
+    compileRules();
+
+    outputInit(STDOUT_FILENO, ring);
+
+    struct EventLoop* loop = eventLoopCreate();
+
+    if (NULL == loop)
+    {
+        fprintf(stderr, "Could not set up the event loop!\n");
+
+        return 1;
+    }
+
+    mergeConfigure(mergeWindow, handleEntry, NULL);
+
+    if (NULL != mountPath)
+    {
+        fanotifyMergeId = mergeAddSource("fanotify");
+        fanotifySource = fanotifyOpen(mountPath, 0);
+        if (NULL == fanotifySource)
+        {
+            fprintf(stderr, "Could not watch %s with fanotify: %s\n", mountPath, strerror(errno));
+
+            return 1;
+        }
+
+        if (eventLoopAddReader(loop, fanotifyFd(fanotifySource), onFanotifyReadable, fanotifySource) < 0)
+        {
+            fprintf(stderr, "Could not set up the event loop!\n");
+
+            return 1;
+        }
+    }
+
+    if (NULL != followPath)
+    {
+        followMergeId = mergeAddSource(followPath);
+        trailFollower = followOpen(followPath);
+        if (NULL == trailFollower)
+        {
+            fprintf(stderr, "Could not open %s!\n", followPath);
+
+            return 1;
+        }
+
+        //the trail was not rotated since the checkpoint, skip what was handled
+        unsigned long long position = checkpointResumePosition(&resumeCheckpoint, followPath, followSource(trailFollower)->fd);
+        if (position > 0 && sourceSeek(followSource(trailFollower), position) == 0)
+        {
+            fprintf(stderr, "Continuing %s at offset %llu.\n", followPath, position);
+        }
+
+        if (followWatch(trailFollower, loop, onTrailChanged, NULL) < 0)
+        {
+            fprintf(stderr, "Could not watch %s for changes!\n", followPath);
+
+            return 1;
+        }
+
+        //what is already in the trail is read before the first change, the idle hook reads on
+        drainFollowedTrail();
+        eventLoopSetIdle(loop, onLoopIdle, NULL);
+    }
+
+    if ((NULL == mountPath && NULL == followPath) || NULL != feedPath)
+    {
+        pipeMergeId = mergeAddSource(NULL != feedPath ? feedPath : "pipe");
+        pipeSource = NULL != feedPath ? openFeed(feedPath) : openAuditPipe(pipePath);
+
+        if (NULL == pipeSource)
+        {
+            fprintf(stderr, "Could not open %s!\n", NULL != feedPath ? feedPath : "pipe");
+
+            return 1;
+        }
+
+        recordQueue = queueCreate(queueLimit, overloadPolicy);
+        if (NULL == recordQueue)
+        {
+            fprintf(stderr, "Could not allocate the record queue!\n");
+
+            return 1;
+        }
+        eventLoopSetIdle(loop, onLoopIdle, NULL);
+
+        if (eventLoopAddReader(loop, pipeSource->fd, onSourceReadable, pipeSource) < 0)
+        {
+            fprintf(stderr, "Could not set up the event loop!\n");
+
+            return 1;
+        }
+    }
+
+    eventLoopAddSignal(loop, SIGINT, onShutdownSignal, NULL);
+    eventLoopAddSignal(loop, SIGTERM, onShutdownSignal, NULL);
+    if (NULL != filterPath)
+    {
+        eventLoopAddSignal(loop, SIGHUP, onReloadSignal, NULL);
+    }
+    eventLoopAddTimer(loop, FLUSH_INTERVAL_MS, onFlushTimer, NULL);
+    eventLoopAddTimer(loop, PRUNE_INTERVAL_MS, onPruneTimer, NULL);
+
+    if (statsInterval > 0)
+    {
+        eventLoopAddTimer(loop, statsInterval * 1000, onStatsTimer, NULL);
+    }
+
+    if (heatmapInterval > 0)
+    {
+        eventLoopAddTimer(loop, heatmapInterval * 1000, onHeatmapTimer, NULL);
+    }
+
+    if (NULL != checkpointPath)
+    {
+        eventLoopAddTimer(loop, CHECKPOINT_INTERVAL_MS, onCheckpointTimer, NULL);
+    }
+
+    if (shardFd >= 0)
+    {
+        eventLoopAddReader(loop, shardFd, onShardReady, NULL);
+    }
+
+    if (enrichFd >= 0)
+    {
+        eventLoopAddReader(loop, enrichFd, onEnrichReady, NULL);
+    }
+
+    if (NULL != controlPath && controlOpen(loop, controlPath, onControlCommand, loop) < 0)
+    {
+        fprintf(stderr, "Error: could not open control socket %s\n", controlPath);
+    }
+
+    eventLoopRun(loop);
+
+    for (int i = 0; i < MAX_MERGE_SOURCES; ++i)
+    {
+        //with a checkpoint, the followed trail's unfinished events are read again after the restart
+        if (NULL != logParsers[i] && (NULL == checkpointPath || NULL == trailFollower || i != followMergeId))
+        {
+            auditLogFlush(logParsers[i]);
+        }
+    }
+    mergeFinish();
+    shardFinish(onShardDone, NULL);
+    if (overloaded)
+    {
+        printSummary();
+    }
+    enrichFinish(onEnrichedLine, NULL);
+    if (NULL != checkpointPath)
+    {
+        saveCheckpoint();
+    }
+    sessionFinish();
+    samplerFinish();
+    heatmapRollup(onHeatNode, NULL);
+    outputFinish();
+    if (statsInterval > 0)
+    {
+        printStats(stderr);
+    }
+
+    controlClose(loop);
+    eventLoopDestroy(loop);
+    sourceClose(pipeSource);
+    queueDestroy(recordQueue);
+    fanotifyClose(fanotifySource);
+    followClose(trailFollower);
+    for (int i = 0; i < MAX_MERGE_SOURCES; ++i)
+    {
+        auditLogDestroy(logParsers[i]);
+    }
+    uringDestroy(ring);
+    filterShutdown();
+    canonicalFinish();
+    return 0;
+}
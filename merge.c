@@ -0,0 +1,315 @@
+#include "merge.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+//entries queued per source before the oldest is handed on regardless
+#define SOURCE_CAPACITY 4096
+
+struct MergeSource
+{
+    const char* name;
+    struct AuditEntry* entries;
+    unsigned int head;
+    unsigned int count;
+    int done;
+    unsigned long long newest;
+    unsigned long long maxLag;
+    unsigned long long late;
+};
+
+static struct MergeSource sources[MAX_MERGE_SOURCES];
+static unsigned int sourceCount = 0;
+//ids of the sources with queued entries, ordered by their oldest entry
+static int heap[MAX_MERGE_SOURCES];
+static unsigned int heapSize = 0;
+//sources still running with nothing queued, output waits for them
+static unsigned int waiting = 0;
+static unsigned long long window = 0;
+static unsigned long long firstSeen = 0;
+static unsigned long long newestSeen = 0;
+static unsigned long long lastHandedOn = 0;
+static EntryHandler entryHandler = NULL;
+static void* handlerContext = NULL;
+
+void mergeConfigure(unsigned int windowMilliseconds, EntryHandler handler, void* context)
+{
+    window = windowMilliseconds;
+    entryHandler = handler;
+    handlerContext = context;
+}
+
+int mergeAddSource(const char* name)
+{
+    if (sourceCount >= MAX_MERGE_SOURCES)
+    {
+        return -1;
+    }
+
+    struct MergeSource* source = &sources[sourceCount];
+    memset(source, 0, sizeof(struct MergeSource));
+    source->name = name;
+    waiting++;
+
+    return (int)sourceCount++;
+}
+
+int isMergeEnabled(void)
+{
+    return sourceCount > 1;
+}
+
+static unsigned long long headTime(int id)
+{
+    const struct MergeSource* source = &sources[id];
+
+    return source->entries[source->head].timestamp;
+}
+
+//equal times keep the order the sources were added in
+static int isBefore(int a, int b)
+{
+    unsigned long long timeA = headTime(a);
+    unsigned long long timeB = headTime(b);
+
+    return timeA < timeB || (timeA == timeB && a < b);
+}
+
+static void siftUp(unsigned int position)
+{
+    while (position > 0)
+    {
+        unsigned int parent = (position - 1) / 2;
+        if (!isBefore(heap[position], heap[parent]))
+        {
+            break;
+        }
+
+        int id = heap[parent];
+        heap[parent] = heap[position];
+        heap[position] = id;
+        position = parent;
+    }
+}
+
+static void siftDown(unsigned int position)
+{
+    for (;;)
+    {
+        unsigned int smallest = position;
+        unsigned int left = position * 2 + 1;
+        unsigned int right = left + 1;
+
+        if (left < heapSize && isBefore(heap[left], heap[smallest]))
+        {
+            smallest = left;
+        }
+        if (right < heapSize && isBefore(heap[right], heap[smallest]))
+        {
+            smallest = right;
+        }
+        if (smallest == position)
+        {
+            break;
+        }
+
+        int id = heap[smallest];
+        heap[smallest] = heap[position];
+        heap[position] = id;
+        position = smallest;
+    }
+}
+
+static void handOnOldest(void)
+{
+    int id = heap[0];
+    struct MergeSource* source = &sources[id];
+    struct AuditEntry* entry = &source->entries[source->head];
+
+    source->head = (source->head + 1) % SOURCE_CAPACITY;
+    source->count--;
+
+    if (source->count > 0)
+    {
+        siftDown(0);
+    }
+    else
+    {
+        heap[0] = heap[--heapSize];
+        siftDown(0);
+        if (!source->done)
+        {
+            waiting++;
+        }
+    }
+
+    if (entry->timestamp < lastHandedOn)
+    {
+        source->late++;
+    }
+    else
+    {
+        lastHandedOn = entry->timestamp;
+    }
+
+    //the slot is only reused by a later push, after the handler returned
+    entryHandler(entry, handlerContext);
+}
+
+//without a clock only entries that no source can still precede are handed on
+static void handOnReady(unsigned long long now)
+{
+    while (heapSize > 0)
+    {
+        if (waiting > 0 && headTime(heap[0]) + window > now)
+        {
+            break;
+        }
+
+        handOnOldest();
+    }
+}
+
+void mergePush(int id, const struct AuditEntry* entry)
+{
+    struct MergeSource* source = &sources[id];
+
+    if (NULL == source->entries)
+    {
+        source->entries = (struct AuditEntry*)malloc(SOURCE_CAPACITY * sizeof(struct AuditEntry));
+        if (NULL == source->entries)
+        {
+            source->late++;
+            entryHandler((struct AuditEntry*)entry, handlerContext);
+            return;
+        }
+    }
+
+    //a full queue gives up waiting for the other sources
+    while (source->count == SOURCE_CAPACITY)
+    {
+        handOnOldest();
+    }
+
+    memcpy(&source->entries[(source->head + source->count) % SOURCE_CAPACITY], entry, sizeof(struct AuditEntry));
+    if (source->count++ == 0)
+    {
+        heap[heapSize++] = id;
+        siftUp(heapSize - 1);
+        if (!source->done)
+        {
+            waiting--;
+        }
+    }
+
+    if (entry->timestamp > source->newest)
+    {
+        //the lag peaks right before the source catches up
+        if (source->newest > 0 && newestSeen - source->newest > source->maxLag)
+        {
+            source->maxLag = newestSeen - source->newest;
+        }
+        source->newest = entry->timestamp;
+    }
+
+    if (entry->timestamp > newestSeen)
+    {
+        newestSeen = entry->timestamp;
+    }
+    if (firstSeen == 0 || entry->timestamp < firstSeen)
+    {
+        firstSeen = entry->timestamp;
+    }
+
+    handOnReady(0);
+}
+
+void mergeSourceDone(int id)
+{
+    struct MergeSource* source = &sources[id];
+
+    if (source->done)
+    {
+        return;
+    }
+
+    source->done = 1;
+    if (source->count == 0)
+    {
+        waiting--;
+    }
+
+    handOnReady(0);
+}
+
+void mergeAdvance(unsigned long long now)
+{
+    handOnReady(now);
+}
+
+void mergeFinish(void)
+{
+    while (heapSize > 0)
+    {
+        handOnOldest();
+    }
+
+    for (unsigned int i = 0; i < sourceCount; ++i)
+    {
+        free(sources[i].entries);
+        sources[i].entries = NULL;
+    }
+}
+
+unsigned int getMergeQueued(int id)
+{
+    return sources[id].count;
+}
+
+int getMergeOldestPosition(int id, unsigned long long* position)
+{
+    const struct MergeSource* source = &sources[id];
+
+    if (source->count == 0)
+    {
+        return 0;
+    }
+
+    *position = source->entries[source->head].position;
+    return 1;
+}
+
+unsigned int getMergeSourceCount(void)
+{
+    return sourceCount;
+}
+
+const char* getMergeSourceName(int id)
+{
+    return sources[id].name;
+}
+
+unsigned long long getMergeLag(int id)
+{
+    const struct MergeSource* source = &sources[id];
+
+    if (source->done)
+    {
+        return 0;
+    }
+
+    //a source that has not sent anything yet is behind since the start
+    return newestSeen - (source->newest > 0 ? source->newest : firstSeen);
+}
+
+unsigned long long getMergeMaxLag(int id)
+{
+    unsigned long long lag = getMergeLag(id);
+
+    return lag > sources[id].maxLag ? lag : sources[id].maxLag;
+}
+
+unsigned long long getMergeLate(int id)
+{
+    return sources[id].late;
+}
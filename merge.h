@@ -0,0 +1,49 @@
+#ifndef MERGE_H
+#define MERGE_H
+
+#include "entry.h"
+
+/*
+ * Interleaves the entries of several sources (trail files, the audit pipe
+ * or a feed, fanotify) into one stream ordered by record time. Each source
+ * has its own bounded queue and a heap picks the oldest head. An entry
+ * waits while another source has nothing queued, but once the clock passed
+ * its time by the reorder window it is handed on, so a quiet or stalled
+ * source cannot hold up output. Entries arriving after newer ones were
+ * already handed on are passed through and counted as late.
+ */
+
+#define MAX_MERGE_SOURCES 16
+
+void mergeConfigure(unsigned int windowMilliseconds, EntryHandler handler, void* context);
+
+//returns the source id, -1 if there are too many sources
+int mergeAddSource(const char* name);
+
+//more than one source added
+int isMergeEnabled(void);
+
+void mergePush(int source, const struct AuditEntry* entry);
+
+//the source has ended and no longer holds up the others
+void mergeSourceDone(int source);
+
+//hands on entries older than now - window, now in milliseconds since the epoch,
+//trails need no clock as a source with nothing queued can be read on demand
+void mergeAdvance(unsigned long long now);
+
+//hands on everything queued
+void mergeFinish(void);
+
+unsigned int getMergeQueued(int source);
+//trail position of the source's oldest queued entry, returns 0 if none is queued
+int getMergeOldestPosition(int source, unsigned long long* position);
+unsigned int getMergeSourceCount(void);
+const char* getMergeSourceName(int source);
+
+//how far the source's newest entry is behind the newest of all sources
+unsigned long long getMergeLag(int source);
+unsigned long long getMergeMaxLag(int source);
+unsigned long long getMergeLate(int source);
+
+#endif //MERGE_H
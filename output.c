@@ -0,0 +1,186 @@
+#include "output.h"
+
+#include <errno.h>
+#include <stdarg.h>
+#include <string.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "uring.h"
+
+#define OUTPUT_BUFFER_SIZE (256 * 1024)
+#define OUTPUT_BUFFER_COUNT 2
+
+struct OutputBuffer
+{
+    char data[OUTPUT_BUFFER_SIZE];
+    size_t used;
+    size_t written;
+    int inFlight;
+    struct UringRequest request;
+};
+
+static int outputFd = 1;
+static struct Uring* outputRing = NULL;
+static struct OutputBuffer buffers[OUTPUT_BUFFER_COUNT];
+static int current = 0;
+static unsigned long long writeCalls = 0;
+
+static void queueWrite(struct OutputBuffer* buffer);
+
+static void onWritten(void* context, int tag, int result)
+{
+    struct OutputBuffer* buffer = (struct OutputBuffer*)context;
+    (void)tag;
+
+    buffer->inFlight = 0;
+
+    if (result < 0)
+    {
+        //nothing sensible to do with a broken output, drop the buffer
+        buffer->used = 0;
+        buffer->written = 0;
+        return;
+    }
+
+    buffer->written += result;
+    if (buffer->written < buffer->used)
+    {
+        queueWrite(buffer);
+        return;
+    }
+
+    buffer->used = 0;
+    buffer->written = 0;
+}
+
+static void queueWrite(struct OutputBuffer* buffer)
+{
+    //-1 writes at the current file position like write() does
+    if (uringQueueWrite(outputRing, outputFd, buffer->data + buffer->written, buffer->used - buffer->written, -1, &buffer->request) == 0)
+    {
+        buffer->inFlight = 1;
+        uringSubmitAndWait(outputRing, 0);
+    }
+    else
+    {
+        buffer->used = 0;
+        buffer->written = 0;
+    }
+}
+
+static void writeBuffer(struct OutputBuffer* buffer)
+{
+    while (buffer->written < buffer->used)
+    {
+        writeCalls++;
+        ssize_t n = write(outputFd, buffer->data + buffer->written, buffer->used - buffer->written);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            break;
+        }
+        buffer->written += n;
+    }
+
+    buffer->used = 0;
+    buffer->written = 0;
+}
+
+static void waitForBuffer(struct OutputBuffer* buffer)
+{
+    while (buffer->inFlight && uringSubmitAndWait(outputRing, 1) >= 0)
+    {
+    }
+}
+
+void outputInit(int fd, struct Uring* ring)
+{
+    //startup messages went through stdio
+    fflush(stdout);
+
+    outputFd = fd;
+    outputRing = ring;
+
+    for (int i = 0; i < OUTPUT_BUFFER_COUNT; ++i)
+    {
+        buffers[i].used = 0;
+        buffers[i].written = 0;
+        buffers[i].inFlight = 0;
+        buffers[i].request.callback = onWritten;
+        buffers[i].request.context = &buffers[i];
+        buffers[i].request.tag = i;
+    }
+}
+
+void outputFlush(void)
+{
+    struct OutputBuffer* buffer = &buffers[current];
+
+    if (buffer->used == 0)
+    {
+        return;
+    }
+
+    if (NULL == outputRing)
+    {
+        writeBuffer(buffer);
+        return;
+    }
+
+    queueWrite(buffer);
+
+    //keep filling the other buffer while this one is written
+    current = (current + 1) % OUTPUT_BUFFER_COUNT;
+    waitForBuffer(&buffers[current]);
+}
+
+void outputPrintf(const char* format, ...)
+{
+    struct OutputBuffer* buffer = &buffers[current];
+    va_list args;
+
+    for (int attempt = 0; attempt < 2; ++attempt)
+    {
+        size_t space = OUTPUT_BUFFER_SIZE - buffer->used;
+
+        va_start(args, format);
+        int length = vsnprintf(buffer->data + buffer->used, space, format, args);
+        va_end(args);
+
+        if (length < 0)
+        {
+            return;
+        }
+        if ((size_t)length < space)
+        {
+            buffer->used += length;
+            return;
+        }
+
+        //does not fit, flush and retry once in an empty buffer
+        outputFlush();
+        buffer = &buffers[current];
+    }
+}
+
+void outputFinish(void)
+{
+    outputFlush();
+
+    if (NULL != outputRing)
+    {
+        for (int i = 0; i < OUTPUT_BUFFER_COUNT; ++i)
+        {
+            waitForBuffer(&buffers[i]);
+        }
+    }
+}
+
+unsigned long long outputWriteCalls(void)
+{
+    return writeCalls;
+}
@@ -0,0 +1,23 @@
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+/*
+ * Event output is formatted into large buffers that are written with one
+ * system call each, asynchronously through io_uring when a ring is given.
+ * One buffer is filled while the other one is being written.
+ */
+
+struct Uring;
+
+void outputInit(int fd, struct Uring* ring);
+void outputPrintf(const char* format, ...) __attribute__((format(printf, 1, 2)));
+
+//hands the buffered output to the kernel
+void outputFlush(void);
+
+//flushes and waits until everything is written
+void outputFinish(void);
+
+unsigned long long outputWriteCalls(void);
+
+#endif //OUTPUT_H
@@ -0,0 +1,186 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "pathmatch.h"
+
+/*
+ * Compares the combined DFA with the loop it replaced, one strstr() per
+ * filter, for 1 to 16 plain substring filters. Paths are generated with
+ * lengths spread like those of a busy host, a few of them contain one of
+ * the filters. Both have to agree on every path.
+ */
+
+#define DEFAULT_SEARCHES 10000000
+#define PATH_COUNT 4096
+#define MAX_PATH 320
+
+static const char* filters[] = {
+    "/Documents/", "/.ssh/", "/Library/Preferences/", ".plist", "/tmp/", "id_rsa", "/etc/", ".git/",
+    "/Downloads/", "/Desktop/", ".keychain", "/private/var/db/", "/LaunchAgents/", ".sqlite", "/Mail/", "/cron",
+};
+
+#define FILTER_COUNT (int)(sizeof(filters) / sizeof(filters[0]))
+
+static unsigned long long state = 0x9E3779B97F4A7C15ULL;
+
+//splitmix64, the same paths on every run
+static unsigned long long nextRandom(void)
+{
+    unsigned long long z = (state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+static double nowSeconds(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+//mostly 20 to 80 bytes, with a tail of deep trees up to 300
+static size_t pathLength(void)
+{
+    unsigned long long r = nextRandom() % 100;
+
+    if (r < 70)
+    {
+        return 20 + nextRandom() % 61;
+    }
+    if (r < 95)
+    {
+        return 80 + nextRandom() % 81;
+    }
+    return 160 + nextRandom() % 141;
+}
+
+static void makePath(char* path, size_t length)
+{
+    static const char* roots[] = { "/Users/alice/", "/Users/bob/", "/private/var/", "/System/Library/" };
+    static const char alphabet[] = "abcdefghijklmnopqrstuvwxyz0123456789_-";
+    const char* root = roots[nextRandom() % 4];
+    size_t rootLength = strlen(root);
+
+    memcpy(path, root, rootLength);
+    for (size_t i = rootLength; i < length; ++i)
+    {
+        path[i] = nextRandom() % 9 == 0 && path[i - 1] != '/' ? '/' : alphabet[nextRandom() % (sizeof(alphabet) - 1)];
+    }
+    path[length] = 0;
+
+    //about one path in 20 is one a filter is after
+    if (nextRandom() % 20 == 0)
+    {
+        const char* filter = filters[nextRandom() % FILTER_COUNT];
+        size_t filterLength = strlen(filter);
+        if (filterLength < length)
+        {
+            memcpy(path + length - filterLength, filter, filterLength);
+        }
+    }
+}
+
+static int runFilters(char (*paths)[MAX_PATH], int filterCount, unsigned long long searches)
+{
+    char error[128];
+    struct PathMatcher* matcher = pathMatcherCreate(0);
+
+    for (int i = 0; NULL != matcher && i < filterCount; ++i)
+    {
+        if (pathMatcherAdd(matcher, filters[i], error, sizeof(error)) < 0)
+        {
+            fprintf(stderr, "Could not add filter '%s': %s\n", filters[i], error);
+            return -1;
+        }
+    }
+    if (NULL == matcher)
+    {
+        fprintf(stderr, "out of memory\n");
+        return -1;
+    }
+    pathMatcherCompile(matcher);
+
+    for (int i = 0; i < PATH_COUNT; ++i)
+    {
+        int expected = 0;
+        for (int f = 0; f < filterCount && !expected; ++f)
+        {
+            expected = strstr(paths[i], filters[f]) != NULL;
+        }
+        if (expected != pathMatcherMatch(matcher, paths[i]))
+        {
+            printf("MISMATCH filters:%d path:\"%s\" strstr:%d dfa:%d\n", filterCount, paths[i], expected, !expected);
+            pathMatcherDestroy(matcher);
+            return -1;
+        }
+    }
+
+    unsigned long long found = 0;
+    double start = nowSeconds();
+    for (unsigned long long i = 0; i < searches; ++i)
+    {
+        const char* path = paths[i % PATH_COUNT];
+        for (int f = 0; f < filterCount; ++f)
+        {
+            if (strstr(path, filters[f]) != NULL)
+            {
+                found++;
+                break;
+            }
+        }
+    }
+    double loopSeconds = nowSeconds() - start;
+
+    unsigned long long foundDfa = 0;
+    start = nowSeconds();
+    for (unsigned long long i = 0; i < searches; ++i)
+    {
+        foundDfa += pathMatcherMatch(matcher, paths[i % PATH_COUNT]);
+    }
+    double dfaSeconds = nowSeconds() - start;
+
+    printf("filters:%d searches:%llu hits:%llu strstr_loop_ns:%.1f dfa_ns:%.1f speedup:%.2f%s\n",
+        filterCount, searches, found, loopSeconds * 1e9 / searches, dfaSeconds * 1e9 / searches,
+        dfaSeconds > 0 ? loopSeconds / dfaSeconds : 0.0, found == foundDfa ? "" : " MISMATCH");
+
+    pathMatcherDestroy(matcher);
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    unsigned long long searches = DEFAULT_SEARCHES;
+
+    if (argc > 1 && sscanf(argv[1], "%llu", &searches) <= 0)
+    {
+        printf("Usage:  %s [searches]\n", argv[0]);
+        return 1;
+    }
+
+    char (*paths)[MAX_PATH] = malloc(PATH_COUNT * sizeof(*paths));
+    if (NULL == paths)
+    {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+
+    for (int i = 0; i < PATH_COUNT; ++i)
+    {
+        makePath(paths[i], pathLength());
+    }
+
+    for (int filterCount = 1; filterCount <= FILTER_COUNT; filterCount *= 2)
+    {
+        if (runFilters(paths, filterCount, searches) < 0)
+        {
+            free(paths);
+            return 1;
+        }
+    }
+
+    free(paths);
+    return 0;
+}
@@ -0,0 +1,845 @@
+#include "pathmatch.h"
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "uthash.h"
+
+#define NFA_SET 0
+#define NFA_SPLIT 1
+#define NFA_EPS 2
+#define NFA_MATCH 3         //matches only at the end of the path
+#define NFA_MATCH_PREFIX 4  //matches as soon as it is reached
+
+#define DFA_ACCEPT_END 1
+#define DFA_ACCEPT_NOW 2
+#define DFA_DEAD 4
+
+#define DEFAULT_STATE_LIMIT 4096
+
+struct NfaState
+{
+    int type;
+    int out;
+    int out1;
+    unsigned int set[8];
+};
+
+struct Fragment
+{
+    int start;
+    int end; //NFA_EPS state whose out is patched on concatenation
+};
+
+struct DfaState
+{
+    int index;
+    int flags;
+    int count;
+    int* nfaStates;
+    UT_hash_handle hh;
+};
+
+struct PathMatcher
+{
+    struct NfaState* nfa;
+    int nfaCount;
+    int nfaCapacity;
+
+    int* starts;
+    int startCount;
+
+    unsigned char classMap[256];
+    unsigned char classByte[256];
+    int classCount;
+
+    struct DfaState* stateTable;
+    struct DfaState** states;
+    int* transitions; //rows of classCount next row offsets followed by the state flags
+    int rowWidth;
+    int stateCount;
+    int stateLimit;
+    int start;
+
+    //scratch for closure computation
+    int* marks;
+    int markGeneration;
+    int* stack;
+    int* seeds;
+    int* work;
+};
+
+struct Parser
+{
+    struct PathMatcher* m;
+    const char* p;
+    char* error;
+    size_t errorSize;
+};
+
+static int addNfaState(struct PathMatcher* m, int type)
+{
+    if (m->nfaCount == m->nfaCapacity)
+    {
+        m->nfaCapacity = m->nfaCapacity ? m->nfaCapacity * 2 : 64;
+        m->nfa = (struct NfaState*)realloc(m->nfa, m->nfaCapacity * sizeof(struct NfaState));
+    }
+
+    struct NfaState* s = &m->nfa[m->nfaCount];
+    memset(s, 0, sizeof(struct NfaState));
+    s->type = type;
+    s->out = -1;
+    s->out1 = -1;
+
+    return m->nfaCount++;
+}
+
+static void setAdd(unsigned int* set, unsigned char c)
+{
+    set[c >> 5] |= 1u << (c & 31);
+}
+
+static int setHas(const unsigned int* set, unsigned char c)
+{
+    return (set[c >> 5] >> (c & 31)) & 1;
+}
+
+static struct Fragment fragmentEmpty(struct PathMatcher* m)
+{
+    struct Fragment f;
+    f.start = addNfaState(m, NFA_EPS);
+    f.end = f.start;
+    return f;
+}
+
+static struct Fragment fragmentSet(struct PathMatcher* m, const unsigned int* set)
+{
+    struct Fragment f;
+    f.start = addNfaState(m, NFA_SET);
+    f.end = addNfaState(m, NFA_EPS);
+    memcpy(m->nfa[f.start].set, set, sizeof(m->nfa[f.start].set));
+    m->nfa[f.start].out = f.end;
+    return f;
+}
+
+static struct Fragment fragmentChar(struct PathMatcher* m, unsigned char c)
+{
+    unsigned int set[8];
+    memset(set, 0, sizeof(set));
+    setAdd(set, c);
+    return fragmentSet(m, set);
+}
+
+static struct Fragment fragmentAny(struct PathMatcher* m, int crossSlash)
+{
+    unsigned int set[8];
+    memset(set, 0xFF, sizeof(set));
+    set[0] &= ~1u; //never match the terminator
+    if (!crossSlash)
+    {
+        set['/' >> 5] &= ~(1u << ('/' & 31));
+    }
+    return fragmentSet(m, set);
+}
+
+static struct Fragment fragmentConcat(struct PathMatcher* m, struct Fragment a, struct Fragment b)
+{
+    m->nfa[a.end].out = b.start;
+    a.end = b.end;
+    return a;
+}
+
+static struct Fragment fragmentAlternate(struct PathMatcher* m, struct Fragment a, struct Fragment b)
+{
+    struct Fragment f;
+    f.start = addNfaState(m, NFA_SPLIT);
+    f.end = addNfaState(m, NFA_EPS);
+    m->nfa[f.start].out = a.start;
+    m->nfa[f.start].out1 = b.start;
+    m->nfa[a.end].out = f.end;
+    m->nfa[b.end].out = f.end;
+    return f;
+}
+
+static struct Fragment fragmentRepeat(struct PathMatcher* m, struct Fragment a, char op)
+{
+    struct Fragment f;
+    int split = addNfaState(m, NFA_SPLIT);
+    f.end = addNfaState(m, NFA_EPS);
+    m->nfa[split].out = a.start;
+    m->nfa[split].out1 = f.end;
+
+    switch (op)
+    {
+        case '*':
+        m->nfa[a.end].out = split;
+        f.start = split;
+        break;
+        case '+':
+        m->nfa[a.end].out = split;
+        f.start = a.start;
+        break;
+        default: //'?'
+        m->nfa[a.end].out = f.end;
+        f.start = split;
+        break;
+    }
+
+    return f;
+}
+
+static int parseError(struct Parser* ps, const char* message)
+{
+    snprintf(ps->error, ps->errorSize, "%s", message);
+    return -1;
+}
+
+//parses a bracket expression, ps->p points just after '['
+static int parseClass(struct Parser* ps, unsigned int* set, int isGlob)
+{
+    int negate = 0;
+    int first = 1;
+    memset(set, 0, 8 * sizeof(unsigned int));
+
+    if (*ps->p == '^' || (isGlob && *ps->p == '!'))
+    {
+        negate = 1;
+        ps->p++;
+    }
+
+    while (*ps->p && (first || *ps->p != ']'))
+    {
+        unsigned char low = (unsigned char)*ps->p++;
+        if (low == '\\' && *ps->p)
+        {
+            low = (unsigned char)*ps->p++;
+        }
+
+        unsigned char high = low;
+        if (ps->p[0] == '-' && ps->p[1] && ps->p[1] != ']')
+        {
+            ps->p++;
+            high = (unsigned char)*ps->p++;
+            if (high == '\\' && *ps->p)
+            {
+                high = (unsigned char)*ps->p++;
+            }
+        }
+
+        if (high < low)
+        {
+            return parseError(ps, "invalid range in bracket expression");
+        }
+
+        for (int c = low; c <= high; ++c)
+        {
+            setAdd(set, (unsigned char)c);
+        }
+        first = 0;
+    }
+
+    if (*ps->p != ']')
+    {
+        return parseError(ps, "missing ]");
+    }
+    ps->p++;
+
+    if (negate)
+    {
+        for (int i = 0; i < 8; ++i)
+        {
+            set[i] = ~set[i];
+        }
+        if (isGlob)
+        {
+            set['/' >> 5] &= ~(1u << ('/' & 31));
+        }
+    }
+    set[0] &= ~1u;
+
+    return 0;
+}
+
+static int parseRegexAlternation(struct Parser* ps, struct Fragment* out, int depth);
+
+static int parseRegexAtom(struct Parser* ps, struct Fragment* out, int depth)
+{
+    unsigned int set[8];
+    char c = *ps->p++;
+
+    switch (c)
+    {
+        case '(':
+        if (parseRegexAlternation(ps, out, depth + 1) < 0)
+        {
+            return -1;
+        }
+        if (*ps->p != ')')
+        {
+            return parseError(ps, "missing )");
+        }
+        ps->p++;
+        return 0;
+        case '.':
+        *out = fragmentAny(ps->m, 1);
+        return 0;
+        case '[':
+        if (parseClass(ps, set, 0) < 0)
+        {
+            return -1;
+        }
+        *out = fragmentSet(ps->m, set);
+        return 0;
+        case '\\':
+        if (*ps->p == 0)
+        {
+            return parseError(ps, "trailing backslash");
+        }
+        if (*ps->p >= '0' && *ps->p <= '9')
+        {
+            return parseError(ps, "back references are not supported");
+        }
+        *out = fragmentChar(ps->m, (unsigned char)*ps->p++);
+        return 0;
+        case ')':
+        return parseError(ps, "unmatched )");
+        case '{':
+        return parseError(ps, "counted repetition is not supported");
+        case '^':
+        case '$':
+        return parseError(ps, "anchors are only allowed at the pattern start and end");
+        case '*':
+        case '+':
+        case '?':
+        return parseError(ps, "repetition operator without operand");
+    }
+
+    *out = fragmentChar(ps->m, (unsigned char)c);
+    return 0;
+}
+
+static int atRegexEnd(struct Parser* ps, int depth)
+{
+    return *ps->p == 0 || *ps->p == '|' || (depth > 0 && *ps->p == ')')
+        || (ps->p[0] == '$' && ps->p[1] == 0);
+}
+
+static int parseRegexConcat(struct Parser* ps, struct Fragment* out, int depth)
+{
+    *out = fragmentEmpty(ps->m);
+
+    while (!atRegexEnd(ps, depth))
+    {
+        struct Fragment atom;
+        if (parseRegexAtom(ps, &atom, depth) < 0)
+        {
+            return -1;
+        }
+
+        while (*ps->p == '*' || *ps->p == '+' || *ps->p == '?')
+        {
+            atom = fragmentRepeat(ps->m, atom, *ps->p++);
+        }
+
+        *out = fragmentConcat(ps->m, *out, atom);
+    }
+
+    return 0;
+}
+
+static int parseRegexAlternation(struct Parser* ps, struct Fragment* out, int depth)
+{
+    if (parseRegexConcat(ps, out, depth) < 0)
+    {
+        return -1;
+    }
+
+    while (*ps->p == '|')
+    {
+        ps->p++;
+        struct Fragment right;
+        if (parseRegexConcat(ps, &right, depth) < 0)
+        {
+            return -1;
+        }
+        *out = fragmentAlternate(ps->m, *out, right);
+    }
+
+    return 0;
+}
+
+static int compileRegex(struct Parser* ps, struct Fragment* out)
+{
+    struct PathMatcher* m = ps->m;
+    int matchType = NFA_MATCH_PREFIX;
+    struct Fragment body;
+
+    if (*ps->p == '^')
+    {
+        ps->p++;
+        *out = fragmentEmpty(m);
+    }
+    else
+    {
+        *out = fragmentRepeat(m, fragmentAny(m, 1), '*');
+    }
+
+    if (parseRegexAlternation(ps, &body, 0) < 0)
+    {
+        return -1;
+    }
+
+    if (*ps->p == '$')
+    {
+        ps->p++;
+        matchType = NFA_MATCH;
+    }
+
+    if (*ps->p != 0)
+    {
+        return parseError(ps, "unexpected character");
+    }
+
+    *out = fragmentConcat(m, *out, body);
+    m->nfa[out->end].out = addNfaState(m, matchType);
+
+    return 0;
+}
+
+static int compileGlob(struct Parser* ps, struct Fragment* out)
+{
+    struct PathMatcher* m = ps->m;
+    unsigned int set[8];
+
+    if (strchr(ps->p, '/') == NULL)
+    {
+        //match the last component: (.*/)?glob
+        struct Fragment dirs = fragmentConcat(m, fragmentRepeat(m, fragmentAny(m, 1), '*'), fragmentChar(m, '/'));
+        *out = fragmentRepeat(m, dirs, '?');
+    }
+    else
+    {
+        *out = fragmentEmpty(m);
+    }
+
+    while (*ps->p)
+    {
+        struct Fragment f;
+        char c = *ps->p++;
+
+        switch (c)
+        {
+            case '*':
+            if (*ps->p == '*')
+            {
+                ps->p++;
+                if (*ps->p == '/')
+                {
+                    //"**/" also matches no directory at all
+                    ps->p++;
+                    struct Fragment dirs = fragmentConcat(m, fragmentRepeat(m, fragmentAny(m, 1), '*'), fragmentChar(m, '/'));
+                    f = fragmentRepeat(m, dirs, '?');
+                }
+                else
+                {
+                    f = fragmentRepeat(m, fragmentAny(m, 1), '*');
+                }
+            }
+            else
+            {
+                f = fragmentRepeat(m, fragmentAny(m, 0), '*');
+            }
+            break;
+            case '?':
+            f = fragmentAny(m, 0);
+            break;
+            case '[':
+            if (parseClass(ps, set, 1) < 0)
+            {
+                return -1;
+            }
+            f = fragmentSet(m, set);
+            break;
+            case '\\':
+            if (*ps->p == 0)
+            {
+                return parseError(ps, "trailing backslash");
+            }
+            f = fragmentChar(m, (unsigned char)*ps->p++);
+            break;
+            default:
+            f = fragmentChar(m, (unsigned char)c);
+            break;
+        }
+
+        *out = fragmentConcat(m, *out, f);
+    }
+
+    m->nfa[out->end].out = addNfaState(m, NFA_MATCH);
+
+    return 0;
+}
+
+static void compileLiteral(struct PathMatcher* m, const char* text, struct Fragment* out)
+{
+    *out = fragmentRepeat(m, fragmentAny(m, 1), '*');
+
+    for (const char* p = text; *p; ++p)
+    {
+        *out = fragmentConcat(m, *out, fragmentChar(m, (unsigned char)*p));
+    }
+
+    m->nfa[out->end].out = addNfaState(m, NFA_MATCH_PREFIX);
+}
+
+int pathMatcherIsLiteral(const char* pattern)
+{
+    if (strncmp(pattern, "re:", 3) == 0 || strncmp(pattern, "glob:", 5) == 0)
+    {
+        return 0;
+    }
+
+    return strpbrk(pattern, "*?[") == NULL;
+}
+
+struct PathMatcher* pathMatcherCreate(int stateLimit)
+{
+    struct PathMatcher* m = (struct PathMatcher*)malloc(sizeof(struct PathMatcher));
+    memset(m, 0, sizeof(struct PathMatcher));
+    m->stateLimit = stateLimit > 1 ? stateLimit : DEFAULT_STATE_LIMIT;
+    m->start = -1;
+
+    return m;
+}
+
+int pathMatcherAdd(struct PathMatcher* m, const char* pattern, char* error, size_t errorSize)
+{
+    struct Parser ps;
+    struct Fragment f;
+    int savedCount = m->nfaCount;
+    int result = 0;
+
+    ps.m = m;
+    ps.error = error;
+    ps.errorSize = errorSize;
+
+    if (strncmp(pattern, "re:", 3) == 0)
+    {
+        ps.p = pattern + 3;
+        result = compileRegex(&ps, &f);
+    }
+    else if (strncmp(pattern, "glob:", 5) == 0)
+    {
+        ps.p = pattern + 5;
+        result = compileGlob(&ps, &f);
+    }
+    else if (!pathMatcherIsLiteral(pattern))
+    {
+        ps.p = pattern;
+        result = compileGlob(&ps, &f);
+    }
+    else
+    {
+        compileLiteral(m, pattern, &f);
+    }
+
+    if (result < 0)
+    {
+        m->nfaCount = savedCount;
+        return -1;
+    }
+
+    m->starts = (int*)realloc(m->starts, (m->startCount + 1) * sizeof(int));
+    m->starts[m->startCount++] = f.start;
+
+    return 0;
+}
+
+static void computeByteClasses(struct PathMatcher* m)
+{
+    int remap[256][2];
+
+    memset(m->classMap, 0, sizeof(m->classMap));
+    m->classCount = 1;
+
+    for (int i = 0; i < m->nfaCount; ++i)
+    {
+        if (m->nfa[i].type != NFA_SET)
+        {
+            continue;
+        }
+
+        int count = 0;
+        memset(remap, 0xFF, sizeof(remap));
+        for (int c = 0; c < 256; ++c)
+        {
+            int in = setHas(m->nfa[i].set, (unsigned char)c);
+            int* target = &remap[m->classMap[c]][in];
+            if (*target < 0)
+            {
+                *target = count++;
+            }
+            m->classMap[c] = (unsigned char)*target;
+        }
+        m->classCount = count;
+    }
+
+    for (int c = 255; c >= 0; --c)
+    {
+        m->classByte[m->classMap[c]] = (unsigned char)c;
+    }
+}
+
+static int compareInt(const void* a, const void* b)
+{
+    int x = *(const int*)a;
+    int y = *(const int*)b;
+    return (x > y) - (x < y);
+}
+
+//epsilon closure of seeds into m->work, returns the number of states
+static int closure(struct PathMatcher* m, const int* seeds, int seedCount)
+{
+    int count = 0;
+    int top = 0;
+
+    m->markGeneration++;
+    for (int i = 0; i < seedCount; ++i)
+    {
+        m->stack[top++] = seeds[i];
+    }
+
+    while (top > 0)
+    {
+        int s = m->stack[--top];
+        if (s < 0 || m->marks[s] == m->markGeneration)
+        {
+            continue;
+        }
+        m->marks[s] = m->markGeneration;
+
+        switch (m->nfa[s].type)
+        {
+            case NFA_SPLIT:
+            m->stack[top++] = m->nfa[s].out1;
+            m->stack[top++] = m->nfa[s].out;
+            break;
+            case NFA_EPS:
+            m->stack[top++] = m->nfa[s].out;
+            break;
+            default:
+            m->work[count++] = s;
+            break;
+        }
+    }
+
+    qsort(m->work, count, sizeof(int), compareInt);
+
+    return count;
+}
+
+static void resetStates(struct PathMatcher* m)
+{
+    struct DfaState *s = NULL;
+    struct DfaState *tmp = NULL;
+
+    HASH_ITER(hh, m->stateTable, s, tmp)
+    {
+        HASH_DEL(m->stateTable, s);
+        free(s->nfaStates);
+        free(s);
+    }
+
+    m->stateCount = 0;
+    m->start = -1;
+}
+
+//finds or adds the DFA state for the closure stored in m->work
+static int internState(struct PathMatcher* m, int count)
+{
+    struct DfaState *s = NULL;
+
+    HASH_FIND(hh, m->stateTable, m->work, count * sizeof(int), s);
+    if (NULL != s)
+    {
+        return s->index;
+    }
+
+    if (m->stateCount == m->stateLimit)
+    {
+        return -1;
+    }
+
+    s = (struct DfaState*)malloc(sizeof(struct DfaState));
+    memset(s, 0, sizeof(struct DfaState));
+    s->index = m->stateCount++;
+    s->count = count;
+    s->nfaStates = (int*)malloc((count ? count : 1) * sizeof(int));
+    memcpy(s->nfaStates, m->work, count * sizeof(int));
+
+    if (count == 0)
+    {
+        s->flags |= DFA_DEAD;
+    }
+    for (int i = 0; i < count; ++i)
+    {
+        if (m->nfa[s->nfaStates[i]].type == NFA_MATCH)
+        {
+            s->flags |= DFA_ACCEPT_END;
+        }
+        else if (m->nfa[s->nfaStates[i]].type == NFA_MATCH_PREFIX)
+        {
+            s->flags |= DFA_ACCEPT_NOW;
+        }
+    }
+
+    HASH_ADD_KEYPTR(hh, m->stateTable, s->nfaStates, count * sizeof(int), s);
+    m->states[s->index] = s;
+    for (int i = 0; i < m->classCount; ++i)
+    {
+        m->transitions[s->index * m->rowWidth + i] = -1;
+    }
+    m->transitions[s->index * m->rowWidth + m->classCount] = s->flags;
+
+    return s->index;
+}
+
+static int startState(struct PathMatcher* m)
+{
+    return internState(m, closure(m, m->starts, m->startCount));
+}
+
+//moves the NFA states of from over byte class cls into m->work
+static int step(struct PathMatcher* m, const struct DfaState* from, int cls)
+{
+    unsigned char c = m->classByte[cls];
+    int seedCount = 0;
+    int* seeds = m->seeds;
+
+    for (int i = 0; i < from->count; ++i)
+    {
+        const struct NfaState* n = &m->nfa[from->nfaStates[i]];
+        if (n->type == NFA_SET && setHas(n->set, c))
+        {
+            seeds[seedCount++] = n->out;
+        }
+    }
+
+    return closure(m, seeds, seedCount);
+}
+
+static int computeTransition(struct PathMatcher* m, int state, int cls)
+{
+    int count = step(m, m->states[state], cls);
+    int next = internState(m, count);
+
+    if (next < 0)
+    {
+        //cache is full: start over, keeping only the states in use right now
+        int* saved = (int*)malloc((count ? count : 1) * sizeof(int));
+        memcpy(saved, m->work, count * sizeof(int));
+
+        resetStates(m);
+        m->start = startState(m);
+
+        memcpy(m->work, saved, count * sizeof(int));
+        free(saved);
+
+        return internState(m, count);
+    }
+
+    m->transitions[state * m->rowWidth + cls] = next * m->rowWidth;
+
+    return next;
+}
+
+void pathMatcherCompile(struct PathMatcher* m)
+{
+    resetStates(m);
+    computeByteClasses(m);
+
+    free(m->states);
+    free(m->transitions);
+    free(m->marks);
+    free(m->stack);
+    free(m->seeds);
+    free(m->work);
+
+    m->states = (struct DfaState**)malloc(m->stateLimit * sizeof(struct DfaState*));
+    m->rowWidth = m->classCount + 1;
+    m->transitions = (int*)malloc((size_t)m->stateLimit * m->rowWidth * sizeof(int));
+    m->marks = (int*)calloc(m->nfaCount + 1, sizeof(int));
+    m->stack = (int*)malloc((m->nfaCount * 3 + 1) * sizeof(int));
+    m->seeds = (int*)malloc((m->nfaCount + 1) * sizeof(int));
+    m->work = (int*)malloc((m->nfaCount + 1) * sizeof(int));
+    m->markGeneration = 0;
+
+    m->start = startState(m);
+
+    //build ahead of time in breadth first order until the cap is reached
+    for (int s = 0; s < m->stateCount && m->stateCount < m->stateLimit; ++s)
+    {
+        for (int cls = 0; cls < m->classCount && m->stateCount < m->stateLimit; ++cls)
+        {
+            if (m->transitions[s * m->rowWidth + cls] < 0)
+            {
+                int next = internState(m, step(m, m->states[s], cls));
+                if (next >= 0)
+                {
+                    m->transitions[s * m->rowWidth + cls] = next * m->rowWidth;
+                }
+            }
+        }
+    }
+}
+
+int pathMatcherMatch(struct PathMatcher* m, const char* path)
+{
+    if (m->start < 0)
+    {
+        return 0;
+    }
+
+    //row offsets instead of state indexes keep the multiply out of the loop
+    const int* row = m->transitions + m->start * m->rowWidth;
+    int classCount = m->classCount;
+
+    for (const unsigned char* p = (const unsigned char*)path; *p; ++p)
+    {
+        int flags = row[classCount];
+        if (flags & (DFA_ACCEPT_NOW | DFA_DEAD))
+        {
+            return (flags & DFA_ACCEPT_NOW) != 0;
+        }
+
+        int cls = m->classMap[*p];
+        int next = row[cls];
+        if (next < 0)
+        {
+            next = computeTransition(m, (int)(row - m->transitions) / m->rowWidth, cls) * m->rowWidth;
+        }
+        row = m->transitions + next;
+    }
+
+    return (row[classCount] & (DFA_ACCEPT_NOW | DFA_ACCEPT_END)) != 0;
+}
+
+void pathMatcherDestroy(struct PathMatcher* m)
+{
+    if (NULL == m)
+    {
+        return;
+    }
+
+    resetStates(m);
+    free(m->states);
+    free(m->transitions);
+    free(m->marks);
+    free(m->stack);
+    free(m->seeds);
+    free(m->work);
+    free(m->starts);
+    free(m->nfa);
+    free(m);
+}
@@ -0,0 +1,33 @@
+#ifndef PATHMATCH_H
+#define PATHMATCH_H
+
+#include <stddef.h>
+
+/*
+ * Path patterns are compiled into one combined DFA so that a path is tested
+ * against every loaded pattern in a single pass without backtracking.
+ *
+ * Pattern syntax:
+ *   re:<regex>    regex subset: literals . [] * + ? | () and ^ $ at the ends
+ *   glob:<glob>   glob: * ? [] and ** which also crosses '/'
+ *   <text>        glob if it contains * ? or [, otherwise a plain substring
+ *
+ * A glob without any '/' is matched against the last path component only.
+ */
+
+struct PathMatcher;
+
+struct PathMatcher* pathMatcherCreate(int stateLimit);
+void pathMatcherDestroy(struct PathMatcher* m);
+
+//returns 0 on success, -1 on a syntax error described in error
+int pathMatcherAdd(struct PathMatcher* m, const char* pattern, char* error, size_t errorSize);
+
+//builds the DFA ahead of time up to the state limit, the rest is built lazily
+void pathMatcherCompile(struct PathMatcher* m);
+
+int pathMatcherMatch(struct PathMatcher* m, const char* path);
+
+int pathMatcherIsLiteral(const char* pattern);
+
+#endif //PATHMATCH_H
@@ -0,0 +1,515 @@
+#include "process.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "strsearch.h"
+#include "inttable.h"
+#include "filter.h"
+
+//ancestors are only resolved this deep when a process is first seen
+#define MAX_LINEAGE_DEPTH 64
+#define INITIAL_PRUNE_THRESHOLD 4096
+
+//pid to ProcessInfo, per thread so that each shard worker owns the entries of its own pids
+static _Thread_local struct IntTable *processes = NULL;
+static _Thread_local unsigned int pruneThreshold = INITIAL_PRUNE_THRESHOLD;
+
+static int treeEnabled = 0;
+static int treeRootPid = 0;
+static char treeRootName[PROC_PIDPATHINFO_MAXSIZE];
+static int attribution = 0;
+static char filterCgroup[CGROUP_SIZE];
+static size_t filterCgroupLength = 0;
+
+void setProcessTreeRoot(int pid, const char* name)
+{
+    treeEnabled = 1;
+    treeRootPid = pid;
+    memset(treeRootName, 0, sizeof(treeRootName));
+    if (name)
+    {
+        strncpy(treeRootName, name, sizeof(treeRootName) - 1);
+    }
+}
+
+int isProcessTreeEnabled(void)
+{
+    return treeEnabled;
+}
+
+void setCgroupAttribution(const char* filter)
+{
+    attribution = 1;
+    memset(filterCgroup, 0, sizeof(filterCgroup));
+    if (filter)
+    {
+        strncpy(filterCgroup, filter, sizeof(filterCgroup) - 1);
+    }
+    filterCgroupLength = strlen(filterCgroup);
+}
+
+int isCgroupAttributionEnabled(void)
+{
+    return attribution;
+}
+
+static void resolveAttribution(struct ProcessInfo* p)
+{
+    if (attribution)
+    {
+        resolveCgroup(p->pid, p->cgroup, sizeof(p->cgroup), p->container, sizeof(p->container));
+    }
+}
+
+static int computeSelected(const struct ProcessInfo* p, const struct FilterSet* filters)
+{
+    if (filters->pid > 0 && filters->pid != p->pid)
+    {
+        return 0;
+    }
+
+    if (filters->processNameLength > 0
+        && findSubstring(p->processPath, strlen(p->processPath), filters->processName, filters->processNameLength) == NULL)
+    {
+        return 0;
+    }
+
+    if (filterCgroupLength > 0
+        && findSubstring(p->cgroup, strlen(p->cgroup), filterCgroup, filterCgroupLength) == NULL
+        && findSubstring(p->container, strlen(p->container), filterCgroup, filterCgroupLength) == NULL)
+    {
+        return 0;
+    }
+
+    return !treeEnabled || p->inTree;
+}
+
+static void updateSelected(struct ProcessInfo* p)
+{
+    const struct FilterSet* filters = filterCurrent();
+
+    p->selected = computeSelected(p, filters);
+    p->filterGeneration = filters->generation;
+}
+
+int isProcessSelected(int pid)
+{
+    const struct FilterSet* filters = filterCurrent();
+    struct ProcessInfo *p = findProcess(pid);
+
+    if (NULL != p)
+    {
+        if (p->filterGeneration != filters->generation)
+        {
+            updateSelected(p);
+        }
+        return p->selected;
+    }
+
+    //unknown, so only a pid filter can tell
+    return filters->processNameLength == 0 && filterCgroupLength == 0 && !treeEnabled && (filters->pid <= 0 || filters->pid == pid);
+}
+
+static int isTreeRoot(const struct ProcessInfo* p)
+{
+    if (treeRootPid > 0)
+    {
+        return p->pid == treeRootPid;
+    }
+
+    return treeRootName[0] != 0 && strstr(p->processPath, treeRootName) != NULL;
+}
+
+#ifdef __APPLE__
+
+static int readProcessPath(int pid, char* path, size_t size)
+{
+    return proc_pidpath(pid, path, (uint32_t)size);
+}
+
+static int lookupParentPid(int pid)
+{
+    struct proc_bsdinfo info;
+    memset(&info, 0, sizeof(info));
+
+    if (proc_pidinfo(pid, PROC_PIDTBSDINFO, 0, &info, sizeof(info)) != sizeof(info))
+    {
+        return 0;
+    }
+
+    return (int)info.pbi_ppid;
+}
+
+#elif defined(__linux__)
+
+static int readProcessPath(int pid, char* path, size_t size)
+{
+    char link[64];
+
+    snprintf(link, sizeof(link), "/proc/%d/exe", pid);
+    ssize_t n = readlink(link, path, size - 1);
+    path[n > 0 ? n : 0] = 0;
+
+    return n > 0 ? (int)n : 0;
+}
+
+static int lookupParentPid(int pid)
+{
+    char path[64];
+    char line[512];
+    int parentPid = 0;
+
+    snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        return 0;
+    }
+    ssize_t n = read(fd, line, sizeof(line) - 1);
+    close(fd);
+    line[n > 0 ? n : 0] = 0;
+
+    //pid (name) state ppid, the name may hold spaces and parentheses
+    const char* end = strrchr(line, ')');
+    if (NULL == end || sscanf(end + 1, " %*c %d", &parentPid) != 1)
+    {
+        return 0;
+    }
+
+    return parentPid;
+}
+
+#else
+
+static int readProcessPath(int pid, char* path, size_t size)
+{
+    (void)pid; (void)size;
+    path[0] = 0;
+
+    return 0;
+}
+
+static int lookupParentPid(int pid)
+{
+    (void)pid;
+
+    return 0;
+}
+
+#endif
+
+static int keepRunning(int pid, void* value, void* context)
+{
+    (void)context;
+
+    if (kill(pid, 0) < 0 && errno == ESRCH)
+    {
+        free(value);
+        return 0;
+    }
+
+    return 1;
+}
+
+//drops entries of processes whose exit record we never saw
+void pruneExitedProcesses(void)
+{
+    if (NULL == processes)
+    {
+        return;
+    }
+
+    intTableRemoveIf(processes, keepRunning, NULL);
+
+    unsigned int count = intTableCount(processes);
+    pruneThreshold = count * 2 > INITIAL_PRUNE_THRESHOLD ? count * 2 : INITIAL_PRUNE_THRESHOLD;
+}
+
+static struct ProcessInfo* addProcess(int pid, int parentPid, const char* path, int depth)
+{
+    struct ProcessInfo *p = NULL;
+    struct ProcessInfo *parent = NULL;
+
+    if (NULL == processes)
+    {
+        processes = intTableCreate(INITIAL_PRUNE_THRESHOLD);
+        if (NULL == processes)
+        {
+            return NULL;
+        }
+    }
+
+    if (intTableCount(processes) >= pruneThreshold)
+    {
+        pruneExitedProcesses();
+    }
+
+    p = (struct ProcessInfo*)malloc(sizeof(struct ProcessInfo));
+    if (NULL == p)
+    {
+        return NULL;
+    }
+    memset(p, 0, sizeof(struct ProcessInfo));
+    p->pid = pid;
+    p->parentPid = parentPid;
+    if (NULL != path && path[0] != 0)
+    {
+        strncpy(p->processPath, path, sizeof(p->processPath) - 1);
+    }
+    else
+    {
+        readProcessPath(pid, p->processPath, sizeof(p->processPath));
+    }
+    p->stale = p->processPath[0] == 0;
+    resolveAttribution(p);
+    if (intTableInsert(processes, pid, p) < 0)
+    {
+        free(p);
+        return NULL;
+    }
+
+    if (treeEnabled)
+    {
+        if (parentPid <= 0 && depth < MAX_LINEAGE_DEPTH)
+        {
+            p->parentPid = lookupParentPid(pid);
+        }
+
+        //resolve the lineage once here so events never walk parents, a
+        //record naming its process may be replayed long after the parent is gone
+        if (p->parentPid > 0 && p->parentPid != pid)
+        {
+            parent = findProcess(p->parentPid);
+            if (NULL == parent && (NULL == path || path[0] == 0) && depth < MAX_LINEAGE_DEPTH)
+            {
+                parent = addProcess(p->parentPid, 0, NULL, depth + 1);
+            }
+        }
+
+        p->inTree = (NULL != parent && parent->inTree) || isTreeRoot(p);
+    }
+
+    updateSelected(p);
+    return p;
+}
+
+unsigned int getProcessCount(void)
+{
+    return intTableCount(processes);
+}
+
+struct ProcessInfo* findProcess(int pid)
+{
+    if (NULL == processes)
+    {
+        return NULL;
+    }
+
+    return (struct ProcessInfo*)intTableFind(processes, pid);
+}
+
+//the path only changes on exec, so known processes cost a hash lookup
+struct ProcessInfo* updateProcess(int pid, int parentPid, const char* path)
+{
+    struct ProcessInfo *p = findProcess(pid);
+
+    if (NULL == p)
+    {
+        return addProcess(pid, parentPid, path, 0);
+    }
+
+    //a record naming its process wins over a path inherited on fork
+    if (NULL != path && path[0] != 0 && strcmp(p->processPath, path) != 0)
+    {
+        p->stale = 1;
+    }
+
+    if (!p->stale)
+    {
+        //the filters were reloaded since the verdict was cached
+        if (p->filterGeneration != filterCurrent()->generation)
+        {
+            updateSelected(p);
+        }
+        return p;
+    }
+
+    char processPath[PROC_PIDPATHINFO_MAXSIZE];
+    memset(processPath, 0, sizeof(processPath));
+    if (NULL != path && path[0] != 0)
+    {
+        strncpy(p->processPath, path, sizeof(p->processPath) - 1);
+        p->stale = 0;
+    }
+    else if (readProcessPath(pid, processPath, sizeof(processPath)) > 0)
+    {
+        strcpy(p->processPath, processPath);
+        p->stale = 0;
+    }
+
+    //a new image may have been started in another cgroup
+    resolveAttribution(p);
+
+    //an exec may turn the process into a root
+    if (treeEnabled && !p->inTree)
+    {
+        p->inTree = isTreeRoot(p);
+    }
+
+    updateSelected(p);
+    return p;
+}
+
+const char* getProcessName(int pid)
+{
+    struct ProcessInfo *p = findProcess(pid);
+
+    if (NULL != p && p->processPath[0] != 0)
+    {
+        return p->processPath;
+    }
+
+    return "?";
+}
+
+struct ProcessVisitor
+{
+    ProcessVisit visit;
+    void* context;
+};
+
+static int visitProcess(int pid, void* value, void* context)
+{
+    (void)pid;
+
+    struct ProcessVisitor* visitor = (struct ProcessVisitor*)context;
+    return visitor->visit((const struct ProcessInfo*)value, visitor->context);
+}
+
+void forEachProcess(ProcessVisit visit, void* context)
+{
+    struct ProcessVisitor visitor = { visit, context };
+
+    if (NULL != processes)
+    {
+        intTableForEach(processes, visitProcess, &visitor);
+    }
+}
+
+int restoreProcess(int pid, int parentPid, const char* path, const char* cgroup, const char* container)
+{
+    if (NULL == processes)
+    {
+        processes = intTableCreate(INITIAL_PRUNE_THRESHOLD);
+        if (NULL == processes)
+        {
+            return -1;
+        }
+    }
+
+    struct ProcessInfo *p = (struct ProcessInfo*)malloc(sizeof(struct ProcessInfo));
+    if (NULL == p)
+    {
+        return -1;
+    }
+
+    memset(p, 0, sizeof(struct ProcessInfo));
+    p->pid = pid;
+    p->parentPid = parentPid;
+    strncpy(p->processPath, path, sizeof(p->processPath) - 1);
+    strncpy(p->cgroup, cgroup, sizeof(p->cgroup) - 1);
+    strncpy(p->container, container, sizeof(p->container) - 1);
+    //the pid may belong to another image by now, the saved path stays if it has exited
+    p->stale = 1;
+
+    free(intTableRemove(processes, pid));
+    if (intTableInsert(processes, pid, p) < 0)
+    {
+        free(p);
+        return -1;
+    }
+
+    return 0;
+}
+
+//the filters may differ from the run that saved the processes
+static int restoredInTree(struct ProcessInfo* p)
+{
+    for (int depth = 0; NULL != p && depth < MAX_LINEAGE_DEPTH; ++depth)
+    {
+        if (isTreeRoot(p))
+        {
+            return 1;
+        }
+        p = p->parentPid > 0 && p->parentPid != p->pid ? findProcess(p->parentPid) : NULL;
+    }
+
+    return 0;
+}
+
+static int finishRestore(int pid, void* value, void* context)
+{
+    (void)pid; (void)context;
+
+    struct ProcessInfo *p = (struct ProcessInfo*)value;
+    p->inTree = treeEnabled && restoredInTree(p);
+    updateSelected(p);
+
+    return 1;
+}
+
+void finishProcessRestore(void)
+{
+    if (NULL != processes)
+    {
+        intTableForEach(processes, finishRestore, NULL);
+    }
+}
+
+void processForked(int parentPid, int childPid)
+{
+    struct ProcessInfo *child = findProcess(childPid);
+    struct ProcessInfo *parent = findProcess(parentPid);
+
+    //a forked child runs its parent's image until it execs
+    if (NULL == child)
+    {
+        addProcess(childPid, parentPid, NULL != parent ? parent->processPath : NULL, 0);
+        return;
+    }
+
+    //the child's own records may arrive before the parent's fork record, or
+    //the pid is being reused and the entry describes an earlier process
+    child->parentPid = parentPid;
+    child->stale = 1;
+    if (treeEnabled)
+    {
+        child->inTree = (NULL != parent && parent->inTree) || isTreeRoot(child);
+    }
+    updateSelected(child);
+}
+
+void processExeced(int pid)
+{
+    struct ProcessInfo *p = findProcess(pid);
+
+    if (NULL != p)
+    {
+        p->stale = 1;
+    }
+}
+
+void processExited(int pid)
+{
+    //children keep their own membership flag, so the entry can go right away
+    if (NULL != processes)
+    {
+        free(intTableRemove(processes, pid));
+    }
+}
@@ -0,0 +1,62 @@
+#ifndef PROCESS_H
+#define PROCESS_H
+
+#ifdef __APPLE__
+#include <libproc.h>
+#else
+#include <sys/param.h>
+#define PROC_PIDPATHINFO_MAXSIZE MAXPATHLEN
+#endif
+
+#include "cgroup.h"
+
+struct ProcessInfo
+{
+    int pid;
+    int parentPid;
+    int inTree; //cached subtree membership, inherited on fork
+    int selected; //cached pid, name and tree filter verdict
+    unsigned int filterGeneration; //of the filter set the verdict was computed with
+    int stale; //exec seen or path unresolved, resolved again on the next record
+    char processPath[PROC_PIDPATHINFO_MAXSIZE];
+    char cgroup[CGROUP_SIZE]; //only resolved with attribution enabled
+    char container[CONTAINER_SIZE];
+};
+
+//selects the subtree rooted at pid, or at every process whose path contains name
+void setProcessTreeRoot(int pid, const char* name);
+int isProcessTreeEnabled(void);
+
+//pid and name filters of the current filter set, evaluated once per process
+//and again after a reload instead of per event
+int isProcessSelected(int pid);
+
+//resolves cgroup and container once per process, filter matches either of them
+void setCgroupAttribution(const char* filter);
+int isCgroupAttributionEnabled(void);
+
+struct ProcessInfo* findProcess(int pid);
+//parentPid and path as the record tells them, 0 and "" have them looked up
+struct ProcessInfo* updateProcess(int pid, int parentPid, const char* path);
+//never NULL, "?" when the process is unknown
+const char* getProcessName(int pid);
+
+//lineage updates from fork/exec/exit audit records
+void processForked(int parentPid, int childPid);
+void processExeced(int pid);
+void processExited(int pid);
+
+//checkpoints: visits the calling thread's processes until visit returns 0
+typedef int (*ProcessVisit)(const struct ProcessInfo* process, void* context);
+void forEachProcess(ProcessVisit visit, void* context);
+
+//adds a saved process, its path is resolved again on its next record
+int restoreProcess(int pid, int parentPid, const char* path, const char* cgroup, const char* container);
+//recomputes tree membership and filter verdicts once every process is restored
+void finishProcessRestore(void);
+
+//drops entries of processes whose exit record was never seen
+void pruneExitedProcesses(void);
+unsigned int getProcessCount(void);
+
+#endif //PROCESS_H
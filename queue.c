@@ -0,0 +1,296 @@
+#include "queue.h"
+
+#include <string.h>
+#include <stdlib.h>
+
+#include "bsmids.h"
+
+//most records fit a pooled block, bigger ones are malloc'ed
+#define BLOCK_SIZE 2048
+
+struct QueuedRecord
+{
+    unsigned long long sequence;
+    int length;
+    u_char* data;
+};
+
+struct RecordRing
+{
+    struct QueuedRecord* slots;
+    unsigned int head;
+    unsigned int count;
+};
+
+struct FreeBlock
+{
+    struct FreeBlock* next;
+};
+
+struct RecordQueue
+{
+    struct RecordRing rings[2]; //indexed by priority
+    unsigned int capacity;
+    int policy;
+    unsigned long long sequence;
+    struct FreeBlock* freeBlocks;
+    unsigned long long drops[DROP_REASON_COUNT];
+};
+
+static const char* dropReasonNames[DROP_REASON_COUNT] =
+{
+    "queue_full_newest",
+    "queue_full_oldest",
+    "shed_low_priority",
+    "shed_high_priority",
+};
+
+int queueParsePolicy(const char* name)
+{
+    if (strcmp(name, "block") == 0)
+    {
+        return OVERLOAD_BLOCK;
+    }
+    if (strcmp(name, "newest") == 0)
+    {
+        return OVERLOAD_DROP_NEWEST;
+    }
+    if (strcmp(name, "oldest") == 0)
+    {
+        return OVERLOAD_DROP_OLDEST;
+    }
+    if (strcmp(name, "priority") == 0)
+    {
+        return OVERLOAD_DROP_PRIORITY;
+    }
+
+    return -1;
+}
+
+const char* queueDropReasonName(int reason)
+{
+    return dropReasonNames[reason];
+}
+
+int recordPriority(const u_char* record, int length)
+{
+    //all header token variants have the event type right after id, size and version
+    if (length < 8)
+    {
+        return PRIORITY_LOW;
+    }
+
+    int type = (record[6] << 8) | record[7];
+
+    switch (type)
+    {
+        case AUE_UNLINK:
+        case AUE_RENAME:
+        case AUE_RMDIR:
+        case AUE_TRUNCATE:
+        case AUE_FTRUNCATE:
+        case AUE_LINK:
+        case AUE_SYMLINK:
+        case AUE_MKDIR:
+        case AUE_CREAT:
+        case AUE_CHMOD:
+        case AUE_CHOWN:
+#ifdef AUE_UNLINKAT
+        case AUE_UNLINKAT:
+#endif
+#ifdef AUE_RENAMEAT
+        case AUE_RENAMEAT:
+#endif
+        return PRIORITY_HIGH;
+    }
+
+    return PRIORITY_LOW;
+}
+
+struct RecordQueue* queueCreate(unsigned int capacity, int policy)
+{
+    struct RecordQueue* queue = (struct RecordQueue*)malloc(sizeof(struct RecordQueue));
+    memset(queue, 0, sizeof(struct RecordQueue));
+    queue->capacity = capacity;
+    queue->policy = policy;
+
+    for (int i = 0; i < 2; ++i)
+    {
+        queue->rings[i].slots = (struct QueuedRecord*)calloc(capacity, sizeof(struct QueuedRecord));
+    }
+
+    return queue;
+}
+
+static u_char* allocateRecord(struct RecordQueue* queue, int length)
+{
+    if (length > BLOCK_SIZE)
+    {
+        return (u_char*)malloc(length);
+    }
+
+    if (NULL != queue->freeBlocks)
+    {
+        struct FreeBlock* block = queue->freeBlocks;
+        queue->freeBlocks = block->next;
+        return (u_char*)block;
+    }
+
+    return (u_char*)malloc(BLOCK_SIZE);
+}
+
+static void freeRecord(struct RecordQueue* queue, u_char* data, int length)
+{
+    if (length > BLOCK_SIZE)
+    {
+        free(data);
+        return;
+    }
+
+    struct FreeBlock* block = (struct FreeBlock*)data;
+    block->next = queue->freeBlocks;
+    queue->freeBlocks = block;
+}
+
+void queueDestroy(struct RecordQueue* queue)
+{
+    int length = 0;
+    u_char* data = NULL;
+
+    if (NULL == queue)
+    {
+        return;
+    }
+
+    while ((data = queuePop(queue, &length)) != NULL)
+    {
+        queueRelease(queue, data, length);
+    }
+
+    while (NULL != queue->freeBlocks)
+    {
+        struct FreeBlock* block = queue->freeBlocks;
+        queue->freeBlocks = block->next;
+        free(block);
+    }
+
+    free(queue->rings[0].slots);
+    free(queue->rings[1].slots);
+    free(queue);
+}
+
+unsigned int queueCount(const struct RecordQueue* queue)
+{
+    return queue->rings[0].count + queue->rings[1].count;
+}
+
+unsigned int queueCapacity(const struct RecordQueue* queue)
+{
+    return queue->capacity;
+}
+
+unsigned long long queueDrops(const struct RecordQueue* queue, int reason)
+{
+    return queue->drops[reason];
+}
+
+//ring with the oldest head record, -1 if both are empty
+static int oldestRing(const struct RecordQueue* queue)
+{
+    const struct RecordRing* low = &queue->rings[PRIORITY_LOW];
+    const struct RecordRing* high = &queue->rings[PRIORITY_HIGH];
+
+    if (low->count == 0)
+    {
+        return high->count ? PRIORITY_HIGH : -1;
+    }
+    if (high->count == 0)
+    {
+        return PRIORITY_LOW;
+    }
+
+    return low->slots[low->head].sequence < high->slots[high->head].sequence ? PRIORITY_LOW : PRIORITY_HIGH;
+}
+
+static void dropHead(struct RecordQueue* queue, int priority, int reason)
+{
+    struct RecordRing* ring = &queue->rings[priority];
+    struct QueuedRecord* slot = &ring->slots[ring->head];
+
+    freeRecord(queue, slot->data, slot->length);
+    ring->head = (ring->head + 1) % queue->capacity;
+    ring->count--;
+    queue->drops[reason]++;
+}
+
+int queuePush(struct RecordQueue* queue, const u_char* record, int length)
+{
+    int priority = recordPriority(record, length);
+
+    if (queueCount(queue) >= queue->capacity)
+    {
+        switch (queue->policy)
+        {
+            case OVERLOAD_BLOCK:
+            return -1;
+            case OVERLOAD_DROP_NEWEST:
+            queue->drops[DROP_NEWEST]++;
+            return 0;
+            case OVERLOAD_DROP_OLDEST:
+            dropHead(queue, oldestRing(queue), DROP_OLDEST);
+            break;
+            default:
+            if (priority == PRIORITY_LOW)
+            {
+                queue->drops[DROP_LOW_PRIORITY]++;
+                return 0;
+            }
+            if (queue->rings[PRIORITY_LOW].count > 0)
+            {
+                dropHead(queue, PRIORITY_LOW, DROP_LOW_PRIORITY);
+            }
+            else
+            {
+                queue->drops[DROP_HIGH_PRIORITY]++;
+                return 0;
+            }
+            break;
+        }
+    }
+
+    struct RecordRing* ring = &queue->rings[priority];
+    struct QueuedRecord* slot = &ring->slots[(ring->head + ring->count) % queue->capacity];
+
+    slot->sequence = queue->sequence++;
+    slot->length = length;
+    slot->data = allocateRecord(queue, length);
+    memcpy(slot->data, record, length);
+    ring->count++;
+
+    return 1;
+}
+
+u_char* queuePop(struct RecordQueue* queue, int* length)
+{
+    int priority = oldestRing(queue);
+
+    if (priority < 0)
+    {
+        return NULL;
+    }
+
+    struct RecordRing* ring = &queue->rings[priority];
+    struct QueuedRecord* slot = &ring->slots[ring->head];
+    u_char* data = slot->data;
+
+    *length = slot->length;
+    ring->head = (ring->head + 1) % queue->capacity;
+    ring->count--;
+
+    return data;
+}
+
+void queueRelease(struct RecordQueue* queue, u_char* record, int length)
+{
+    freeRecord(queue, record, length);
+}
@@ -0,0 +1,49 @@
+#ifndef QUEUE_H
+#define QUEUE_H
+
+#include <sys/types.h>
+
+/*
+ * Bounded queue of raw BSM records between reading the audit pipe and the
+ * expensive stages. What happens when it is full is explicit: stop reading
+ * (and let the kernel drop), drop the incoming record, drop the oldest one,
+ * or shed low priority records (open, read, ...) to keep high priority
+ * ones (unlink, rename, ...). Records of both priorities keep their
+ * arrival order.
+ */
+
+#define OVERLOAD_BLOCK 0
+#define OVERLOAD_DROP_NEWEST 1
+#define OVERLOAD_DROP_OLDEST 2
+#define OVERLOAD_DROP_PRIORITY 3
+
+#define PRIORITY_LOW 0
+#define PRIORITY_HIGH 1
+
+#define DROP_NEWEST 0
+#define DROP_OLDEST 1
+#define DROP_LOW_PRIORITY 2
+#define DROP_HIGH_PRIORITY 3 //only when the queue is full of high priority records
+#define DROP_REASON_COUNT 4
+
+struct RecordQueue;
+
+struct RecordQueue* queueCreate(unsigned int capacity, int policy);
+void queueDestroy(struct RecordQueue* queue);
+
+//returns 1 if queued, 0 if a record was dropped, -1 if full under OVERLOAD_BLOCK
+int queuePush(struct RecordQueue* queue, const u_char* record, int length);
+
+//oldest record or NULL, the data stays valid until queueRelease()
+u_char* queuePop(struct RecordQueue* queue, int* length);
+void queueRelease(struct RecordQueue* queue, u_char* record, int length);
+
+unsigned int queueCount(const struct RecordQueue* queue);
+unsigned int queueCapacity(const struct RecordQueue* queue);
+unsigned long long queueDrops(const struct RecordQueue* queue, int reason);
+const char* queueDropReasonName(int reason);
+
+int queueParsePolicy(const char* name);
+int recordPriority(const u_char* record, int length);
+
+#endif //QUEUE_H
@@ -0,0 +1,269 @@
+#include "rules.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "uthash.h"
+
+#define MAX_RULES 16
+#define RULE_BUCKETS 16
+#define MAX_KEYS_PER_RULE 65536
+
+struct RuleCounter
+{
+    unsigned long long bucket; //absolute index of the head bucket
+    unsigned long long last;
+    unsigned long long quietUntil; //no repeated alert for the same window
+    unsigned int counts[RULE_BUCKETS];
+    unsigned int head;
+    unsigned int sum;
+    size_t keyLength;
+    UT_hash_handle hh;
+    unsigned char key[];
+};
+
+struct Rule
+{
+    int keyKind;
+    int eventType; //0 for any
+    unsigned int threshold;
+    unsigned long long window;
+    unsigned long long bucketLength;
+    unsigned int keyCount;
+    char text[128];
+    struct RuleCounter* counters; //least recently updated first
+};
+
+static struct Rule rules[MAX_RULES];
+static int ruleCount = 0;
+static unsigned long long untracked = 0;
+
+static const char* keyNames[] = { "pid", "uid", "dir", "type" };
+
+int rulesAdd(const char* spec, int (*eventId)(const char* name), char* error, size_t errorSize)
+{
+    char keyName[16];
+    char eventName[128];
+    unsigned int threshold = 0;
+    unsigned int seconds = 0;
+
+    if (ruleCount >= MAX_RULES)
+    {
+        snprintf(error, errorSize, "at most %d rules", MAX_RULES);
+        return -1;
+    }
+
+    if (sscanf(spec, "%15[^:]:%127[^:]:%u/%u", keyName, eventName, &threshold, &seconds) != 4 || threshold == 0 || seconds == 0)
+    {
+        snprintf(error, errorSize, "expected key:event:count/seconds");
+        return -1;
+    }
+
+    struct Rule* rule = &rules[ruleCount];
+    memset(rule, 0, sizeof(struct Rule));
+    rule->keyKind = -1;
+
+    for (int i = 0; i < (int)(sizeof(keyNames) / sizeof(keyNames[0])); ++i)
+    {
+        if (strcmp(keyName, keyNames[i]) == 0)
+        {
+            rule->keyKind = i;
+        }
+    }
+
+    if (rule->keyKind < 0)
+    {
+        snprintf(error, errorSize, "unknown key '%s', use pid, uid, dir or type", keyName);
+        return -1;
+    }
+
+    if (strcmp(eventName, "*") != 0
+        && sscanf(eventName, "%d", &rule->eventType) <= 0
+        && (NULL == eventId || (rule->eventType = eventId(eventName)) <= 0))
+    {
+        snprintf(error, errorSize, "unknown event '%s'", eventName);
+        return -1;
+    }
+
+    rule->threshold = threshold;
+    rule->window = (unsigned long long)seconds * 1000;
+    rule->bucketLength = rule->window / RULE_BUCKETS > 0 ? rule->window / RULE_BUCKETS : 1;
+    strncpy(rule->text, spec, sizeof(rule->text) - 1);
+    ruleCount++;
+    return 0;
+}
+
+int isRulesEnabled(void)
+{
+    return ruleCount > 0;
+}
+
+static size_t makeKey(const struct Rule* rule, const struct AuditEntry* entry, unsigned char* key)
+{
+    const char* slash = NULL;
+
+    switch (rule->keyKind)
+    {
+        case RULE_KEY_PID:
+        memcpy(key, &entry->pid, sizeof(int));
+        return sizeof(int);
+        case RULE_KEY_UID:
+        memcpy(key, &entry->userId, sizeof(int));
+        return sizeof(int);
+        case RULE_KEY_TYPE:
+        memcpy(key, &entry->type, sizeof(int));
+        return sizeof(int);
+        case RULE_KEY_DIR:
+        slash = strrchr(entry->path, '/');
+        if (NULL == slash)
+        {
+            return 0;
+        }
+        memcpy(key, entry->path, slash - entry->path + 1);
+        return slash - entry->path + 1;
+    }
+
+    return 0;
+}
+
+static void describeKey(const struct Rule* rule, const struct RuleCounter* c, char* text, size_t size)
+{
+    int value = 0;
+
+    if (rule->keyKind == RULE_KEY_DIR)
+    {
+        snprintf(text, size, "%.*s", (int)c->keyLength, (const char*)c->key);
+    }
+    else
+    {
+        memcpy(&value, c->key, sizeof(int));
+        snprintf(text, size, "%d", value);
+    }
+}
+
+//moves the ring forward to the bucket of now, at most RULE_BUCKETS steps
+static void advance(const struct Rule* rule, struct RuleCounter* c, unsigned long long now)
+{
+    unsigned long long bucket = now / rule->bucketLength;
+
+    if (bucket <= c->bucket)
+    {
+        return;
+    }
+
+    if (bucket - c->bucket >= RULE_BUCKETS)
+    {
+        memset(c->counts, 0, sizeof(c->counts));
+        c->sum = 0;
+    }
+    else
+    {
+        for (unsigned long long b = c->bucket; b < bucket; ++b)
+        {
+            c->head = (c->head + 1) % RULE_BUCKETS;
+            c->sum -= c->counts[c->head];
+            c->counts[c->head] = 0;
+        }
+    }
+
+    c->bucket = bucket;
+}
+
+static void evaluateRule(struct Rule* rule, const struct AuditEntry* entry, AlertHandler handler, void* context)
+{
+    unsigned char key[MAXPATHLEN];
+    size_t keyLength = makeKey(rule, entry, key);
+    struct RuleCounter *c = NULL;
+
+    if (keyLength == 0)
+    {
+        return;
+    }
+
+    HASH_FIND(hh, rule->counters, key, keyLength, c);
+    if (NULL == c)
+    {
+        if (rule->keyCount >= MAX_KEYS_PER_RULE)
+        {
+            untracked++;
+            return;
+        }
+
+        c = (struct RuleCounter*)malloc(sizeof(struct RuleCounter) + keyLength);
+        if (NULL == c)
+        {
+            return;
+        }
+        memset(c, 0, sizeof(struct RuleCounter));
+        memcpy(c->key, key, keyLength);
+        c->keyLength = keyLength;
+        c->bucket = entry->timestamp / rule->bucketLength;
+        rule->keyCount++;
+    }
+    else
+    {
+        HASH_DEL(rule->counters, c);
+        advance(rule, c, entry->timestamp);
+    }
+    HASH_ADD_KEYPTR(hh, rule->counters, c->key, c->keyLength, c);
+
+    c->counts[c->head]++;
+    c->sum++;
+    if (entry->timestamp > c->last)
+    {
+        c->last = entry->timestamp;
+    }
+
+    if (c->sum >= rule->threshold && entry->timestamp >= c->quietUntil)
+    {
+        char keyText[MAXPATHLEN];
+        describeKey(rule, c, keyText, sizeof(keyText));
+        c->quietUntil = entry->timestamp + rule->window;
+        handler(rule->text, keyText, c->sum, entry, context);
+    }
+}
+
+void rulesEvaluate(const struct AuditEntry* entry, AlertHandler handler, void* context)
+{
+    for (int i = 0; i < ruleCount; ++i)
+    {
+        if (rules[i].eventType == 0 || rules[i].eventType == entry->type)
+        {
+            evaluateRule(&rules[i], entry, handler, context);
+        }
+    }
+}
+
+void rulesExpire(unsigned long long now)
+{
+    for (int i = 0; i < ruleCount; ++i)
+    {
+        struct Rule* rule = &rules[i];
+
+        while (NULL != rule->counters && rule->counters->last + rule->window < now)
+        {
+            struct RuleCounter* c = rule->counters;
+            HASH_DEL(rule->counters, c);
+            free(c);
+            rule->keyCount--;
+        }
+    }
+}
+
+unsigned int getRuleKeyCount(void)
+{
+    unsigned int count = 0;
+
+    for (int i = 0; i < ruleCount; ++i)
+    {
+        count += rules[i].keyCount;
+    }
+
+    return count;
+}
+
+unsigned long long getRuleUntracked(void)
+{
+    return untracked;
+}
@@ -0,0 +1,39 @@
+#ifndef RULES_H
+#define RULES_H
+
+#include <stddef.h>
+
+#include "entry.h"
+
+/*
+ * Rate threshold rules over sliding windows, for example "one pid unlinked
+ * more than 500 files in 10 seconds". Each rule counts matching events per
+ * key in a ring of time buckets, so an event costs one hash lookup and a
+ * bucket increment however many keys are tracked.
+ *
+ * Rule syntax: key:event:count/seconds
+ *   key      pid, uid, dir or type
+ *   event    event name or id from /etc/security/audit_event, or * for any
+ */
+
+#define RULE_KEY_PID 0
+#define RULE_KEY_UID 1
+#define RULE_KEY_DIR 2
+#define RULE_KEY_TYPE 3
+
+//key is the pid, uid, directory or event type as text
+typedef void (*AlertHandler)(const char* rule, const char* key, unsigned int count, const struct AuditEntry* entry, void* context);
+
+//eventId maps an event name to its id or returns 0, returns -1 on a syntax error described in error
+int rulesAdd(const char* spec, int (*eventId)(const char* name), char* error, size_t errorSize);
+int isRulesEnabled(void);
+
+void rulesEvaluate(const struct AuditEntry* entry, AlertHandler handler, void* context);
+
+//forgets keys without events in their window, now in milliseconds since the epoch
+void rulesExpire(unsigned long long now);
+
+unsigned int getRuleKeyCount(void);
+unsigned long long getRuleUntracked(void);
+
+#endif //RULES_H
@@ -0,0 +1,181 @@
+#include "sample.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "uthash.h"
+
+struct TypeWindow
+{
+    int type;
+    unsigned long long second; //of the records' own time, not of reading them
+    unsigned long long seen;
+    unsigned long long kept;
+    double scale; //seen per kept of the second before, what the cap drops is only known when a second ends
+    UT_hash_handle hh;
+};
+
+static int mode = SAMPLE_NONE;
+static double rate = 1.0;
+static uint64_t threshold = 0;
+static uint64_t sequence = 0;
+static unsigned int typeCap = 0;
+static CapReport capReport = NULL;
+static void* capContext = NULL;
+static struct TypeWindow *windows = NULL;
+
+//splitmix64 finalizer, spreads sequential pids and counters evenly
+static uint64_t mix(uint64_t x)
+{
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+static uint64_t hashPath(const char* path, size_t length)
+{
+    uint64_t h = 0xcbf29ce484222325ULL;
+
+    for (size_t i = 0; i < length; ++i)
+    {
+        h ^= (unsigned char)path[i];
+        h *= 0x100000001b3ULL;
+    }
+
+    return mix(h);
+}
+
+int samplerConfigure(const char* spec)
+{
+    int newMode = SAMPLE_RECORD;
+    char* end = NULL;
+
+    if (strncmp(spec, "pid:", 4) == 0)
+    {
+        newMode = SAMPLE_PID;
+        spec += 4;
+    }
+    else if (strncmp(spec, "path:", 5) == 0)
+    {
+        newMode = SAMPLE_PATH;
+        spec += 5;
+    }
+
+    double value = strtod(spec, &end);
+    if (end == spec || *end != 0 || !(value > 0.0) || value > 1.0)
+    {
+        return -1;
+    }
+
+    mode = newMode;
+    rate = value;
+    //keep a record when its 64 bit hash is below rate * 2^64
+    threshold = value >= 1.0 ? UINT64_MAX : (uint64_t)(value * 18446744073709551616.0);
+    return 0;
+}
+
+void samplerSetTypeCap(unsigned int perSecond, CapReport report, void* context)
+{
+    typeCap = perSecond;
+    capReport = report;
+    capContext = context;
+}
+
+int isSamplingEnabled(void)
+{
+    return mode != SAMPLE_NONE || typeCap > 0;
+}
+
+//returns how many records a kept one stands for, 0 if it is dropped
+static double underTypeCap(const struct AuditEntry* entry)
+{
+    struct TypeWindow *w = NULL;
+    int type = entry->type;
+    //a replayed trail is capped per second it covers, however fast it is read
+    unsigned long long second = entry->timestamp / 1000;
+
+    HASH_FIND_INT(windows, &type, w);
+    if (NULL == w)
+    {
+        w = (struct TypeWindow*)malloc(sizeof(struct TypeWindow));
+        memset(w, 0, sizeof(struct TypeWindow));
+        w->type = type;
+        w->second = second;
+        w->scale = 1.0;
+        HASH_ADD_INT(windows, type, w);
+    }
+    else if (w->second != second)
+    {
+        if (w->seen > w->kept && NULL != capReport)
+        {
+            capReport(w->type, w->seen, w->kept, capContext);
+        }
+        //a gap of a second or more says nothing about this one
+        w->scale = second == w->second + 1 && w->kept > 0 ? (double)w->seen / w->kept : 1.0;
+        w->second = second;
+        w->seen = 0;
+        w->kept = 0;
+    }
+
+    w->seen++;
+    if (w->kept < typeCap)
+    {
+        w->kept++;
+        return w->scale;
+    }
+
+    return 0.0;
+}
+
+int sampleEntry(const struct AuditEntry* entry, double* weight)
+{
+    uint64_t h = 0;
+
+    switch (mode)
+    {
+        case SAMPLE_RECORD:
+        h = mix(++sequence);
+        break;
+        case SAMPLE_PID:
+        h = mix((uint64_t)(unsigned int)entry->pid);
+        break;
+        case SAMPLE_PATH:
+        h = hashPath(entry->path, entry->pathLength);
+        break;
+    }
+
+    if (mode != SAMPLE_NONE && rate < 1.0 && h >= threshold)
+    {
+        return 0;
+    }
+
+    double scale = 1.0;
+    if (typeCap > 0 && (scale = underTypeCap(entry)) == 0.0)
+    {
+        return 0;
+    }
+
+    *weight = (mode != SAMPLE_NONE ? 1.0 / rate : 1.0) * scale;
+    return 1;
+}
+
+void samplerFinish(void)
+{
+    struct TypeWindow *w = NULL;
+    struct TypeWindow *tmp = NULL;
+
+    HASH_ITER(hh, windows, w, tmp)
+    {
+        if (w->seen > w->kept && NULL != capReport)
+        {
+            capReport(w->type, w->seen, w->kept, capContext);
+        }
+        HASH_DEL(windows, w);
+        free(w);
+    }
+}
@@ -0,0 +1,34 @@
+#ifndef SAMPLE_H
+#define SAMPLE_H
+
+#include "entry.h"
+
+/*
+ * Sampling runs before process resolution, filtering and formatting. It is
+ * deterministic: a fixed rate keeps the same records of the same input, and
+ * pid: or path: keep a whole process or a whole path in or out by hashing
+ * it. The per event type cap keeps at most that many records per second
+ * of record time for each event type, so replays are capped like live input.
+ */
+
+#define SAMPLE_NONE 0
+#define SAMPLE_RECORD 1
+#define SAMPLE_PID 2
+#define SAMPLE_PATH 3
+
+//called when a capped event type's window ends with records dropped
+typedef void (*CapReport)(int type, unsigned long long seen, unsigned long long kept, void* context);
+
+//spec is rate, pid:rate or path:rate with 0 < rate <= 1, returns -1 if invalid
+int samplerConfigure(const char* spec);
+void samplerSetTypeCap(unsigned int perSecond, CapReport report, void* context);
+int isSamplingEnabled(void);
+
+//returns 1 to keep the entry, weight is what one kept entry stands for, for
+//the cap estimated from the type's previous second as the current one is not over
+int sampleEntry(const struct AuditEntry* entry, double* weight);
+
+//reports the windows still open, call before exiting
+void samplerFinish(void);
+
+#endif //SAMPLE_H
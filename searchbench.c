@@ -0,0 +1,247 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "strsearch.h"
+
+/*
+ * Checks findSubstring() against strstr() on random haystacks and needles
+ * from a small alphabet, so partial matches are common, with every
+ * haystack ending right before an unmapped page so a vector load past its
+ * end faults. Then times both on generated paths whose lengths are spread
+ * like those of a busy host, per length bucket, for a filter that mostly
+ * misses but shares the paths' leading directories. On glibc this is done
+ * for the default variant and for the vector one alone.
+ */
+
+#define DEFAULT_CHECKS 2000000
+#define DEFAULT_SEARCHES 20000000
+#define MAX_HAYSTACK 512
+#define MAX_NEEDLE 48
+#define PATH_COUNT 4096
+#define BUCKET_COUNT 4
+
+static unsigned long long state = 0x9E3779B97F4A7C15ULL;
+
+//splitmix64, the same sequence on every run
+static unsigned long long nextRandom(void)
+{
+    unsigned long long z = (state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+static double nowSeconds(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static void fillRandom(char* text, size_t length, const char* alphabet, size_t alphabetLength)
+{
+    for (size_t i = 0; i < length; ++i)
+    {
+        text[i] = alphabet[nextRandom() % alphabetLength];
+    }
+    text[length] = 0;
+}
+
+static int checkEquivalence(unsigned long long checks)
+{
+    static const char alphabet[] = "/ab.";
+    long pageSize = sysconf(_SC_PAGESIZE);
+    char needle[MAX_NEEDLE + 1];
+    unsigned long long found = 0;
+
+    //the haystack and its 0 end at the guard page
+    char* pages = (char*)mmap(NULL, pageSize * 2, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0);
+    if (MAP_FAILED == pages || mprotect(pages + pageSize, pageSize, PROT_NONE) < 0)
+    {
+        fprintf(stderr, "Could not map the guard page!\n");
+        return -1;
+    }
+
+    for (unsigned long long i = 0; i < checks; ++i)
+    {
+        size_t haystackLength = nextRandom() % MAX_HAYSTACK;
+        char* haystack = pages + pageSize - haystackLength - 1;
+        fillRandom(haystack, haystackLength, alphabet, sizeof(alphabet) - 1);
+
+        //half the needles are cut from the haystack so there is something to find
+        size_t needleLength = nextRandom() % (MAX_NEEDLE + 1);
+        if (nextRandom() % 2 == 0 && needleLength <= haystackLength)
+        {
+            size_t from = nextRandom() % (haystackLength - needleLength + 1);
+            memcpy(needle, haystack + from, needleLength);
+            needle[needleLength] = 0;
+        }
+        else
+        {
+            fillRandom(needle, needleLength, alphabet, sizeof(alphabet) - 1);
+        }
+
+        const char* expected = strstr(haystack, needle);
+        const char* actual = findSubstring(haystack, haystackLength, needle, needleLength);
+        if (expected != actual)
+        {
+            printf("MISMATCH haystack:\"%s\" needle:\"%s\" strstr:%ld findSubstring:%ld\n", haystack, needle,
+                NULL != expected ? (long)(expected - haystack) : -1L, NULL != actual ? (long)(actual - haystack) : -1L);
+            munmap(pages, pageSize * 2);
+            return -1;
+        }
+        found += NULL != actual;
+    }
+
+    printf("variant:%s checks:%llu found:%llu ok\n", findSubstringVariant(), checks, found);
+    munmap(pages, pageSize * 2);
+    return 0;
+}
+
+//mostly 20 to 80 bytes, with a tail of deep trees up to 300
+static size_t pathLength(void)
+{
+    unsigned long long r = nextRandom() % 100;
+
+    if (r < 70)
+    {
+        return 20 + nextRandom() % 61;
+    }
+    if (r < 95)
+    {
+        return 80 + nextRandom() % 81;
+    }
+    return 160 + nextRandom() % 141;
+}
+
+static int bucketOf(size_t length)
+{
+    return length < 40 ? 0 : length < 80 ? 1 : length < 160 ? 2 : 3;
+}
+
+static void makePath(char* path, size_t length)
+{
+    static const char* roots[] = { "/Users/alice/", "/Users/bob/", "/private/var/", "/System/Library/" };
+    static const char alphabet[] = "abcdefghijklmnopqrstuvwxyz0123456789_-";
+    const char* root = roots[nextRandom() % 4];
+    size_t rootLength = strlen(root);
+
+    memcpy(path, root, rootLength);
+    for (size_t i = rootLength; i < length; ++i)
+    {
+        path[i] = nextRandom() % 9 == 0 && path[i - 1] != '/' ? '/' : alphabet[nextRandom() % (sizeof(alphabet) - 1)];
+    }
+    path[length] = 0;
+}
+
+static void runPaths(unsigned long long searches)
+{
+    static const char* bucketNames[BUCKET_COUNT] = { "<40", "40-79", "80-159", "160+" };
+    const char* needle = "/Users/alice/Documents/reports";
+    size_t needleLength = strlen(needle);
+    char (*paths)[MAX_HAYSTACK] = malloc(PATH_COUNT * sizeof(*paths));
+    size_t lengths[PATH_COUNT];
+
+    if (NULL == paths)
+    {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+
+    for (int i = 0; i < PATH_COUNT; ++i)
+    {
+        lengths[i] = pathLength();
+        makePath(paths[i], lengths[i]);
+    }
+    //a few hits, as a filter would see
+    for (int i = 0; i < PATH_COUNT; i += 50)
+    {
+        if (lengths[i] >= needleLength)
+        {
+            memcpy(paths[i], needle, needleLength);
+        }
+    }
+
+    for (int bucket = 0; bucket < BUCKET_COUNT; ++bucket)
+    {
+        int members[PATH_COUNT];
+        int memberCount = 0;
+        for (int i = 0; i < PATH_COUNT; ++i)
+        {
+            if (bucketOf(lengths[i]) == bucket)
+            {
+                members[memberCount++] = i;
+            }
+        }
+        if (memberCount == 0)
+        {
+            continue;
+        }
+
+        //the share of the searches this bucket gets in the mix
+        unsigned long long count = searches * memberCount / PATH_COUNT;
+        unsigned long long found = 0;
+        double start = nowSeconds();
+        for (unsigned long long i = 0; i < count; ++i)
+        {
+            int p = members[i % memberCount];
+            found += NULL != strstr(paths[p], needle);
+        }
+        double strstrSeconds = nowSeconds() - start;
+
+        unsigned long long foundFast = 0;
+        start = nowSeconds();
+        for (unsigned long long i = 0; i < count; ++i)
+        {
+            int p = members[i % memberCount];
+            foundFast += NULL != findSubstring(paths[p], lengths[p], needle, needleLength);
+        }
+        double fastSeconds = nowSeconds() - start;
+
+        printf("variant:%s lengths:%s paths:%d searches:%llu hits:%llu strstr_ns:%.1f find_ns:%.1f speedup:%.2f%s\n",
+            findSubstringVariant(), bucketNames[bucket], memberCount, count, found, strstrSeconds * 1e9 / count, fastSeconds * 1e9 / count,
+            fastSeconds > 0 ? strstrSeconds / fastSeconds : 0.0, found == foundFast ? "" : " MISMATCH");
+    }
+
+    free(paths);
+}
+
+int main(int argc, char** argv)
+{
+    unsigned long long checks = DEFAULT_CHECKS;
+    unsigned long long searches = DEFAULT_SEARCHES;
+
+    if ((argc > 1 && sscanf(argv[1], "%llu", &checks) <= 0) || (argc > 2 && sscanf(argv[2], "%llu", &searches) <= 0))
+    {
+        printf("Usage:  %s [checks] [searches]\n", argv[0]);
+        return 1;
+    }
+
+    //glibc builds default to its own strstr() for all but short paths, the
+    //second pass is the vector variant alone
+    for (int pass = 0; pass < 2; ++pass)
+    {
+        if (pass == 1)
+        {
+            const char* variant = findSubstringVariant();
+            findSubstringUseVector();
+            if (strcmp(variant, findSubstringVariant()) == 0)
+            {
+                break;
+            }
+        }
+
+        if (checkEquivalence(checks) < 0)
+        {
+            return 1;
+        }
+
+        runPaths(searches);
+    }
+
+    return 0;
+}
@@ -0,0 +1,228 @@
+#include "session.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "bsmids.h"
+
+#include "uthash.h"
+
+#define DEFAULT_CAPACITY 16384
+
+#define ACCESS_NONE 0
+#define ACCESS_OPEN 1
+#define ACCESS_READ 2
+#define ACCESS_WRITE 3
+#define ACCESS_CLOSE 4
+
+struct SessionEntry
+{
+    struct Session session;
+    size_t keyLength;
+    UT_hash_handle hh;
+    unsigned char key[]; //pid followed by the path
+};
+
+static struct SessionEntry *sessions = NULL;
+static unsigned int capacity = 0;
+static unsigned long long timeout = 0;
+static SessionReport sessionReport = NULL;
+static void* reportContext = NULL;
+
+static const char* endNames[] = { "close", "timeout", "evicted", "finish" };
+
+void sessionConfigure(unsigned int sessionCapacity, unsigned int timeoutSeconds, SessionReport report, void* context)
+{
+    capacity = sessionCapacity > 0 ? sessionCapacity : DEFAULT_CAPACITY;
+    timeout = (unsigned long long)timeoutSeconds * 1000;
+    sessionReport = report;
+    reportContext = context;
+}
+
+int isSessionEnabled(void)
+{
+    return capacity > 0;
+}
+
+static int accessKind(int type)
+{
+    switch (type)
+    {
+        case AUE_OPEN:
+        case AUE_OPEN_R:
+        case AUE_OPEN_RC:
+        case AUE_OPEN_RT:
+        case AUE_OPEN_RTC:
+        case AUE_OPEN_W:
+        case AUE_OPEN_WC:
+        case AUE_OPEN_WT:
+        case AUE_OPEN_WTC:
+        case AUE_OPEN_RW:
+        case AUE_OPEN_RWC:
+        case AUE_OPEN_RWT:
+        case AUE_OPEN_RWTC:
+#ifdef AUE_OPENAT
+        case AUE_OPENAT:
+        case AUE_OPENAT_R:
+        case AUE_OPENAT_RC:
+        case AUE_OPENAT_RT:
+        case AUE_OPENAT_RTC:
+        case AUE_OPENAT_W:
+        case AUE_OPENAT_WC:
+        case AUE_OPENAT_WT:
+        case AUE_OPENAT_WTC:
+        case AUE_OPENAT_RW:
+        case AUE_OPENAT_RWC:
+        case AUE_OPENAT_RWT:
+        case AUE_OPENAT_RWTC:
+#endif
+#ifdef AUE_OPEN_EXTENDED
+        case AUE_OPEN_EXTENDED:
+        case AUE_OPEN_EXTENDED_R:
+        case AUE_OPEN_EXTENDED_RT:
+        case AUE_OPEN_EXTENDED_W:
+        case AUE_OPEN_EXTENDED_WC:
+        case AUE_OPEN_EXTENDED_WT:
+        case AUE_OPEN_EXTENDED_WTC:
+        case AUE_OPEN_EXTENDED_RW:
+        case AUE_OPEN_EXTENDED_RWC:
+        case AUE_OPEN_EXTENDED_RWT:
+        case AUE_OPEN_EXTENDED_RWTC:
+#endif
+        return ACCESS_OPEN;
+#ifdef AUE_READ
+        case AUE_READ:
+#endif
+#ifdef AUE_PREAD
+        case AUE_PREAD:
+#endif
+        return ACCESS_READ;
+#ifdef AUE_WRITE
+        case AUE_WRITE:
+#endif
+#ifdef AUE_PWRITE
+        case AUE_PWRITE:
+#endif
+        case AUE_TRUNCATE:
+        case AUE_FTRUNCATE:
+        return ACCESS_WRITE;
+        case AUE_CLOSE:
+        return ACCESS_CLOSE;
+    }
+
+    return ACCESS_NONE;
+}
+
+static void endSession(struct SessionEntry* s, int reason)
+{
+    if (NULL != sessionReport)
+    {
+        sessionReport(&s->session, reason, reportContext);
+    }
+
+    HASH_DEL(sessions, s);
+    free(s);
+}
+
+int sessionObserve(const struct AuditEntry* entry)
+{
+    int kind = accessKind(entry->type);
+
+    if (kind == ACCESS_NONE || entry->pathLength == 0)
+    {
+        return 0;
+    }
+
+    unsigned char key[sizeof(int) + MAXPATHLEN];
+    size_t keyLength = sizeof(int) + entry->pathLength;
+    struct SessionEntry *s = NULL;
+
+    memcpy(key, &entry->pid, sizeof(int));
+    memcpy(key + sizeof(int), entry->path, entry->pathLength);
+
+    HASH_FIND(hh, sessions, key, keyLength, s);
+    if (NULL == s)
+    {
+        if (HASH_COUNT(sessions) >= capacity)
+        {
+            //the head is the least recently used since entries move to the end on access
+            endSession(sessions, SESSION_END_EVICTED);
+        }
+
+        s = (struct SessionEntry*)malloc(sizeof(struct SessionEntry) + keyLength + 1);
+        if (NULL == s)
+        {
+            return 0;
+        }
+        memset(s, 0, sizeof(struct SessionEntry));
+        memcpy(s->key, key, keyLength);
+        s->key[keyLength] = 0;
+        s->keyLength = keyLength;
+        s->session.pid = entry->pid;
+        s->session.start = entry->timestamp;
+        s->session.path = (const char*)s->key + sizeof(int);
+        HASH_ADD_KEYPTR(hh, sessions, s->key, s->keyLength, s);
+    }
+    else
+    {
+        HASH_DEL(sessions, s);
+        HASH_ADD_KEYPTR(hh, sessions, s->key, s->keyLength, s);
+    }
+
+    s->session.last = entry->timestamp;
+
+    switch (kind)
+    {
+        case ACCESS_OPEN:
+        s->session.opens++;
+        break;
+        case ACCESS_READ:
+        s->session.reads++;
+        break;
+        case ACCESS_WRITE:
+        s->session.writes++;
+        break;
+        case ACCESS_CLOSE:
+        s->session.closes++;
+        //the file may still be open through another descriptor
+        if (s->session.closes >= s->session.opens)
+        {
+            endSession(s, SESSION_END_CLOSE);
+        }
+        break;
+    }
+
+    return 1;
+}
+
+void sessionExpire(unsigned long long now)
+{
+    if (timeout == 0 || now < timeout)
+    {
+        return;
+    }
+
+    //oldest activity first, so stop at the first one still active
+    while (NULL != sessions && sessions->session.last < now - timeout)
+    {
+        endSession(sessions, SESSION_END_TIMEOUT);
+    }
+}
+
+void sessionFinish(void)
+{
+    while (NULL != sessions)
+    {
+        endSession(sessions, SESSION_END_FINISH);
+    }
+}
+
+unsigned int getSessionCount(void)
+{
+    return HASH_COUNT(sessions);
+}
+
+const char* sessionEndName(int reason)
+{
+    return endNames[reason];
+}
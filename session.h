@@ -0,0 +1,48 @@
+#ifndef SESSION_H
+#define SESSION_H
+
+#include "entry.h"
+
+/*
+ * Folds open, read, write and close records of the same process and path
+ * into one access session. A session ends on close, after being idle for
+ * the timeout, or when the table is full and it is the least recently
+ * used one. Times are record times, so replaying a trail gives the same
+ * sessions as watching live.
+ */
+
+#define SESSION_END_CLOSE 0
+#define SESSION_END_TIMEOUT 1
+#define SESSION_END_EVICTED 2
+#define SESSION_END_FINISH 3
+
+struct Session
+{
+    int pid;
+    unsigned long long start;
+    unsigned long long last;
+    unsigned int opens;
+    unsigned int reads;
+    unsigned int writes;
+    unsigned int closes;
+    const char* path;
+};
+
+typedef void (*SessionReport)(const struct Session* session, int reason, void* context);
+
+void sessionConfigure(unsigned int capacity, unsigned int timeoutSeconds, SessionReport report, void* context);
+int isSessionEnabled(void);
+
+//returns 1 if the entry was folded into a session and should not be printed
+int sessionObserve(const struct AuditEntry* entry);
+
+//ends sessions idle since before now - timeout, now in milliseconds since the epoch
+void sessionExpire(unsigned long long now);
+
+//ends every open session
+void sessionFinish(void);
+
+unsigned int getSessionCount(void);
+const char* sessionEndName(int reason);
+
+#endif //SESSION_H
@@ -0,0 +1,319 @@
+#ifdef __linux__
+#define _GNU_SOURCE
+#endif
+
+#include "shard.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define SLOT_COUNT 2048
+//items handed to a worker at once, fewer lock round trips per record
+#define BATCH_SIZE 64
+
+struct Shard
+{
+    int index;
+    pthread_t thread;
+    pthread_cond_t wakeup;
+    unsigned int queue[SLOT_COUNT]; //slot numbers, never more than SLOT_COUNT in flight
+    unsigned long long queued; //under the lock
+    unsigned long long taken; //worker only
+    unsigned int pending[BATCH_SIZE]; //submitting thread only, not yet queued
+    int pendingCount;
+};
+
+static struct ShardItem* items = NULL;
+static unsigned char* finished = NULL; //per slot, under the lock
+static unsigned long long head = 0; //next to hand back, submitting thread only
+static unsigned long long tail = 0; //next to hand out, submitting thread only
+static struct Shard* shards = NULL;
+static int shardCount = 0;
+static int stopping = 0;
+static int notifyPipe[2] = { -1, -1 };
+static ShardWork shardWork = NULL;
+static void* workContext = NULL;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t progress = PTHREAD_COND_INITIALIZER;
+
+static void pinToCore(struct Shard* shard)
+{
+#ifdef __linux__
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    cpu_set_t set;
+
+    if (cores > 0)
+    {
+        CPU_ZERO(&set);
+        CPU_SET(shard->index % cores, &set);
+        pthread_setaffinity_np(shard->thread, sizeof(set), &set);
+    }
+#else
+    //macOS only takes affinity hints and FreeBSD would need cpuset, the scheduler spreads the workers anyway
+    (void)shard;
+#endif
+}
+
+static void* workerMain(void* argument)
+{
+    struct Shard* shard = (struct Shard*)argument;
+
+    for (;;)
+    {
+        pthread_mutex_lock(&lock);
+        while (!stopping && shard->taken == shard->queued)
+        {
+            pthread_cond_wait(&shard->wakeup, &lock);
+        }
+
+        unsigned long long from = shard->taken;
+        unsigned long long to = shard->queued;
+        pthread_mutex_unlock(&lock);
+
+        if (from == to)
+        {
+            return NULL;
+        }
+
+        for (unsigned long long i = from; i < to; ++i)
+        {
+            shardWork(shard->index, &items[shard->queue[i % SLOT_COUNT]], workContext);
+        }
+
+        pthread_mutex_lock(&lock);
+        for (unsigned long long i = from; i < to; ++i)
+        {
+            finished[shard->queue[i % SLOT_COUNT]] = 1;
+        }
+        shard->taken = to;
+        pthread_cond_signal(&progress);
+        pthread_mutex_unlock(&lock);
+
+        //a full pipe already has the main thread's attention
+        char byte = 0;
+        if (write(notifyPipe[1], &byte, 1) < 0 && errno != EAGAIN)
+        {
+            perror("shard notify");
+        }
+    }
+}
+
+int shardStart(int workers, ShardWork work, void* context)
+{
+    if (NULL != items || workers < 1)
+    {
+        return -1;
+    }
+
+    workers = workers > MAX_SHARDS ? MAX_SHARDS : workers;
+    items = (struct ShardItem*)calloc(SLOT_COUNT, sizeof(struct ShardItem));
+    finished = (unsigned char*)calloc(SLOT_COUNT, 1);
+    shards = (struct Shard*)calloc(workers, sizeof(struct Shard));
+    if (NULL == items || NULL == finished || NULL == shards || pipe(notifyPipe) < 0)
+    {
+        free(items);
+        free(finished);
+        free(shards);
+        items = NULL;
+        return -1;
+    }
+
+    fcntl(notifyPipe[0], F_SETFL, fcntl(notifyPipe[0], F_GETFL) | O_NONBLOCK);
+    fcntl(notifyPipe[1], F_SETFL, fcntl(notifyPipe[1], F_GETFL) | O_NONBLOCK);
+
+    //the workers inherit the mask, so the signals the event loop reads never land on them
+    sigset_t blocked;
+    sigset_t saved;
+    sigemptyset(&blocked);
+    sigaddset(&blocked, SIGINT);
+    sigaddset(&blocked, SIGTERM);
+    sigaddset(&blocked, SIGHUP);
+    pthread_sigmask(SIG_BLOCK, &blocked, &saved);
+
+    shardWork = work;
+    workContext = context;
+    for (shardCount = 0; shardCount < workers; ++shardCount)
+    {
+        struct Shard* shard = &shards[shardCount];
+        shard->index = shardCount;
+        pthread_cond_init(&shard->wakeup, NULL);
+        if (pthread_create(&shard->thread, NULL, workerMain, shard) != 0)
+        {
+            break;
+        }
+        pinToCore(shard);
+    }
+    pthread_sigmask(SIG_SETMASK, &saved, NULL);
+
+    //pids are already routed by the count, so a partial start is no use
+    if (shardCount < workers)
+    {
+        shardFinish(NULL, NULL);
+        return -1;
+    }
+
+    return notifyPipe[0];
+}
+
+int isShardingEnabled(void)
+{
+    return NULL != items;
+}
+
+static void queuePending(struct Shard* shard)
+{
+    if (shard->pendingCount == 0)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&lock);
+    for (int i = 0; i < shard->pendingCount; ++i)
+    {
+        shard->queue[(shard->queued + i) % SLOT_COUNT] = shard->pending[i];
+    }
+    shard->queued += shard->pendingCount;
+    pthread_cond_signal(&shard->wakeup);
+    pthread_mutex_unlock(&lock);
+
+    shard->pendingCount = 0;
+}
+
+static void queueAllPending(void)
+{
+    for (int i = 0; i < shardCount; ++i)
+    {
+        queuePending(&shards[i]);
+    }
+}
+
+struct ShardItem* shardAcquire(ShardDone done, void* context)
+{
+    while (tail - head >= SLOT_COUNT)
+    {
+        queueAllPending();
+
+        pthread_mutex_lock(&lock);
+        while (!finished[head % SLOT_COUNT])
+        {
+            pthread_cond_wait(&progress, &lock);
+        }
+        pthread_mutex_unlock(&lock);
+
+        shardCollect(done, context);
+    }
+
+    return &items[tail % SLOT_COUNT];
+}
+
+void shardSubmit(struct ShardItem* item)
+{
+    unsigned int slot = (unsigned int)(item - items);
+    //spreads pids that share low bits, e.g. all even ones
+    unsigned int hash = ((unsigned int)item->entry.pid * 2654435761u) >> 16;
+    struct Shard* shard = &shards[hash % shardCount];
+
+    tail++;
+    shard->pending[shard->pendingCount++] = slot;
+    if (shard->pendingCount == BATCH_SIZE)
+    {
+        queuePending(shard);
+    }
+}
+
+void shardCollect(ShardDone done, void* context)
+{
+    char drain[256];
+
+    if (NULL == items)
+    {
+        return;
+    }
+
+    while (read(notifyPipe[0], drain, sizeof(drain)) > 0)
+    {
+    }
+
+    //nothing may wait in a half full batch while the input is quiet
+    queueAllPending();
+
+    pthread_mutex_lock(&lock);
+    unsigned long long ready = head;
+    while (ready < tail && finished[ready % SLOT_COUNT])
+    {
+        finished[ready % SLOT_COUNT] = 0;
+        ready++;
+    }
+    pthread_mutex_unlock(&lock);
+
+    //these slots are not handed out again before head passes them
+    for (; head < ready; ++head)
+    {
+        if (NULL != done)
+        {
+            done(&items[head % SLOT_COUNT], context);
+        }
+    }
+}
+
+void shardDrain(ShardDone done, void* context)
+{
+    if (NULL == items)
+    {
+        return;
+    }
+
+    queueAllPending();
+    while (head < tail)
+    {
+        pthread_mutex_lock(&lock);
+        while (!finished[head % SLOT_COUNT])
+        {
+            pthread_cond_wait(&progress, &lock);
+        }
+        pthread_mutex_unlock(&lock);
+
+        shardCollect(done, context);
+    }
+}
+
+void shardFinish(ShardDone done, void* context)
+{
+    if (NULL == items)
+    {
+        return;
+    }
+
+    shardDrain(done, context);
+
+    pthread_mutex_lock(&lock);
+    stopping = 1;
+    for (int i = 0; i < shardCount; ++i)
+    {
+        pthread_cond_signal(&shards[i].wakeup);
+    }
+    pthread_mutex_unlock(&lock);
+
+    for (int i = 0; i < shardCount; ++i)
+    {
+        pthread_join(shards[i].thread, NULL);
+        pthread_cond_destroy(&shards[i].wakeup);
+    }
+
+    close(notifyPipe[0]);
+    close(notifyPipe[1]);
+    free(items);
+    free(finished);
+    free(shards);
+    items = NULL;
+    finished = NULL;
+    shards = NULL;
+    shardCount = 0;
+}
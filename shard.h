@@ -0,0 +1,53 @@
+#ifndef SHARD_H
+#define SHARD_H
+
+#include "entry.h"
+#include "process.h"
+
+/*
+ * Spreads the per record work over worker threads by pid. Every pid always
+ * goes to the same worker, which keeps the process table entries of its
+ * pids to itself, so lookups take no locks and the records of a process are
+ * handled in order. Finished items are handed back in submission order,
+ * so the output is the same as with one thread.
+ */
+
+#define MAX_SHARDS 16
+
+struct ShardItem
+{
+    //filled in by the submitting thread
+    struct AuditEntry entry;
+    double weight;
+    int sampledOut;
+    int targetMatched; //inode targets follow renames in order, so they are matched before
+    //filled in by the worker
+    int matched;
+    int print;
+    int hasProcess;
+    struct ProcessInfo process; //a copy, the worker may drop its entry before the item is handed back
+};
+
+//runs on the worker thread that owns the item's pid
+typedef void (*ShardWork)(int shard, struct ShardItem* item, void* context);
+//runs on the submitting thread, in submission order
+typedef void (*ShardDone)(struct ShardItem* item, void* context);
+
+//returns the fd that becomes readable when items are finished, -1 on failure
+int shardStart(int workers, ShardWork work, void* context);
+int isShardingEnabled(void);
+
+//the next free item, hands finished ones to done while every item is in use
+struct ShardItem* shardAcquire(ShardDone done, void* context);
+void shardSubmit(struct ShardItem* item);
+
+//hands finished items to done in submission order
+void shardCollect(ShardDone done, void* context);
+
+//waits for every submitted item and hands them to done
+void shardDrain(ShardDone done, void* context);
+
+//waits for every submitted item, hands them to done and stops the workers
+void shardFinish(ShardDone done, void* context);
+
+#endif //SHARD_H
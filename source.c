@@ -0,0 +1,344 @@
+#include "source.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "bsmids.h"
+#include "uring.h"
+
+#define INITIAL_CAPACITY (256 * 1024)
+#define URING_CHUNK_SIZE (64 * 1024)
+#define URING_CHUNK_COUNT 8
+//a header and a trailer token
+#define MIN_RECORD_SIZE 25
+//far more than the kernel or auditd write, a longer record or line means lost sync
+#define MAX_RECORD_SIZE (1024 * 1024)
+
+struct SourceChunk
+{
+    struct UringRequest request;
+    long long offset;
+    int queued;
+    int done;
+    int result;
+};
+
+struct RecordSource* sourceOpen(const char* path)
+{
+    int fd = open(path, O_RDONLY | O_NONBLOCK);
+
+    if (fd < 0)
+    {
+        return NULL;
+    }
+
+    return sourceOpenFd(path, fd);
+}
+
+struct RecordSource* sourceOpenFd(const char* name, int fd)
+{
+    struct RecordSource* source = (struct RecordSource*)malloc(sizeof(struct RecordSource));
+    memset(source, 0, sizeof(struct RecordSource));
+    source->name = name;
+    source->fd = fd;
+    source->capacity = INITIAL_CAPACITY;
+    source->buffer = (u_char*)malloc(source->capacity);
+
+    return source;
+}
+
+void sourceClose(struct RecordSource* source)
+{
+    if (NULL == source)
+    {
+        return;
+    }
+
+    //reads past the end may still be in flight and point into the chunks
+    for (int i = 0; i < source->chunkCount; ++i)
+    {
+        while (source->chunks[i].queued && uringSubmitAndWait(source->ring, 1) >= 0)
+        {
+        }
+    }
+
+    close(source->fd);
+    free(source->chunks);
+    free(source->chunkMemory);
+    free(source->buffer);
+    free(source);
+}
+
+int sourceSeek(struct RecordSource* source, unsigned long long offset)
+{
+    if (NULL != source->ring || lseek(source->fd, (off_t)offset, SEEK_SET) < 0)
+    {
+        return -1;
+    }
+
+    source->used = 0;
+    source->position = 0;
+    source->offset = offset;
+    return 0;
+}
+
+static u_int32_t readBigEndian32(const u_char* p)
+{
+    return ((u_int32_t)p[0] << 24) | ((u_int32_t)p[1] << 16) | ((u_int32_t)p[2] << 8) | p[3];
+}
+
+//length of the record at p, 0 if more bytes are needed, -1 if it is no record
+static long recordLength(const u_char* p, size_t available)
+{
+    if (available < 5)
+    {
+        return 0;
+    }
+
+    switch (p[0])
+    {
+        case AUT_HEADER32:
+        case AUT_HEADER32_EX:
+        case AUT_HEADER64:
+        case AUT_HEADER64_EX:
+        {
+            long length = readBigEndian32(p + 1);
+            return length >= MIN_RECORD_SIZE && length <= MAX_RECORD_SIZE ? length : -1;
+        }
+        case AUT_OTHER_FILE32:
+        //trail file header: id, seconds, milliseconds, name length, name
+        if (available < 11)
+        {
+            return 0;
+        }
+        return 11 + (((long)p[9] << 8) | p[10]);
+    }
+
+    return -1;
+}
+
+//length of the line at p with its newline, 0 if more bytes are needed, -1 if it is too long
+static long lineLength(const u_char* p, size_t available, size_t capacity)
+{
+    const u_char* end = (const u_char*)memchr(p, '\n', available);
+
+    if (NULL != end)
+    {
+        return end - p + 1;
+    }
+
+    //a line longer than the buffer makes it grow
+    if (available < capacity)
+    {
+        return 0;
+    }
+    return capacity * 2 <= MAX_RECORD_SIZE ? (long)capacity * 2 : -1;
+}
+
+//keeps the old buffer if there is no memory for the new one
+static int growBuffer(struct RecordSource* source, size_t capacity)
+{
+    u_char* buffer = (u_char*)realloc(source->buffer, capacity);
+
+    if (NULL == buffer)
+    {
+        return -1;
+    }
+
+    source->buffer = buffer;
+    source->capacity = capacity;
+    return 0;
+}
+
+static void onChunkRead(void* context, int tag, int result)
+{
+    struct RecordSource* source = (struct RecordSource*)context;
+
+    source->chunks[tag].queued = 0;
+    source->chunks[tag].done = 1;
+    source->chunks[tag].result = result;
+}
+
+static int queueChunk(struct RecordSource* source, int index)
+{
+    struct SourceChunk* chunk = &source->chunks[index];
+
+    chunk->queued = 1;
+    chunk->done = 0;
+    chunk->result = 0;
+    chunk->offset = source->nextOffset;
+    source->nextOffset += URING_CHUNK_SIZE;
+
+    return uringQueueRead(source->ring, source->fd, index, source->chunkMemory + (size_t)index * URING_CHUNK_SIZE,
+        URING_CHUNK_SIZE, chunk->offset, &chunk->request);
+}
+
+int sourceUseUring(struct RecordSource* source, struct Uring* ring)
+{
+    struct iovec buffers[URING_CHUNK_COUNT];
+    struct stat status;
+
+    if (NULL == ring || fstat(source->fd, &status) < 0 || !S_ISREG(status.st_mode))
+    {
+        return -1;
+    }
+
+    source->chunkMemory = (u_char*)malloc((size_t)URING_CHUNK_COUNT * URING_CHUNK_SIZE);
+    source->chunks = (struct SourceChunk*)calloc(URING_CHUNK_COUNT, sizeof(struct SourceChunk));
+    source->chunkCount = URING_CHUNK_COUNT;
+    source->nextOffset = lseek(source->fd, 0, SEEK_CUR);
+
+    for (int i = 0; i < URING_CHUNK_COUNT; ++i)
+    {
+        buffers[i].iov_base = source->chunkMemory + (size_t)i * URING_CHUNK_SIZE;
+        buffers[i].iov_len = URING_CHUNK_SIZE;
+        source->chunks[i].request.callback = onChunkRead;
+        source->chunks[i].request.context = source;
+        source->chunks[i].request.tag = i;
+    }
+
+    if (uringRegisterBuffers(ring, buffers, URING_CHUNK_COUNT) < 0)
+    {
+        free(source->chunks);
+        free(source->chunkMemory);
+        source->chunks = NULL;
+        source->chunkMemory = NULL;
+        return -1;
+    }
+
+    source->ring = ring;
+    for (int i = 0; i < URING_CHUNK_COUNT; ++i)
+    {
+        queueChunk(source, i);
+    }
+
+    return 0;
+}
+
+//appends the next chunk in file order, the reads themselves may complete in any order
+static ssize_t readChunk(struct RecordSource* source)
+{
+    struct SourceChunk* chunk = &source->chunks[source->nextChunk];
+
+    while (!chunk->done)
+    {
+        if (uringSubmitAndWait(source->ring, 1) < 0)
+        {
+            return -1;
+        }
+    }
+
+    int result = chunk->result;
+    if (result <= 0)
+    {
+        //chunks past the end of the file keep returning 0
+        chunk->done = 0;
+        source->endReached = 1;
+        return result;
+    }
+
+    if (source->capacity - source->used < (size_t)result && growBuffer(source, source->used + result) < 0)
+    {
+        return -1;
+    }
+    memcpy(source->buffer + source->used, source->chunkMemory + (size_t)source->nextChunk * URING_CHUNK_SIZE, result);
+
+    if (result < URING_CHUNK_SIZE)
+    {
+        source->endReached = 1;
+    }
+    if (!source->endReached)
+    {
+        queueChunk(source, source->nextChunk);
+    }
+    source->nextChunk = (source->nextChunk + 1) % source->chunkCount;
+
+    return result;
+}
+
+int sourceDrain(struct RecordSource* source, int maxRecords, RecordHandler handler, void* context)
+{
+    int handled = 0;
+
+    while (handled < maxRecords)
+    {
+        size_t available = source->used - source->position;
+        u_char* record = source->buffer + source->position;
+
+        //a BSM record never starts like these, its length would be near 2 GB,
+        //auditd starts lines with "node=" when name_format is set
+        if (source->format == SOURCE_FORMAT_UNKNOWN && available >= 5)
+        {
+            source->format = memcmp(record, "type=", 5) == 0 || memcmp(record, "node=", 5) == 0 ? SOURCE_FORMAT_TEXT : SOURCE_FORMAT_BSM;
+        }
+
+        long length = source->format == SOURCE_FORMAT_TEXT
+            ? lineLength(record, available, source->capacity)
+            : recordLength(record, available);
+
+        if (length < 0)
+        {
+            //lost sync, throw away what we have and start over with the next read
+            source->offset += available;
+            source->used = 0;
+            source->position = 0;
+            continue;
+        }
+
+        if (length > 0 && (size_t)length <= available)
+        {
+            source->position += length;
+            source->records++;
+            if (record[0] != AUT_OTHER_FILE32)
+            {
+                handler(record, (int)length, context);
+                handled++;
+            }
+            source->offset += length;
+            continue;
+        }
+
+        //make room for the rest of the partial record
+        if (source->position > 0)
+        {
+            memmove(source->buffer, record, available);
+            source->used = available;
+            source->position = 0;
+        }
+        if ((size_t)length > source->capacity && growBuffer(source, length) < 0)
+        {
+            return handled > 0 ? handled : -1;
+        }
+
+        ssize_t n = 0;
+        if (NULL != source->ring)
+        {
+            n = source->endReached ? 0 : readChunk(source);
+        }
+        else
+        {
+            source->readCalls++;
+            n = read(source->fd, source->buffer + source->used, source->capacity - source->used);
+        }
+
+        if (n > 0)
+        {
+            source->used += n;
+            source->bytes += n;
+        }
+        else if ((n < 0 && (errno == EAGAIN || errno == EINTR)) || (n == 0 && source->follow))
+        {
+            break;
+        }
+        else
+        {
+            return handled > 0 ? handled : -1;
+        }
+    }
+
+    return handled;
+}
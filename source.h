@@ -0,0 +1,68 @@
+#ifndef SOURCE_H
+#define SOURCE_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+/*
+ * Splits the byte stream of an audit pipe or trail file into whole BSM
+ * records, or a Linux audit log into lines, which is told apart by its
+ * first bytes. Reads are non-blocking and a partial record stays buffered
+ * until the rest of it arrives.
+ */
+
+#define SOURCE_FORMAT_UNKNOWN 0
+#define SOURCE_FORMAT_BSM 1
+//Linux auditd text, one record per line
+#define SOURCE_FORMAT_TEXT 2
+
+struct Uring;
+struct SourceChunk;
+
+struct RecordSource
+{
+    const char* name;
+    int fd;
+    u_char* buffer;
+    size_t capacity;
+    size_t used;
+    size_t position;
+    unsigned long long records;
+    unsigned long long bytes;
+    unsigned long long readCalls;
+    //file offset of the record being handled, then of the next one
+    unsigned long long offset;
+    //a trail that is still written, its end only means no more data yet
+    int follow;
+    int format;
+
+    //io_uring ingestion, see sourceUseUring()
+    struct Uring* ring;
+    u_char* chunkMemory;
+    struct SourceChunk* chunks;
+    int chunkCount;
+    int nextChunk;
+    long long nextOffset;
+    int endReached;
+};
+
+typedef void (*RecordHandler)(u_char* record, int length, void* context);
+
+struct RecordSource* sourceOpen(const char* path);
+//takes over an already open descriptor, such as a FIFO or stdin
+struct RecordSource* sourceOpenFd(const char* name, int fd);
+void sourceClose(struct RecordSource* source);
+
+//continues a regular file at offset, before sourceUseUring()
+int sourceSeek(struct RecordSource* source, unsigned long long offset);
+
+//keeps several reads of a regular file in flight into registered buffers,
+//sourceDrain() then blocks until data arrives instead of returning 0
+int sourceUseUring(struct RecordSource* source, struct Uring* ring);
+
+//hands at most maxRecords records to handler, returns the number handled
+//or -1 once the source is at its end or failed, a followed source returns
+//0 at its end and keeps a partly written record until the rest arrives
+int sourceDrain(struct RecordSource* source, int maxRecords, RecordHandler handler, void* context);
+
+#endif //SOURCE_H
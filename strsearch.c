@@ -0,0 +1,244 @@
+#include "strsearch.h"
+
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86_SIMD 1
+#elif defined(__aarch64__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define HAVE_NEON 1
+#endif
+
+typedef const char* (*FindFunction)(const char*, size_t, const char*, size_t);
+
+static const char* findResolve(const char* haystack, size_t haystackLength, const char* needle, size_t needleLength);
+
+static FindFunction findImplementation = findResolve;
+static const char* variantName = "unresolved";
+static FindFunction vectorImplementation = NULL;
+static const char* vectorName = NULL;
+
+static const char* findScalar(const char* haystack, size_t haystackLength, const char* needle, size_t needleLength)
+{
+    if (needleLength == 0)
+    {
+        return haystack;
+    }
+    if (needleLength > haystackLength)
+    {
+        return NULL;
+    }
+
+    const char* end = haystack + haystackLength - needleLength + 1;
+    const char* p = haystack;
+    const char last = needle[needleLength - 1];
+
+    while ((p = (const char*)memchr(p, needle[0], end - p)) != NULL)
+    {
+        if (p[needleLength - 1] == last && memcmp(p, needle, needleLength) == 0)
+        {
+            return p;
+        }
+        p++;
+    }
+
+    return NULL;
+}
+
+//checks the candidate bits of mask, bit n stands for haystack[offset + n]
+static inline const char* verifyCandidates(unsigned long long mask, int bitsPerByte, const char* block, const char* needle, size_t needleLength)
+{
+    while (mask)
+    {
+        int bit = __builtin_ctzll(mask) / bitsPerByte;
+        //first and last bytes already matched
+        if (needleLength <= 2 || memcmp(block + bit + 1, needle + 1, needleLength - 2) == 0)
+        {
+            return block + bit;
+        }
+        mask &= ~(((1ULL << bitsPerByte) - 1) << (bit * bitsPerByte));
+    }
+
+    return NULL;
+}
+
+#ifdef HAVE_X86_SIMD
+
+static const char* findSse2(const char* haystack, size_t haystackLength, const char* needle, size_t needleLength)
+{
+    if (needleLength < 2 || needleLength > haystackLength)
+    {
+        return findScalar(haystack, haystackLength, needle, needleLength);
+    }
+
+    const __m128i first = _mm_set1_epi8(needle[0]);
+    const __m128i last = _mm_set1_epi8(needle[needleLength - 1]);
+    size_t i = 0;
+
+    for (; i + needleLength - 1 + 16 <= haystackLength; i += 16)
+    {
+        __m128i blockFirst = _mm_loadu_si128((const __m128i*)(haystack + i));
+        __m128i blockLast = _mm_loadu_si128((const __m128i*)(haystack + i + needleLength - 1));
+        __m128i equal = _mm_and_si128(_mm_cmpeq_epi8(blockFirst, first), _mm_cmpeq_epi8(blockLast, last));
+        unsigned int mask = (unsigned int)_mm_movemask_epi8(equal);
+
+        if (mask)
+        {
+            const char* found = verifyCandidates(mask, 1, haystack + i, needle, needleLength);
+            if (found)
+            {
+                return found;
+            }
+        }
+    }
+
+    return findScalar(haystack + i, haystackLength - i, needle, needleLength);
+}
+
+__attribute__((target("avx2")))
+static const char* findAvx2(const char* haystack, size_t haystackLength, const char* needle, size_t needleLength)
+{
+    if (needleLength < 2 || needleLength > haystackLength)
+    {
+        return findScalar(haystack, haystackLength, needle, needleLength);
+    }
+
+    const __m256i first = _mm256_set1_epi8(needle[0]);
+    const __m256i last = _mm256_set1_epi8(needle[needleLength - 1]);
+    size_t i = 0;
+
+    for (; i + needleLength - 1 + 32 <= haystackLength; i += 32)
+    {
+        __m256i blockFirst = _mm256_loadu_si256((const __m256i*)(haystack + i));
+        __m256i blockLast = _mm256_loadu_si256((const __m256i*)(haystack + i + needleLength - 1));
+        __m256i equal = _mm256_and_si256(_mm256_cmpeq_epi8(blockFirst, first), _mm256_cmpeq_epi8(blockLast, last));
+        unsigned int mask = (unsigned int)_mm256_movemask_epi8(equal);
+
+        if (mask)
+        {
+            const char* found = verifyCandidates(mask, 1, haystack + i, needle, needleLength);
+            if (found)
+            {
+                return found;
+            }
+        }
+    }
+
+    //paths are short, the remainder usually fits one 16 byte block
+    return findSse2(haystack + i, haystackLength - i, needle, needleLength);
+}
+
+#endif //HAVE_X86_SIMD
+
+#ifdef HAVE_NEON
+
+static const char* findNeon(const char* haystack, size_t haystackLength, const char* needle, size_t needleLength)
+{
+    if (needleLength < 2 || needleLength > haystackLength)
+    {
+        return findScalar(haystack, haystackLength, needle, needleLength);
+    }
+
+    const uint8x16_t first = vdupq_n_u8((uint8_t)needle[0]);
+    const uint8x16_t last = vdupq_n_u8((uint8_t)needle[needleLength - 1]);
+    size_t i = 0;
+
+    for (; i + needleLength - 1 + 16 <= haystackLength; i += 16)
+    {
+        uint8x16_t blockFirst = vld1q_u8((const uint8_t*)(haystack + i));
+        uint8x16_t blockLast = vld1q_u8((const uint8_t*)(haystack + i + needleLength - 1));
+        uint8x16_t equal = vandq_u8(vceqq_u8(blockFirst, first), vceqq_u8(blockLast, last));
+        //narrow every byte to a nibble to get a 64 bit mask
+        uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(equal), 4)), 0);
+
+        if (mask)
+        {
+            const char* found = verifyCandidates(mask, 4, haystack + i, needle, needleLength);
+            if (found)
+            {
+                return found;
+            }
+        }
+    }
+
+    return findScalar(haystack + i, haystackLength - i, needle, needleLength);
+}
+
+#endif //HAVE_NEON
+
+static void chooseVector(void)
+{
+    vectorImplementation = findScalar;
+    vectorName = "scalar";
+
+#if defined(HAVE_X86_SIMD)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+        vectorImplementation = findAvx2;
+        vectorName = "avx2";
+    }
+    else if (__builtin_cpu_supports("sse2"))
+    {
+        vectorImplementation = findSse2;
+        vectorName = "sse2";
+    }
+#elif defined(HAVE_NEON)
+    vectorImplementation = findNeon;
+    vectorName = "neon";
+#endif
+}
+
+#ifdef __GLIBC__
+
+//below this the vector variant still wins, strstr() takes longer to set up
+#define SHORT_HAYSTACK 40
+
+static const char* findLibc(const char* haystack, size_t haystackLength, const char* needle, size_t needleLength)
+{
+    if (haystackLength < SHORT_HAYSTACK)
+    {
+        return vectorImplementation(haystack, haystackLength, needle, needleLength);
+    }
+
+    return strstr(haystack, needle);
+}
+
+#endif //__GLIBC__
+
+static const char* findResolve(const char* haystack, size_t haystackLength, const char* needle, size_t needleLength)
+{
+    chooseVector();
+#ifdef __GLIBC__
+    findImplementation = findLibc;
+    variantName = "glibc";
+#else
+    findImplementation = vectorImplementation;
+    variantName = vectorName;
+#endif
+
+    return findImplementation(haystack, haystackLength, needle, needleLength);
+}
+
+const char* findSubstring(const char* haystack, size_t haystackLength, const char* needle, size_t needleLength)
+{
+    return findImplementation(haystack, haystackLength, needle, needleLength);
+}
+
+const char* findSubstringVariant(void)
+{
+    if (findImplementation == findResolve)
+    {
+        findResolve("", 0, "", 0);
+    }
+
+    return variantName;
+}
+
+void findSubstringUseVector(void)
+{
+    chooseVector();
+    findImplementation = vectorImplementation;
+    variantName = vectorName;
+}
@@ -0,0 +1,23 @@
+#ifndef STRSEARCH_H
+#define STRSEARCH_H
+
+#include <stddef.h>
+
+/*
+ * strstr() replacement for the per-event filters. Candidates are found by
+ * comparing the first and last needle bytes against 16 or 32 haystack bytes
+ * at once, only those positions are verified with memcmp(). The AVX2, SSE2
+ * or NEON variant is picked at runtime with a scalar fallback. glibc's own
+ * strstr() is faster on all but short paths (see searchbench), so there it
+ * is used from 40 bytes on.
+ */
+
+//both strings end with a 0 at their length
+const char* findSubstring(const char* haystack, size_t haystackLength, const char* needle, size_t needleLength);
+
+//name of the variant in use, for diagnostics
+const char* findSubstringVariant(void);
+//uses the vector variant even on glibc, for comparisons
+void findSubstringUseVector(void);
+
+#endif //STRSEARCH_H
@@ -0,0 +1,156 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "uthash.h"
+#include "inttable.h"
+
+/*
+ * Compares pid lookups in uthash and in the open addressing IntTable for
+ * table sizes from 1k to 1M entries. Keys are spread like pids of a busy
+ * host, lookups hit an existing entry with the given share and miss
+ * otherwise. Both tables point to the same kind of separately allocated
+ * entry, only the index differs.
+ */
+
+#define DEFAULT_LOOKUPS 20000000
+#define DEFAULT_HIT_SHARE 0.9
+
+struct BenchEntry
+{
+    int pid;
+    unsigned long long events;
+    char path[64];
+    UT_hash_handle hh;
+};
+
+static unsigned long long state = 0x9E3779B97F4A7C15ULL;
+
+//splitmix64, the same sequence for both tables
+static unsigned long long nextRandom(void)
+{
+    unsigned long long z = (state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+static double nowSeconds(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static void makeKeys(int* keys, int count, int* misses)
+{
+    //pids are mostly ascending with gaps, keep them unique
+    int pid = 100;
+    for (int i = 0; i < count; ++i)
+    {
+        pid += 1 + (int)(nextRandom() % 7);
+        keys[i] = pid;
+        misses[i] = -pid;
+    }
+}
+
+static void runSize(int count, unsigned long long lookups, double hitShare)
+{
+    int* keys = (int*)malloc(count * sizeof(int));
+    int* misses = (int*)malloc(count * sizeof(int));
+    int* order = (int*)malloc(lookups * sizeof(int));
+    struct BenchEntry* byHash = NULL;
+    struct IntTable* table = intTableCreate(0);
+
+    if (NULL == keys || NULL == misses || NULL == order || NULL == table)
+    {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+
+    makeKeys(keys, count, misses);
+    for (int i = 0; i < count; ++i)
+    {
+        //two separate entries so neither table profits from the other's cache state
+        struct BenchEntry* a = (struct BenchEntry*)calloc(1, sizeof(struct BenchEntry));
+        struct BenchEntry* b = (struct BenchEntry*)calloc(1, sizeof(struct BenchEntry));
+        a->pid = b->pid = keys[i];
+        HASH_ADD_INT(byHash, pid, a);
+        intTableInsert(table, keys[i], b);
+    }
+
+    for (unsigned long long i = 0; i < lookups; ++i)
+    {
+        int index = (int)(nextRandom() % count);
+        order[i] = (nextRandom() % 1000) < hitShare * 1000 ? keys[index] : misses[index];
+    }
+
+    unsigned long long found = 0;
+    double start = nowSeconds();
+    for (unsigned long long i = 0; i < lookups; ++i)
+    {
+        struct BenchEntry* e = NULL;
+        HASH_FIND_INT(byHash, &order[i], e);
+        if (NULL != e)
+        {
+            e->events++;
+            found++;
+        }
+    }
+    double uthashSeconds = nowSeconds() - start;
+
+    unsigned long long foundFlat = 0;
+    start = nowSeconds();
+    for (unsigned long long i = 0; i < lookups; ++i)
+    {
+        struct BenchEntry* e = (struct BenchEntry*)intTableFind(table, order[i]);
+        if (NULL != e)
+        {
+            e->events++;
+            foundFlat++;
+        }
+    }
+    double flatSeconds = nowSeconds() - start;
+
+    printf("entries:%d lookups:%llu hits:%llu uthash_ns:%.1f inttable_ns:%.1f speedup:%.2f%s\n",
+        count, lookups, found, uthashSeconds * 1e9 / lookups, flatSeconds * 1e9 / lookups,
+        flatSeconds > 0 ? uthashSeconds / flatSeconds : 0.0, found == foundFlat ? "" : " MISMATCH");
+
+    struct BenchEntry* e = NULL;
+    struct BenchEntry* tmp = NULL;
+    HASH_ITER(hh, byHash, e, tmp)
+    {
+        HASH_DEL(byHash, e);
+        free(intTableRemove(table, e->pid));
+        free(e);
+    }
+    intTableDestroy(table);
+    free(keys);
+    free(misses);
+    free(order);
+}
+
+int main(int argc, char** argv)
+{
+    unsigned long long lookups = DEFAULT_LOOKUPS;
+    double hitShare = DEFAULT_HIT_SHARE;
+
+    if (argc > 1 && sscanf(argv[1], "%llu", &lookups) <= 0)
+    {
+        printf("Usage:  %s [lookups] [hit_share]\n", argv[0]);
+        return 1;
+    }
+    if (argc > 2 && (sscanf(argv[2], "%lf", &hitShare) <= 0 || hitShare < 0 || hitShare > 1))
+    {
+        printf("Usage:  %s [lookups] [hit_share]\n", argv[0]);
+        return 1;
+    }
+
+    for (int count = 1000; count <= 1000000; count *= 10)
+    {
+        runSize(count, lookups, hitShare);
+    }
+
+    return 0;
+}
@@ -0,0 +1,209 @@
+#include "targets.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "bsmids.h"
+
+#include "inttable.h"
+
+struct Target
+{
+    unsigned int device;
+    unsigned long long inode;
+    char path[MAXPATHLEN]; //the name it was last renamed to
+    struct Target* next; //same key
+};
+
+//hashed device and inode to a chain of targets, as the table keys are ints
+static struct IntTable* targets = NULL;
+static unsigned int targetCount = 0;
+static unsigned long long renames = 0;
+
+static int keyOf(unsigned int device, unsigned long long inode)
+{
+    return (int)(inode ^ (inode >> 32) ^ (device * 2654435761u));
+}
+
+static struct Target* findTarget(unsigned int device, unsigned long long inode)
+{
+    struct Target* t = (struct Target*)intTableFind(targets, keyOf(device, inode));
+
+    while (NULL != t && (t->inode != inode || t->device != device))
+    {
+        t = t->next;
+    }
+
+    return t;
+}
+
+static int insertTarget(struct Target* t)
+{
+    int key = keyOf(t->device, t->inode);
+
+    t->next = (struct Target*)intTableFind(targets, key);
+    return intTableInsert(targets, key, t);
+}
+
+static void removeTarget(struct Target* t)
+{
+    int key = keyOf(t->device, t->inode);
+    struct Target* head = (struct Target*)intTableFind(targets, key);
+
+    if (head == t)
+    {
+        if (NULL != t->next)
+        {
+            intTableInsert(targets, key, t->next);
+        }
+        else
+        {
+            intTableRemove(targets, key);
+        }
+        return;
+    }
+
+    for (; NULL != head; head = head->next)
+    {
+        if (head->next == t)
+        {
+            head->next = t->next;
+            return;
+        }
+    }
+}
+
+int targetAdd(const char* path)
+{
+    struct stat status;
+
+    if (stat(path, &status) < 0)
+    {
+        return -1;
+    }
+
+    if (NULL == targets)
+    {
+        targets = intTableCreate(16);
+        if (NULL == targets)
+        {
+            return -1;
+        }
+    }
+
+    //the attr token only has 32 bits of the device
+    unsigned int device = (unsigned int)status.st_dev;
+    if (NULL != findTarget(device, status.st_ino))
+    {
+        return 0;
+    }
+
+    struct Target* t = (struct Target*)malloc(sizeof(struct Target));
+    if (NULL == t)
+    {
+        return -1;
+    }
+    memset(t, 0, sizeof(struct Target));
+    t->device = device;
+    t->inode = status.st_ino;
+    strncpy(t->path, path, sizeof(t->path) - 1);
+
+    if (insertTarget(t) < 0)
+    {
+        free(t);
+        return -1;
+    }
+
+    targetCount++;
+    return 0;
+}
+
+int isTargetEnabled(void)
+{
+    return NULL != targets;
+}
+
+static int isRename(int type)
+{
+    switch (type)
+    {
+        case AUE_RENAME:
+#ifdef AUE_RENAMEAT
+        case AUE_RENAMEAT:
+#endif
+        return 1;
+    }
+
+    return 0;
+}
+
+struct NameSearch
+{
+    const char* path;
+    struct Target* found;
+};
+
+static int compareName(int key, void* value, void* context)
+{
+    (void)key;
+
+    struct NameSearch* search = (struct NameSearch*)context;
+    for (struct Target* t = (struct Target*)value; NULL != t; t = t->next)
+    {
+        if (strcmp(t->path, search->path) == 0)
+        {
+            search->found = t;
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+int targetObserve(const struct AuditEntry* entry)
+{
+    if (NULL == targets || (entry->inode == 0 && entry->device == 0))
+    {
+        return 0;
+    }
+
+    struct Target* t = findTarget(entry->device, entry->inode);
+
+    //the path of a rename is its new name and the device and inode are those of the moved file
+    if (!isRename(entry->type) || entry->pathLength == 0 || entry->pathLength >= sizeof(t->path))
+    {
+        return NULL != t;
+    }
+
+    if (NULL != t)
+    {
+        memcpy(t->path, entry->path, entry->pathLength + 1);
+        renames++;
+        return 1;
+    }
+
+    //the target's file was replaced, the moved file takes its place
+    struct NameSearch search = { entry->path, NULL };
+    intTableForEach(targets, compareName, &search);
+    if (NULL != search.found)
+    {
+        removeTarget(search.found);
+        search.found->device = entry->device;
+        search.found->inode = entry->inode;
+        insertTarget(search.found);
+        renames++;
+        return 1;
+    }
+
+    return 0;
+}
+
+unsigned int getTargetCount(void)
+{
+    return targetCount;
+}
+
+unsigned long long getTargetRenames(void)
+{
+    return renames;
+}
@@ -0,0 +1,27 @@
+#ifndef TARGETS_H
+#define TARGETS_H
+
+#include "entry.h"
+
+/*
+ * Watch targets by identity instead of by name. Each target path is
+ * resolved to its device and inode once at startup, and events are matched
+ * on the device and inode of the file they acted on. So a hard link, another
+ * spelling of the path or a renamed target still match, for a hash lookup
+ * instead of a string scan. A renamed target keeps its identity and only
+ * its name is updated. A file renamed onto a target's name, as editors do
+ * when they save, becomes the target in its place. Everything runs on the
+ * thread that hands out the entries, in their order.
+ */
+
+//returns -1 if the path can not be resolved
+int targetAdd(const char* path);
+int isTargetEnabled(void);
+
+//1 if the entry's file is a target, follows renames of targets and onto them
+int targetObserve(const struct AuditEntry* entry);
+
+unsigned int getTargetCount(void);
+unsigned long long getTargetRenames(void);
+
+#endif //TARGETS_H
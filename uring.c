@@ -0,0 +1,293 @@
+#include "uring.h"
+
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+
+#ifdef __linux__
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+struct Uring
+{
+    int fd;
+    unsigned int entries;
+    unsigned long long systemCalls;
+    unsigned int pending; //queued but not yet submitted
+
+    void* ringMemory;
+    size_t ringSize;
+    struct io_uring_sqe* sqes;
+    size_t sqesSize;
+
+    unsigned int* sqHead;
+    unsigned int* sqTail;
+    unsigned int* sqMask;
+    unsigned int* sqArray;
+
+    unsigned int* cqHead;
+    unsigned int* cqTail;
+    unsigned int* cqMask;
+    struct io_uring_cqe* cqes;
+};
+
+struct Uring* uringCreate(unsigned int entries)
+{
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+
+    int fd = (int)syscall(__NR_io_uring_setup, entries, &params);
+    if (fd < 0)
+    {
+        return NULL;
+    }
+
+    //one mapping for both rings, available since 5.4
+    if (!(params.features & IORING_FEAT_SINGLE_MMAP))
+    {
+        close(fd);
+        errno = ENOSYS;
+        return NULL;
+    }
+
+    struct Uring* ring = (struct Uring*)malloc(sizeof(struct Uring));
+    memset(ring, 0, sizeof(struct Uring));
+    ring->fd = fd;
+    ring->entries = params.sq_entries;
+
+    size_t sqSize = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+    size_t cqSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    ring->ringSize = sqSize > cqSize ? sqSize : cqSize;
+    ring->sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+
+    ring->ringMemory = mmap(NULL, ring->ringSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    ring->sqes = (struct io_uring_sqe*)mmap(NULL, ring->sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (ring->ringMemory == MAP_FAILED || ring->sqes == MAP_FAILED)
+    {
+        if (ring->ringMemory != MAP_FAILED)
+        {
+            munmap(ring->ringMemory, ring->ringSize);
+        }
+        close(fd);
+        free(ring);
+        return NULL;
+    }
+
+    char* base = (char*)ring->ringMemory;
+    ring->sqHead = (unsigned int*)(base + params.sq_off.head);
+    ring->sqTail = (unsigned int*)(base + params.sq_off.tail);
+    ring->sqMask = (unsigned int*)(base + params.sq_off.ring_mask);
+    ring->sqArray = (unsigned int*)(base + params.sq_off.array);
+    ring->cqHead = (unsigned int*)(base + params.cq_off.head);
+    ring->cqTail = (unsigned int*)(base + params.cq_off.tail);
+    ring->cqMask = (unsigned int*)(base + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe*)(base + params.cq_off.cqes);
+
+    return ring;
+}
+
+void uringDestroy(struct Uring* ring)
+{
+    if (NULL == ring)
+    {
+        return;
+    }
+
+    munmap(ring->sqes, ring->sqesSize);
+    munmap(ring->ringMemory, ring->ringSize);
+    close(ring->fd);
+    free(ring);
+}
+
+int uringRegisterBuffers(struct Uring* ring, const struct iovec* buffers, unsigned int count)
+{
+    ring->systemCalls++;
+    return (int)syscall(__NR_io_uring_register, ring->fd, IORING_REGISTER_BUFFERS, buffers, count);
+}
+
+static int reap(struct Uring* ring)
+{
+    int completed = 0;
+    unsigned int head = *ring->cqHead;
+
+    while (head != __atomic_load_n(ring->cqTail, __ATOMIC_ACQUIRE))
+    {
+        struct io_uring_cqe* cqe = &ring->cqes[head & *ring->cqMask];
+        struct UringRequest* request = (struct UringRequest*)(uintptr_t)cqe->user_data;
+        int result = cqe->res;
+
+        head++;
+        __atomic_store_n(ring->cqHead, head, __ATOMIC_RELEASE);
+
+        //the callback may queue new requests
+        request->callback(request->context, request->tag, result);
+        completed++;
+        head = *ring->cqHead;
+    }
+
+    return completed;
+}
+
+int uringSubmitAndWait(struct Uring* ring, unsigned int waitFor)
+{
+    int completed = reap(ring);
+
+    if (ring->pending == 0 && (completed > 0 || waitFor == 0))
+    {
+        return completed;
+    }
+
+    unsigned int flags = 0;
+    if (waitFor > (unsigned int)completed)
+    {
+        flags |= IORING_ENTER_GETEVENTS;
+        waitFor -= completed;
+    }
+    else
+    {
+        waitFor = 0;
+    }
+
+    int result;
+    do
+    {
+        ring->systemCalls++;
+        result = (int)syscall(__NR_io_uring_enter, ring->fd, ring->pending, waitFor, flags, NULL, 0);
+    } while (result < 0 && errno == EINTR);
+
+    if (result < 0)
+    {
+        return -1;
+    }
+
+    ring->pending -= (unsigned int)result < ring->pending ? (unsigned int)result : ring->pending;
+
+    return completed + reap(ring);
+}
+
+static struct io_uring_sqe* nextSqe(struct Uring* ring)
+{
+    unsigned int tail = *ring->sqTail;
+
+    if (tail - __atomic_load_n(ring->sqHead, __ATOMIC_ACQUIRE) >= ring->entries)
+    {
+        //ring full, push what we have to the kernel first
+        if (uringSubmitAndWait(ring, 0) < 0 || tail - __atomic_load_n(ring->sqHead, __ATOMIC_ACQUIRE) >= ring->entries)
+        {
+            return NULL;
+        }
+    }
+
+    unsigned int index = tail & *ring->sqMask;
+    struct io_uring_sqe* sqe = &ring->sqes[index];
+    memset(sqe, 0, sizeof(struct io_uring_sqe));
+    ring->sqArray[index] = index;
+
+    return sqe;
+}
+
+static void commitSqe(struct Uring* ring)
+{
+    __atomic_store_n(ring->sqTail, *ring->sqTail + 1, __ATOMIC_RELEASE);
+    ring->pending++;
+}
+
+int uringQueueRead(struct Uring* ring, int fd, int bufferIndex, void* buffer, unsigned int length, long long offset, struct UringRequest* request)
+{
+    struct io_uring_sqe* sqe = nextSqe(ring);
+
+    if (NULL == sqe)
+    {
+        return -1;
+    }
+
+    sqe->opcode = bufferIndex >= 0 ? IORING_OP_READ_FIXED : IORING_OP_READ;
+    sqe->fd = fd;
+    sqe->addr = (unsigned long long)(uintptr_t)buffer;
+    sqe->len = length;
+    sqe->off = (unsigned long long)offset;
+    sqe->buf_index = bufferIndex >= 0 ? bufferIndex : 0;
+    sqe->user_data = (unsigned long long)(uintptr_t)request;
+    commitSqe(ring);
+
+    return 0;
+}
+
+int uringQueueWrite(struct Uring* ring, int fd, const void* buffer, unsigned int length, long long offset, struct UringRequest* request)
+{
+    struct io_uring_sqe* sqe = nextSqe(ring);
+
+    if (NULL == sqe)
+    {
+        return -1;
+    }
+
+    sqe->opcode = IORING_OP_WRITE;
+    sqe->fd = fd;
+    sqe->addr = (unsigned long long)(uintptr_t)buffer;
+    sqe->len = length;
+    sqe->off = (unsigned long long)offset;
+    sqe->user_data = (unsigned long long)(uintptr_t)request;
+    commitSqe(ring);
+
+    return 0;
+}
+
+unsigned long long uringSystemCalls(const struct Uring* ring)
+{
+    return ring->systemCalls;
+}
+
+#else //__linux__
+
+struct Uring* uringCreate(unsigned int entries)
+{
+    (void)entries;
+    errno = ENOSYS;
+    return NULL;
+}
+
+void uringDestroy(struct Uring* ring)
+{
+    (void)ring;
+}
+
+int uringRegisterBuffers(struct Uring* ring, const struct iovec* buffers, unsigned int count)
+{
+    (void)ring; (void)buffers; (void)count;
+    errno = ENOSYS;
+    return -1;
+}
+
+int uringQueueRead(struct Uring* ring, int fd, int bufferIndex, void* buffer, unsigned int length, long long offset, struct UringRequest* request)
+{
+    (void)ring; (void)fd; (void)bufferIndex; (void)buffer; (void)length; (void)offset; (void)request;
+    errno = ENOSYS;
+    return -1;
+}
+
+int uringQueueWrite(struct Uring* ring, int fd, const void* buffer, unsigned int length, long long offset, struct UringRequest* request)
+{
+    (void)ring; (void)fd; (void)buffer; (void)length; (void)offset; (void)request;
+    errno = ENOSYS;
+    return -1;
+}
+
+int uringSubmitAndWait(struct Uring* ring, unsigned int waitFor)
+{
+    (void)ring; (void)waitFor;
+    errno = ENOSYS;
+    return -1;
+}
+
+unsigned long long uringSystemCalls(const struct Uring* ring)
+{
+    (void)ring;
+    return 0;
+}
+
+#endif //__linux__
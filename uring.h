@@ -0,0 +1,39 @@
+#ifndef URING_H
+#define URING_H
+
+#include <sys/uio.h>
+
+/*
+ * Minimal io_uring wrapper on top of the raw system calls. uringCreate()
+ * returns NULL where io_uring is unavailable (not Linux, old kernel, or
+ * blocked by policy) and callers fall back to plain read() and write().
+ */
+
+struct Uring;
+
+typedef void (*UringCallback)(void* context, int tag, int result);
+
+//owned by the caller and must stay valid until its callback ran
+struct UringRequest
+{
+    UringCallback callback;
+    void* context;
+    int tag;
+};
+
+struct Uring* uringCreate(unsigned int entries);
+void uringDestroy(struct Uring* ring);
+
+int uringRegisterBuffers(struct Uring* ring, const struct iovec* buffers, unsigned int count);
+
+//bufferIndex selects a registered buffer, -1 for a plain read
+int uringQueueRead(struct Uring* ring, int fd, int bufferIndex, void* buffer, unsigned int length, long long offset, struct UringRequest* request);
+int uringQueueWrite(struct Uring* ring, int fd, const void* buffer, unsigned int length, long long offset, struct UringRequest* request);
+
+//submits queued requests, waits for at least waitFor completions and runs
+//the callbacks of everything completed so far
+int uringSubmitAndWait(struct Uring* ring, unsigned int waitFor);
+
+unsigned long long uringSystemCalls(const struct Uring* ring);
+
+#endif //URING_H